@@ -0,0 +1,54 @@
+#include <algorithm>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <torch/torch.h>
+
+#include <samplers/samplers.h>
+#include <timer.h>
+
+
+using namespace rcnn;
+
+//cost of planning an epoch of aspect ratio grouped batches and of handing them out
+//usage: groupedBatchSamplerBenchmark [num_images] [images_per_batch] [epochs]
+int main(int argc, char* argv[]){
+  int num_images = argc > 1 ? std::stoi(argv[1]) : 120000;
+  int images_per_batch = argc > 2 ? std::stoi(argv[2]) : 16;
+  int epochs = std::max(argc > 3 ? std::stoi(argv[3]) : 5, 1);
+
+  //two groups like the default single bin at aspect ratio 1
+  torch::Tensor aspect_ratios = torch::rand({num_images}) * 1.5 + 0.25;
+  const float* ratios = aspect_ratios.data<float>();
+  std::vector<int> group_ids(num_images);
+  for(int i = 0; i < num_images; ++i)
+    group_ids[i] = ratios[i] > 1;
+
+  auto sampler = std::make_shared<torch::data::samplers::RandomSampler>(num_images);
+  data::GroupedBatchSampler batch_sampler(sampler, group_ids, images_per_batch, false);
+
+  utils::Timer plan_timer, next_timer;
+  int64_t num_batches = 0;
+  for(int epoch = 0; epoch < epochs; ++epoch){
+    batch_sampler.reset();
+    //the first next plans the epoch
+    plan_timer.tic();
+    torch::optional<std::vector<size_t>> batch = batch_sampler.next(images_per_batch);
+    plan_timer.toc();
+    next_timer.tic();
+    while(batch.has_value()){
+      num_batches++;
+      batch = batch_sampler.next(images_per_batch);
+    }
+    next_timer.toc();
+  }
+
+  std::cout << "images: " << num_images << ", images per batch: " << images_per_batch << "\n";
+  int64_t batches_per_epoch = std::max<int64_t>(num_batches / epochs, 1);
+  std::cout << "batches per epoch: " << batches_per_epoch << "\n";
+  std::cout << "batch plan: " << plan_timer.average_time() * 1e3 << " ms/epoch\n";
+  std::cout << "next: " << next_timer.average_time() * 1e9 / batches_per_epoch << " ns/batch\n";
+  return 0;
+}
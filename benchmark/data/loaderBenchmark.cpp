@@ -0,0 +1,44 @@
+#include <algorithm>
+#include <iostream>
+#include <string>
+
+#include <torch/torch.h>
+
+#include <defaults.h>
+#include <build.h>
+#include <timer.h>
+
+
+using namespace rcnn;
+
+//per-sample cost of building targets from the annotation index, images are not decoded
+//usage: loaderBenchmark config.yaml [num_samples]
+int main(int argc, char* argv[]){
+  if(argc < 2){
+    std::cout << "usage: " << argv[0] << " config.yaml [num_samples]\n";
+    return 1;
+  }
+  rcnn::config::SetCFGFromFile(argv[1]);
+  auto dataset_list = rcnn::config::GetCFG<std::vector<std::string>>({"DATASETS", "TRAIN"});
+  data::COCODataset dataset = data::BuildDataset(dataset_list, true);
+  size_t num_samples = dataset.size().value();
+  if(argc > 2)
+    num_samples = std::min<size_t>(num_samples, std::stoul(argv[2]));
+
+  const coco::COCO& coco_api = dataset.coco_detection.coco_;
+  int64_t num_objs = 0;
+  utils::Timer timer;
+  for(size_t i = 0; i < num_samples; ++i){
+    int img_id = dataset.coco_detection.ids()[i];
+    const coco::ImageRecord* img = coco_api.FindImage(img_id);
+    timer.tic();
+    structures::BoxList target = dataset.BuildTarget(coco_api.ImageAnnotations(img_id), std::make_pair(static_cast<int64_t>(img->width), static_cast<int64_t>(img->height)));
+    timer.toc();
+    num_objs += target.Length();
+  }
+
+  std::cout << "samples: " << num_samples << "\n";
+  std::cout << "objects per sample: " << static_cast<double>(num_objs) / std::max<size_t>(num_samples, 1) << "\n";
+  std::cout << "target construction: " << timer.average_time() * 1e6 << " us/sample\n";
+  return 0;
+}
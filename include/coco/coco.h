@@ -1,8 +1,10 @@
 #pragma once
 #include "rapidjson/document.h"
 #include <map>
+#include <memory>
 #include <string>
 #include <vector>
+#include <cstdint>
 
 
 namespace coco{
@@ -15,6 +17,130 @@ enum Crowd{
   T = 1
 };
 
+enum SegmType{
+  SEGM_NONE = 0,
+  SEGM_POLYGON = 1,
+  SEGM_RLE = 2,//uncompressed rle
+  SEGM_COMPRESSED_RLE = 3
+};
+
+//flat records, shared by the in-memory index and the binary cache
+//strings are offsets into the string pool
+struct ImageRecord{
+  int32_t id;
+  int32_t width;
+  int32_t height;
+  uint32_t file_name;
+};
+
+struct AnnotationRecord{
+  int64_t id;
+  int32_t image_id;
+  int32_t category_id;
+  //double like the json values, so evaluation thresholds see the same numbers as pycocotools
+  double area;
+  double bbox[4];
+  int32_t iscrowd;
+  int32_t segm_type;
+  //polygon: [segm_begin, segm_end) rings, uncompressed rle: counts, compressed rle: string offset and length
+  uint32_t segm_begin;
+  uint32_t segm_end;
+  int32_t rle_h;
+  int32_t rle_w;
+};
+
+struct CategoryRecord{
+  int32_t id;
+  uint32_t name;
+  uint32_t supercategory;
+};
+
+template<typename T>
+class ArrayView{
+
+public:
+  ArrayView() :data_(nullptr), size_(0){};
+  ArrayView(const T* data, size_t size) :data_(data), size_(size){};
+  const T* begin() const{ return data_; };
+  const T* end() const{ return data_ + size_; };
+  const T* data() const{ return data_; };
+  size_t size() const{ return size_; };
+  bool empty() const{ return size_ == 0; };
+  const T& operator[](size_t i) const{ return data_[i]; };
+
+private:
+  const T* data_;
+  size_t size_;
+};
+
+//owns its elements when built from json, views a mapped cache otherwise.
+//tables are immutable once filled, copies share the owned elements
+template<typename T>
+class Table{
+
+public:
+  Table() :data_(nullptr), size_(0){};
+  void Own(std::vector<T> values){
+    std::shared_ptr<std::vector<T>> owned = std::make_shared<std::vector<T>>();
+    owned->swap(values);
+    Bind(owned->data(), owned->size());
+    owned_ = owned;
+  };
+  void View(const T* data, size_t size){
+    owned_.reset();
+    Bind(data, size);
+  };
+  ArrayView<T> view() const{ return ArrayView<T>(data_, size_); };
+  const T* begin() const{ return data_; };
+  const T* end() const{ return data_ + size_; };
+  const T* data() const{ return data_; };
+  size_t size() const{ return size_; };
+  const T& operator[](size_t i) const{ return data_[i]; };
+
+private:
+  void Bind(const T* data, size_t size){
+    data_ = data;
+    size_ = size;
+  };
+  std::shared_ptr<const std::vector<T>> owned_;
+  const T* data_;
+  size_t size_;
+};
+
+//annotation records viewed through a list of table rows, nothing is copied
+class AnnotationRange{
+
+public:
+  class iterator{
+
+  public:
+    iterator(const AnnotationRecord* table, const uint32_t* row) :table_(table), row_(row){};
+    const AnnotationRecord& operator*() const{ return table_[*row_]; };
+    const AnnotationRecord* operator->() const{ return table_ + *row_; };
+    iterator& operator++(){ ++row_; return *this; };
+    bool operator==(const iterator& other) const{ return row_ == other.row_; };
+    bool operator!=(const iterator& other) const{ return row_ != other.row_; };
+    uint32_t row() const{ return *row_; };
+
+  private:
+    const AnnotationRecord* table_;
+    const uint32_t* row_;
+  };
+
+  AnnotationRange() :table_(nullptr){};
+  AnnotationRange(const AnnotationRecord* table, ArrayView<uint32_t> rows) :table_(table), rows_(rows){};
+  iterator begin() const{ return iterator(table_, rows_.begin()); };
+  iterator end() const{ return iterator(table_, rows_.end()); };
+  size_t size() const{ return rows_.size(); };
+  bool empty() const{ return rows_.empty(); };
+  const AnnotationRecord& operator[](size_t i) const{ return table_[rows_[i]]; };
+  ArrayView<uint32_t> rows() const{ return rows_; };
+
+private:
+  const AnnotationRecord* table_;
+  ArrayView<uint32_t> rows_;
+};
+
 struct Annotation{
   Annotation(const Value& value);
   Annotation();
@@ -53,27 +179,81 @@ struct Categories{
   std::string supercategory;
 };
 
+//record tables as they are read, before the lookups are built
+struct IndexBuilder{
+  IndexBuilder();
+  uint32_t AddString(const char* str, size_t length);
+  std::vector<ImageRecord> images;
+  std::vector<AnnotationRecord> annotations;
+  std::vector<CategoryRecord> categories;
+  std::vector<double> coords;
+  std::vector<uint32_t> rings;
+  std::vector<uint32_t> counts;
+  std::vector<char> strings;
+  std::vector<double> scores;
+};
+
+class MappedFile;
+
 struct COCO{
-  COCO(std::string annotation_file);
+  COCO(std::string annotation_file, bool use_cache = true);
   COCO();
-  void CreateIndex();
+  void CreateIndex(const Value& dataset);
+  void CreateIndex(IndexBuilder& builder);
   std::vector<int64_t> GetAnnIds(const std::vector<int> imgIds = std::vector<int>{}, const std::vector<int> catIds = std::vector<int>{}, const std::vector<float> areaRng = std::vector<float>{}, Crowd iscrowd=none);
   //info
   std::vector<int> GetCatIds(const std::vector<std::string> catNms = std::vector<std::string>{}, const std::vector<std::string> supNms = std::vector<std::string>{}, const std::vector<int> catIds = std::vector<int>{});
+  std::vector<int> GetImgIds();
   std::vector<Annotation> LoadAnns(std::vector<int64_t> ids);
   std::vector<Image> LoadImgs(std::vector<int> ids);
+  std::vector<Categories> LoadCats(std::vector<int> ids = std::vector<int>{});
   COCO LoadRes(std::string res_file);
-  COCO(const COCO& other);
-  COCO(COCO&& other);
-  COCO operator=(const COCO& other);
-  COCO operator=(COCO&& other);
-
-  Document dataset;
-  std::map<int64_t, Annotation> anns;
-  std::map<int, Image> imgs;
-  std::map<int, Categories> cats;
-  std::map<int, std::vector<Annotation>> imgToAnns;
-  std::map<int, std::vector<int>> catToImgs;
+
+  //flat index access, rows are in annotation file order
+  const ImageRecord* FindImage(int id) const;
+  const AnnotationRecord* FindAnnotation(int64_t id) const;
+  const CategoryRecord* FindCategory(int id) const;
+  ArrayView<uint32_t> ImageAnnotationRows(int image_id) const;
+  ArrayView<int32_t> CategoryImageIds(int category_id) const;
+  //secondary indexes, rows are in file order unless noted
+  AnnotationRange ImageAnnotations(int image_id) const;
+  AnnotationRange CategoryAnnotations(int category_id) const;
+  //area in (min_area, max_area) like GetAnnIds, rows in area order
+  AnnotationRange AnnotationsInArea(double min_area, double max_area) const;
+  AnnotationRange CrowdAnnotations() const;
+  Annotation ToAnnotation(const AnnotationRecord& record) const;
+  Image ToImage(const ImageRecord& record) const;
+  Categories ToCategories(const CategoryRecord& record) const;
+  const char* String(uint32_t offset) const;
+
+  Table<ImageRecord> images;
+  Table<AnnotationRecord> annotations;
+  Table<CategoryRecord> categories;
+  Table<double> coords;//polygon coordinates of every ring
+  Table<uint32_t> rings;//ring r spans coords[rings[r], rings[r+1])
+  Table<uint32_t> counts;//uncompressed rle counts
+  Table<char> strings;
+  Table<double> scores;//detection scores of a result set by annotation row, empty for ground truth
+  //rows sorted by id, for lookups
+  Table<uint32_t> img_by_id;
+  Table<uint32_t> ann_by_id;
+  Table<uint32_t> cat_by_id;
+  //csr, indexed by image / category row
+  Table<uint32_t> img_ann_offsets;
+  Table<uint32_t> img_ann_rows;
+  Table<uint32_t> cat_img_offsets;
+  Table<int32_t> cat_img_ids;
+  Table<uint32_t> cat_ann_offsets;
+  Table<uint32_t> cat_ann_rows;
+  Table<uint32_t> area_rows;//rows sorted by area
+  Table<uint32_t> crowd_rows;
+
+private:
+  void BuildLookups();
+  //keeps a mapped cache alive while the tables view it
+  std::shared_ptr<MappedFile> mapping_;
+
+friend bool LoadCache(COCO& coco, const std::string& cache_file, const std::string& annotation_file);
 };
 
 }
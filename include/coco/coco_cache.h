@@ -0,0 +1,83 @@
+#pragma once
+#include "coco.h"
+#include <cstdint>
+#include <string>
+
+
+namespace coco{
+
+//binary annotation cache
+//a header followed by the flat tables of COCO, every section 8-byte aligned,
+//so the tables can be used straight from the mapped file
+const char CACHE_MAGIC[8] = {'C', 'O', 'C', 'O', 'I', 'D', 'X', '\0'};
+const uint32_t CACHE_VERSION = 3;
+const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+enum CacheSection{
+  CACHE_IMAGES = 0,
+  CACHE_ANNOTATIONS,
+  CACHE_CATEGORIES,
+  CACHE_COORDS,
+  CACHE_RINGS,
+  CACHE_COUNTS,
+  CACHE_STRINGS,
+  CACHE_IMG_BY_ID,
+  CACHE_ANN_BY_ID,
+  CACHE_CAT_BY_ID,
+  CACHE_IMG_ANN_OFFSETS,
+  CACHE_IMG_ANN_ROWS,
+  CACHE_CAT_IMG_OFFSETS,
+  CACHE_CAT_IMG_IDS,
+  CACHE_CAT_ANN_OFFSETS,
+  CACHE_CAT_ANN_ROWS,
+  CACHE_AREA_ROWS,
+  CACHE_CROWD_ROWS,
+  CACHE_NUM_SECTIONS
+};
+
+//identifies the annotation file a cache was built from
+struct SourceStamp{
+  uint64_t size;
+  int64_t mtime;
+  uint64_t hash;//fnv-1a over the size and the first and last 1MB
+};
+
+struct CacheSectionEntry{
+  uint64_t offset;
+  uint64_t count;
+  uint64_t element_size;
+};
+
+struct CacheHeader{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  SourceStamp source;
+  CacheSectionEntry sections[CACHE_NUM_SECTIONS];
+};
+
+//read-only mapping of a whole file
+class MappedFile{
+
+public:
+  MappedFile(const std::string& path);
+  ~MappedFile();
+  MappedFile(const MappedFile& other) = delete;
+  MappedFile& operator=(const MappedFile& other) = delete;
+  bool valid() const;
+  const char* data() const;
+  size_t size() const;
+
+private:
+  void* data_;
+  size_t size_;
+};
+
+bool StampFile(const std::string& path, SourceStamp& stamp);
+std::string CachePath(const std::string& annotation_file);
+//writes to a temporary file and renames it, so readers never see a partial cache
+bool WriteCache(const COCO& coco, const std::string& cache_file, const std::string& annotation_file);
+//maps the cache into coco if it matches annotation_file
+bool LoadCache(COCO& coco, const std::string& cache_file, const std::string& annotation_file);
+
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include "coco.h"
+#include "mask.h"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace coco{
+
+//evaluation settings, the pycocotools defaults
+struct Params{
+  Params();
+  std::vector<int> img_ids;//sorted
+  std::vector<int> cat_ids;//sorted
+  std::vector<double> iou_thrs;
+  std::vector<double> rec_thrs;
+  std::vector<int> max_dets;//ascending
+  std::vector<std::array<double, 2>> area_rng;
+  std::vector<std::string> area_rng_lbl;
+};
+
+//matches of the detections of one (image, category) pair in one area range
+struct EvalImage{
+  //descending, at most max_dets.back()
+  std::vector<double> dt_scores;
+  //one row of dt_scores.size() per iou threshold
+  std::vector<uint8_t> dt_matched;
+  std::vector<uint8_t> dt_ignore;
+  //ground truths that are not ignored
+  int num_gt;
+};
+
+//COCOeval of pycocotools for "bbox" and "segm", with the same matching, interpolation and summary
+class COCOeval{
+
+public:
+  COCOeval(const COCO& coco_gt, const COCO& coco_dt, std::string iou_type = "bbox");
+  //online evaluation, the detections come in with AddImage
+  COCOeval(const COCO& coco_gt, std::string iou_type);
+  //(image, category) pairs are matched on separate threads
+  void Evaluate();
+  //matches the detections of one image right away and keeps only the matches.
+  //Accumulate and Summarize then cover the images added so far, boxes are rows of xywh
+  void AddImage(int image_id, const float* boxes, const float* scores, const int64_t* category_ids, size_t n);
+  //segm, one compressed rle per detection
+  void AddImage(int image_id, const std::vector<RLEstr>& rles, const float* scores, const int64_t* category_ids);
+  void Accumulate();
+  //prints the 12 standard metrics and keeps them in stats
+  void Summarize();
+
+  Params params;
+  //[t][r][k][a][m], -1 where a category has no ground truth
+  std::vector<double> precision;
+  //[t][k][a][m]
+  std::vector<double> recall;
+  std::vector<double> stats;
+
+private:
+  struct Pair{
+    int img;//index into params.img_ids
+    int cat;//index into params.cat_ids
+    std::vector<uint32_t> gt_rows;
+    std::vector<uint32_t> dt_rows;
+  };
+  //appends the annotation rows of image i to the pairs of their categories
+  void AddRows(const COCO& coco, int i, bool gt, std::vector<std::vector<Pair>>& by_cat) const;
+  //detections of one image, built like LoadRes builds them
+  void AddImage(int image_id, IndexBuilder& builder);
+  //ious[g * dts + d]
+  std::vector<double> ComputeIoU(const COCO& coco_dt, const std::vector<uint32_t>& gt_rows, const std::vector<uint32_t>& dt_rows) const;
+  void EvaluatePair(const COCO& coco_dt, Pair& pair, EvalImage* evals) const;
+  double SummarizeOne(bool ap, double iou_thr, const std::string& area_rng, int max_dets) const;
+
+  COCO coco_gt_;
+  COCO coco_dt_;
+  std::string iou_type_;
+  //pairs with a ground truth or a detection, by category then image.
+  //online pairs are kept in the order of their images, without their rows
+  std::vector<Pair> pairs_;
+  //[pair][a]
+  std::vector<EvalImage> eval_imgs_;
+  //online, by index into params.img_ids
+  std::vector<uint8_t> added_;
+};
+
+}
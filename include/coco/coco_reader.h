@@ -0,0 +1,12 @@
+#pragma once
+#include "coco.h"
+#include <string>
+
+
+namespace coco{
+
+//streams an instances json through rapidjson's sax reader straight into the record tables
+//no dom is built, so peak memory stays close to the size of the final index
+bool ReadAnnotationFile(const std::string& annotation_file, IndexBuilder& builder);
+
+}
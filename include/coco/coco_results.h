@@ -0,0 +1,65 @@
+#pragma once
+#include "coco.h"
+#include "mask.h"
+#include "rapidjson/filewritestream.h"
+#include "rapidjson/writer.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace coco{
+
+//compact detections file, a header followed by fixed size records in the order they were written
+const char RESULTS_MAGIC[8] = {'C', 'O', 'C', 'O', 'R', 'E', 'S', '\0'};
+const uint32_t RESULTS_VERSION = 1;
+
+struct ResultsHeader{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+};
+
+struct DetectionRecord{
+  int64_t image_id;
+  int32_t category_id;
+  float score;
+  float bbox[4];//xywh
+};
+
+//writes detections while they are produced, one image at a time, through a fixed buffer.
+//json files are what LoadRes reads, binary files are read by LoadDetections
+class ResultsWriter{
+
+public:
+  ResultsWriter(const std::string& results_file, bool binary = false);
+  ~ResultsWriter();
+  //n boxes as rows of xywh, category ids are json ids. false when the file could not be opened
+  bool Write(int64_t image_id, const float* boxes, const float* scores, const int64_t* category_ids, size_t n);
+  //one compressed rle per detection, json only
+  bool Write(int64_t image_id, const std::vector<RLEstr>& rles, const float* scores, const int64_t* category_ids);
+  //ends the json array and closes the file, false when the file could not be opened or a write failed
+  bool Close();
+  size_t count() const;
+
+private:
+  FILE* file_;
+  bool binary_;
+  size_t count_;
+  std::vector<char> buffer_;
+  std::unique_ptr<FileWriteStream> stream_;
+  std::unique_ptr<Writer<FileWriteStream>> writer_;
+};
+
+//compressed rles of n row major h x w masks, any non zero byte is set.
+//the masks are encoded on separate threads, each straight from its bytes
+std::vector<RLEstr> EncodeMasks(const uint8_t* masks, siz n, siz h, siz w);
+
+//the result set of coco_gt in a binary detections file, like LoadRes for bbox results.
+//a missing or invalid file gives a result set without detections
+COCO LoadDetections(const COCO& coco_gt, const std::string& results_file);
+
+}
@@ -43,6 +43,9 @@ void rleArea(const RLE *R, siz n, uint *a );
 /* Compute intersection over union between masks. */
 void rleIou(RLE *dt, RLE *gt, siz m, siz n, byte *iscrowd, double *o);
 
+/* Compute intersection over union between two encoded masks, -1 when their sizes differ. */
+double rleIouPair( const RLE *dt, const RLE *gt, int iscrowd );
+
 /* Compute non-maximum suppression between bounding masks */
 void rleNms( RLE *dt, siz n, uint *keep, double thr );
 
@@ -61,6 +64,9 @@ void rleFrBbox( RLE *R, const BB bb, siz h, siz w, siz n );
 /* Convert polygon to encoded mask. */
 void rleFrPoly( RLE *R, const double *xy, siz k, siz h, siz w );
 
+/* Set the pixels of a polygon in a row major h*w mask, same pixels as rleFrPoly. */
+void polyFill( const double *xy, siz k, siz h, siz w, float *mask );
+
 /* Get compressed string representation of encoded mask. */
 char* rleToString( const RLE *R );
 
@@ -0,0 +1,50 @@
+#pragma once
+#include <torch/torch.h>
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+
+namespace rcnn{
+namespace data{
+
+//reusable float buffers for batched images, bucketed by shape. tensors handed out
+//give their buffer back to the pool once the last reference to them is gone
+class BatchBufferPool{
+
+public:
+  //at most max_bytes of idle buffers are kept, the rest are freed on release
+  BatchBufferPool(int64_t max_bytes);
+  //uninitialized
+  torch::Tensor Get(std::vector<int64_t> shape);
+
+  int64_t hits() const;
+  int64_t misses() const;
+  //idle buffers waiting in the pool
+  int64_t bytes_held() const;
+  //buffers referenced by live tensors
+  int64_t bytes_in_use() const;
+
+private:
+  //outlives the pool while tensors still reference its buffers
+  struct State{
+    State(int64_t max_bytes) :max_bytes(max_bytes), hits(0), misses(0), bytes_held(0), bytes_in_use(0){};
+    ~State();
+    void Release(const std::vector<int64_t>& shape, float* buffer);
+    std::mutex mutex;
+    std::map<std::vector<int64_t>, std::vector<float*>> idle;
+    int64_t max_bytes;
+    int64_t hits;
+    int64_t misses;
+    int64_t bytes_held;
+    int64_t bytes_in_use;
+  };
+  std::shared_ptr<State> state_;
+};
+
+std::ostream& operator << (std::ostream& os, const BatchBufferPool& pool);
+
+}//data
+}//rcnn
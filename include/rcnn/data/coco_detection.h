@@ -8,21 +8,66 @@
 #include <opencv2/highgui.hpp>
 #include "bounding_box.h"
 #include "coco.h"
+#include "image_cache.h"
+#include "shard.h"
+#include <memory>
+#include <mutex>
+#include <unordered_set>
 
 
 namespace rcnn{
 namespace data{
 
-class COCODetection : public torch::data::datasets::Dataset<COCODetection, torch::data::Example<cv::Mat, std::vector<coco::Annotation>>> {
+struct DetectionTarget{
+  coco::AnnotationRange annotations;
+  //size the annotations refer to, a reduced decode makes the image smaller than this
+  int64_t width;
+  int64_t height;
+};
+
+class COCODetection : public torch::data::datasets::Dataset<COCODetection, torch::data::Example<cv::Mat, DetectionTarget>> {
 
 public:
   COCODetection(std::string root, std::string annFile/*TODO transform=*/);
-  torch::data::Example<cv::Mat, std::vector<coco::Annotation>> get(size_t index) override;
+  //images and annotations both come from packed shards
+  COCODetection(std::shared_ptr<ShardSet> shards);
+  torch::data::Example<cv::Mat, DetectionTarget> get(size_t index) override;
   torch::optional<size_t> size() const override;
+  //encoded caches keep the file bytes and decode on every access
+  void SetImageCache(std::shared_ptr<ImageCache> image_cache, bool encoded = false);
+  //images are decoded at 1/2, 1/4 or 1/8 scale when Resize(min_size, max_size) shrinks them at least that much
+  void SetDecodeSize(int min_size, int max_size);
+  //image ids in index order
+  const std::vector<int>& ids() const;
+  void SetIds(std::vector<int> ids);
 
   std::string root_;
+  //copies share the tables of the index
   coco::COCO coco_;
-  std::vector<int> ids_;
+  //shared by the copies handed to the data loader, may be null
+  std::shared_ptr<ImageCache> image_cache_;
+  bool image_cache_encoded_;
+  //0 decodes at full resolution
+  int decode_min_size_;
+  int decode_max_size_;
+  //null when images are read from root_
+  std::shared_ptr<ShardSet> shards_;
+
+private:
+  //shared by the copies handed to the data loader, replaced but never modified
+  std::shared_ptr<const std::vector<int>> ids_;
+  //images whose files do not have their annotated size, decoded at full resolution from then on.
+  //shared by the copies handed to the data loader
+  struct FullSizeIds{
+    std::mutex mutex;
+    std::unordered_set<int> ids;
+  };
+  std::shared_ptr<FullSizeIds> full_size_ids_;
+
+  int DecodeReduction(const coco::ImageRecord& info) const;
+  cv::Mat LoadImage(int img_id, const std::string& path, int reduction);
+  cv::Mat ReadImage(int img_id, const std::string& path, int flags);
+  std::vector<uchar> ReadBytes(int img_id, const std::string& path);
 
 friend std::ostream& operator << (std::ostream& os, const COCODetection& bml);
 };
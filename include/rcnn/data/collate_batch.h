@@ -5,19 +5,52 @@
 #include <bounding_box.h>
 #include <image_list.h>
 #include "datasets/coco_datasets.h"
+#include "transforms/transforms.h"
+#include "batch_buffer_pool.h"
+#include <atomic>
+#include <memory>
+#include <ostream>
 
 
 namespace rcnn{
 namespace data{
 
 using batch = std::tuple<rcnn::structures::ImageList, std::vector<rcnn::structures::BoxList>, std::vector<int64_t>>;
+
+//share of the batched pixels that are padding, what the backbone computes for nothing
+class PaddingStats{
+
+public:
+  PaddingStats();
+  void Add(int64_t image_pixels, int64_t batch_pixels);
+  double padded_fraction() const;
+  int64_t batches() const;
+  void Reset();
+
+private:
+  std::atomic<int64_t> image_pixels_;
+  std::atomic<int64_t> batch_pixels_;
+  std::atomic<int64_t> batches_;
+
+friend std::ostream& operator << (std::ostream& os, const PaddingStats& stats);
+};
+
 //<output, input>
-struct BatchCollator : public torch::data::transforms::Collation<batch, std::vector<torch::data::Example<torch::Tensor, RCNNData>>>{
+//applies the transforms while collating. with a fused transform every image is written
+//straight into its slot of the padded batch and only the padding is zeroed
+struct BatchCollator : public torch::data::transforms::Collation<batch, std::vector<torch::data::Example<cv::Mat, RCNNData>>>{
 
-  BatchCollator(int size_divisible);
-  batch apply_batch(std::vector<torch::data::Example<torch::Tensor, RCNNData>> examples) override;
+  //batches are drawn from pool when one is given. a positive mask_raster_resolution adds the field mask_rasters,
+  //every target mask rasterized over its own box, so the mask loss does not rasterize on the training thread
+  BatchCollator(Compose transforms, int size_divisible, std::shared_ptr<BatchBufferPool> pool = nullptr, int mask_raster_resolution = 0);
+  batch apply_batch(std::vector<torch::data::Example<cv::Mat, RCNNData>> examples) override;
 
+  Compose transforms_;
   int size_divisible_;
+  std::shared_ptr<BatchBufferPool> pool_;
+  int mask_raster_resolution_;
+  //shared by the copies handed to the data loader
+  std::shared_ptr<PaddingStats> padding_;
 
 };
 
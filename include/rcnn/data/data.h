@@ -1,6 +1,7 @@
 #pragma once
 
 #include "datasets/coco_datasets.h"
+#include "datasets/concat_dataset.h"
 #include "datasets/evaluation/coco/coco_eval.h"
 
 #include "samplers/build.h"
@@ -12,6 +12,8 @@ namespace data{
 
 bool has_valid_annotation(std::vector<coco::Annotation> anno);
 bool _has_only_empty_bbox(std::vector<coco::Annotation> anno);
+bool has_valid_annotation(const coco::AnnotationRange& anno);
+bool _has_only_empty_bbox(const coco::AnnotationRange& anno);
 
 struct RCNNData{
   int64_t idx;
@@ -33,16 +35,37 @@ class COCODataset : public torch::data::datasets::Dataset<COCODataset, torch::da
 
 public:
   COCODataset(std::string annFile, std::string root, bool remove_images_without_annotations);
+  COCODataset(std::shared_ptr<ShardSet> shards, bool remove_images_without_annotations);
   torch::data::Example<cv::Mat, RCNNData> get(size_t index) override;
   torch::optional<size_t> size() const override;
   coco::Image get_img_info(int64_t index);
+  //target of one image, without decoding it
+  rcnn::structures::BoxList BuildTarget(const coco::AnnotationRange& anno, std::pair<int64_t, int64_t> image_size);
+  const std::map<int64_t, std::string>& categories() const;
+  const std::map<int64_t, int64_t>& json_category_id_to_contiguous_id() const;
+  const std::map<int64_t, int64_t>& contiguous_category_id_to_json_id() const;
+  //coco image id of a dataset index
+  int64_t id_to_img_map(int64_t index) const;
+  //width and height of a dataset index, without touching the annotations
+  std::pair<int, int> image_size(int64_t index) const;
 
-  std::map<int64_t, std::string> categories;
-  std::map<int64_t, int64_t> json_category_id_to_contiguous_id;
-  std::map<int64_t, int64_t> contiguous_category_id_to_json_id;
-  std::map<int64_t, int64_t> id_to_img_map;
+  //copies share the annotation index, copying a dataset for the data loader is cheap
   COCODetection coco_detection;
   //transforms
+
+private:
+  struct Index{
+    std::map<int64_t, std::string> categories;
+    std::map<int64_t, int64_t> json_category_id_to_contiguous_id;
+    std::map<int64_t, int64_t> contiguous_category_id_to_json_id;
+    //width and height by dataset index
+    std::vector<std::pair<int, int>> image_sizes;
+  };
+
+  //annotation_file names the stats sidecar, empty computes the stats without saving them
+  void Init(bool remove_images_without_annotations, const std::string& annotation_file);
+  //built once in Init and shared by every copy
+  std::shared_ptr<const Index> index_;
 };
 
 }
@@ -1,15 +1,60 @@
-// #pragma once
-// #include "datasets/coco_datasets.h"
+#pragma once
+#include "datasets/coco_datasets.h"
 
+#include <torch/data/example.h>
+#include <torch/data/datasets/base.h>
 
-// namespace rcnn{
-// namespace data{
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
 
-// class ConcatDataset_ : public RCNNDataset<ConcatDataset_>{
 
-// public:
-  
-// }
+namespace rcnn{
+namespace data{
 
-// }
-// }
\ No newline at end of file
+//several datasets behind one index space, a member is opened the first time it is used
+//a global index packs the member above MEMBER_SHIFT bits and the local index below them,
+//so member 0 uses the same indices as its dataset alone
+class ConcatDataset : public torch::data::datasets::Dataset<ConcatDataset, torch::data::Example<cv::Mat, RCNNData>>{
+
+public:
+  using Opener = std::function<COCODataset()>;
+  static const int MEMBER_SHIFT = 40;
+
+  //weights are the sampling weights of the members, empty samples them uniformly
+  ConcatDataset(std::vector<std::string> names, std::vector<Opener> openers, std::vector<float> weights = std::vector<float>{});
+  torch::data::Example<cv::Mat, RCNNData> get(size_t index) override;
+  //opens every member
+  torch::optional<size_t> size() const override;
+  size_t num_members() const;
+  //opens the member if needed, thread safe
+  COCODataset& member(size_t m) const;
+  bool opened(size_t m) const;
+  const std::string& name(size_t m) const;
+  const std::vector<float>& weights() const;
+
+  static size_t Encode(size_t member, size_t local);
+  static std::pair<size_t, size_t> Decode(size_t index);
+
+private:
+  struct Member{
+    std::string name;
+    Opener opener;
+    std::once_flag once;
+    std::unique_ptr<COCODataset> dataset;
+    std::atomic<bool> opened;
+  };
+  //shared by the copies handed to the data loader, so a member is opened once
+  std::vector<std::shared_ptr<Member>> members_;
+  std::vector<float> weights_;
+
+friend std::ostream& operator << (std::ostream& os, const ConcatDataset& dataset);
+};
+
+}//data
+}//rcnn
@@ -0,0 +1,54 @@
+#pragma once
+#include <coco.h>
+#include <coco_cache.h>
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+
+namespace rcnn{
+namespace data{
+
+//tables a dataset derives from its annotations at startup, saved in a sidecar next to the annotation file
+//and reused while the annotation file keeps its stamp. aspect ratios and group ids depend on the config
+//and are recomputed from the sizes, which does not touch the annotations
+const char STATS_MAGIC[8] = {'R', 'C', 'N', 'N', 'S', 'T', 'T', '\0'};
+const uint32_t STATS_VERSION = 1;
+
+struct ImageStats{
+  int32_t id;
+  int32_t width;
+  int32_t height;
+  //has an annotation has_valid_annotation accepts
+  int32_t valid;
+};
+
+struct StatsHeader{
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+  coco::SourceStamp source;
+  uint64_t num_images;
+  uint64_t num_categories;
+};
+
+struct DatasetStats{
+  //sorted by id
+  std::vector<ImageStats> images;
+  //json category ids, contiguous id i + 1 maps to category_ids[i]
+  std::vector<int32_t> category_ids;
+};
+
+//validity is checked on several threads
+DatasetStats ComputeStats(const coco::COCO& coco);
+std::string StatsPath(const std::string& annotation_file);
+//writes to a temporary file and renames it like coco::WriteCache
+bool WriteStats(const DatasetStats& stats, const std::string& stats_file, const std::string& annotation_file);
+//false when the sidecar is missing or was written for another version of annotation_file
+bool LoadStats(DatasetStats& stats, const std::string& stats_file, const std::string& annotation_file);
+//loads the sidecar of annotation_file or computes and saves it, an empty annotation_file only computes
+DatasetStats LoadOrComputeStats(const coco::COCO& coco, const std::string& annotation_file);
+
+}//data
+}//rcnn
@@ -2,6 +2,7 @@
 #include "datasets/coco_datasets.h"
 
 #include <bounding_box.h>
+#include <coco_eval.h>
 
 #include "rapidjson/document.h"
 
@@ -17,12 +18,31 @@ using namespace rapidjson;
 void DoCOCOEvaluation(COCODataset& dataset, 
                  std::map<int64_t, rcnn::structures::BoxList>& predictions,
                  std::string output_folder,
-                 std::set<std::string> iou_types,
-                 std::string ann_file);
+                 std::set<std::string> iou_types);
                  //TODO expected results
 
-void prepare_for_coco_detection(std::string output_folder, std::map<int64_t, rcnn::structures::BoxList>& predictions, COCODataset& dataset); 
-void prepare_for_coco_segmentation(std::map<int64_t, rcnn::structures::BoxList>& predictions, COCODataset& dataset);
+//streams the detections to bbox.json, or to binary records in bbox.bin
+void prepare_for_coco_detection(std::string output_folder, std::map<int64_t, rcnn::structures::BoxList>& predictions, COCODataset& dataset, bool binary = false);
+//pastes the masks into the original images and streams their rles to segm.json
+void prepare_for_coco_segmentation(std::string output_folder, std::map<int64_t, rcnn::structures::BoxList>& predictions, COCODataset& dataset);
+//AP, AP50, AP75, APs, APm, APl of each iou type
+void PrintCOCOResults(const std::map<std::string, std::vector<double>>& results);
+
+//evaluates predictions while they are produced, only the matches of each image are kept
+class COCOOnlineEvaluation{
+
+public:
+  COCOOnlineEvaluation(COCODataset& dataset, std::set<std::string> iou_types);
+  void Add(int64_t image_id, rcnn::structures::BoxList prediction);
+  //stats of each iou type over the images added so far
+  std::map<std::string, std::vector<double>> Summarize();
+  size_t count() const;
+
+private:
+  COCODataset& dataset_;
+  std::map<std::string, coco::COCOeval> evals_;
+  size_t count_;
+};
 
 }
 }
\ No newline at end of file
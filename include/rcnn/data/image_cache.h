@@ -0,0 +1,60 @@
+#pragma once
+#include <opencv2/core.hpp>
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace rcnn{
+namespace data{
+
+//lru cache of images keyed by image id, split into shards with their own lock and
+//an equal part of the byte budget. cached mats share their buffer with callers,
+//so callers must not write into them
+class ImageCache{
+
+public:
+  ImageCache(int64_t byte_budget, int num_shards = 16);
+  ImageCache(const ImageCache& other) = delete;
+  ImageCache& operator=(const ImageCache& other) = delete;
+
+  //sets img and returns true on a hit
+  bool Get(int64_t id, cv::Mat& img);
+  //images larger than a shard's budget are not cached
+  void Put(int64_t id, const cv::Mat& img);
+  void Clear();
+
+  int64_t hits() const;
+  int64_t misses() const;
+  int64_t evictions() const;
+  int64_t bytes() const;
+  int64_t byte_budget() const;
+
+private:
+  struct Shard{
+    Shard() :bytes(0){};
+    std::mutex mutex;
+    //most recently used first
+    std::list<std::pair<int64_t, cv::Mat>> lru;
+    std::unordered_map<int64_t, std::list<std::pair<int64_t, cv::Mat>>::iterator> entries;
+    int64_t bytes;
+  };
+  Shard& GetShard(int64_t id);
+
+  std::vector<std::unique_ptr<Shard>> shards_;
+  int64_t byte_budget_;
+  int64_t shard_budget_;
+  std::atomic<int64_t> hits_;
+  std::atomic<int64_t> misses_;
+  std::atomic<int64_t> evictions_;
+};
+
+std::ostream& operator << (std::ostream& os, const ImageCache& cache);
+
+}//data
+}//rcnn
@@ -0,0 +1,154 @@
+#pragma once
+#include <torch/torch.h>
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+#include "collate_batch.h"
+
+
+namespace rcnn{
+namespace data{
+
+//iterates a data loader on a background thread and keeps up to depth batches ready,
+//with images and targets already moved to device. the loader blocks while the queue is full.
+//a queue that is mostly empty when the next batch is asked for means training is loader bound
+template<typename DataLoader>
+class Prefetcher{
+
+public:
+  Prefetcher(DataLoader& loader, torch::Device device, int depth)
+            :loader_(loader),
+             device_(device),
+             depth_(std::max(depth, 1)),
+             done_(false),
+             stop_(false),
+             requests_(0),
+             occupancy_(0),
+             starved_(0),
+             wait_time_(std::chrono::duration<double>::zero())
+  {
+    worker_ = std::thread(&Prefetcher::Run, this);
+  };
+
+  ~Prefetcher(){
+    {
+      std::lock_guard<std::mutex> lock(mutex_);
+      stop_ = true;
+    }
+    not_full_.notify_all();
+    worker_.join();
+  };
+
+  Prefetcher(const Prefetcher& other) = delete;
+  Prefetcher& operator=(const Prefetcher& other) = delete;
+
+  //empty once the loader is exhausted
+  torch::optional<batch> Next(){
+    std::unique_lock<std::mutex> lock(mutex_);
+    requests_++;
+    occupancy_ += queue_.size();
+    if(queue_.empty() && !done_){
+      starved_++;
+      auto start = std::chrono::system_clock::now();
+      not_empty_.wait(lock, [this]{ return !queue_.empty() || done_; });
+      wait_time_ += std::chrono::system_clock::now() - start;
+    }
+    if(queue_.empty()){
+      if(error_)
+        std::rethrow_exception(error_);
+      return torch::nullopt;
+    }
+    torch::optional<batch> out(std::move(queue_.front()));
+    queue_.pop_front();
+    not_full_.notify_one();
+    return out;
+  };
+
+  int depth() const{
+    return depth_;
+  };
+
+  //batches waiting in the queue when one was asked for, on average
+  double mean_occupancy() const{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return requests_ > 0 ? static_cast<double>(occupancy_) / requests_ : 0.0;
+  };
+
+  //requests that found the queue empty
+  int64_t starved() const{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return starved_;
+  };
+
+  double wait_seconds() const{
+    std::lock_guard<std::mutex> lock(mutex_);
+    return wait_time_.count();
+  };
+
+private:
+  void Run(){
+    try{
+      for(auto& loaded : loader_){
+        std::vector<rcnn::structures::BoxList> targets;
+        targets.reserve(std::get<1>(loaded).size());
+        for(auto& target : std::get<1>(loaded))
+          targets.push_back(target.To(device_));
+        batch prepared = std::make_tuple(std::get<0>(loaded).to(device_), targets, std::get<2>(loaded));
+
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this]{ return static_cast<int>(queue_.size()) < depth_ || stop_; });
+        if(stop_)
+          break;
+        queue_.push_back(std::move(prepared));
+        not_empty_.notify_one();
+      }
+    }
+    catch(...){
+      std::lock_guard<std::mutex> lock(mutex_);
+      error_ = std::current_exception();
+    }
+    std::lock_guard<std::mutex> lock(mutex_);
+    done_ = true;
+    not_empty_.notify_all();
+  };
+
+  DataLoader& loader_;
+  torch::Device device_;
+  int depth_;
+  std::deque<batch> queue_;
+  mutable std::mutex mutex_;
+  std::condition_variable not_empty_;
+  std::condition_variable not_full_;
+  bool done_;
+  bool stop_;
+  std::exception_ptr error_;
+  int64_t requests_;
+  int64_t occupancy_;
+  int64_t starved_;
+  std::chrono::duration<double> wait_time_;
+  std::thread worker_;
+};
+
+template<typename DataLoader>
+std::unique_ptr<Prefetcher<DataLoader>> MakePrefetcher(DataLoader& loader, torch::Device device, int depth){
+  return std::unique_ptr<Prefetcher<DataLoader>>(new Prefetcher<DataLoader>(loader, device, depth));
+}
+
+template<typename DataLoader>
+std::ostream& operator << (std::ostream& os, const Prefetcher<DataLoader>& prefetcher){
+  os << "Prefetcher(";
+  os << "occupancy=" << prefetcher.mean_occupancy() << "/" << prefetcher.depth() << ", ";
+  os << "starved=" << prefetcher.starved() << ", ";
+  os << "wait=" << prefetcher.wait_seconds() << "s)";
+  return os;
+}
+
+}//data
+}//rcnn
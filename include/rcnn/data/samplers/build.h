@@ -1,6 +1,7 @@
 #pragma once
 #include "samplers/samplers.h"
 #include "datasets/coco_datasets.h"
+#include "datasets/concat_dataset.h"
 #include <torch/data/samplers/base.h>
 
 
@@ -8,11 +9,19 @@ namespace rcnn{
 namespace data{
 
 std::shared_ptr<torch::data::samplers::Sampler<>> make_data_sampler(int dataset_size, bool shuffle/*, distributed*/);
-std::vector<int> _quantize(std::vector<int> bins, std::vector<int> x);
-std::vector<float> _compute_aspect_ratios(COCODataset dataset);
-std::shared_ptr<torch::data::samplers::Sampler<>> make_batch_data_sampler(COCODataset dataset, 
+std::vector<int> _quantize(std::vector<float> x, std::vector<float> bins);
+std::vector<float> _compute_aspect_ratios(COCODataset& dataset);
+//(height, width) of every image after Resize(min_size, max_size)
+std::vector<std::pair<int, int>> _compute_resized_sizes(COCODataset& dataset, int min_size, int max_size);
+//images whose resized height and width round up to the same multiples of step share a bucket
+std::vector<int> _compute_size_buckets(const std::vector<std::pair<int, int>>& sizes, int step);
+//runs of consecutive dataset indices stored in the same shard
+std::vector<std::pair<size_t, size_t>> _compute_shard_ranges(COCODataset& dataset);
+std::shared_ptr<torch::data::samplers::Sampler<>> make_batch_data_sampler(COCODataset& dataset, 
                                                                           bool is_train,
                                                                           int start_iter);
+//training sampler, one member samples like make_batch_data_sampler, several stream weighted batches
+std::shared_ptr<torch::data::samplers::Sampler<>> make_concat_batch_sampler(ConcatDataset& dataset, int start_iter);
 
 }
 }
\ No newline at end of file
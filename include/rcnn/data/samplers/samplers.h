@@ -1,5 +1,8 @@
 #pragma once
+#include <functional>
+#include <map>
 #include <memory>
+#include <random>
 
 #include <torch/torch.h>
 #include <torch/data/samplers/base.h>
@@ -18,19 +21,87 @@ public:
   void load(torch::serialize::InputArchive& archive) override;
 
 private:
-  torch::Tensor init_group_id(std::vector<int> group_ids);
-  std::vector<torch::Tensor> _prepare_batches();
+  //slot of every dataset index in groups
+  std::vector<int> init_group_id(const std::vector<int>& group_ids);
+  //draws one epoch from sampler_ and plans its batches
+  std::vector<std::vector<size_t>> _prepare_batches();
+  std::vector<std::vector<size_t>> _plan_batches(const std::vector<int64_t>& sampled_ids) const;
 
   std::shared_ptr<torch::data::samplers::Sampler<>> sampler_;
-  torch::Tensor group_ids_, sampled_ids_;
+  std::vector<int> groups;//sorted distinct group ids
+  std::vector<int> group_ids_, group_slots_;
+  std::vector<int64_t> sampled_ids_;
   int batch_size_;
   bool drop_uneven_;
-  torch::Tensor groups;
-  std::vector<torch::Tensor> _batches;
-  bool _can_reuse_batches = false;
+  std::vector<std::vector<size_t>> _batches;
   int index_ = 0;
 };
 
+//visits shards in random order and the images of each shard in random order,
+//so the reads of consecutive samples stay within one shard
+class ShardSampler : public torch::data::samplers::Sampler<>{
+
+public:
+  //[begin, end) dataset indices of every shard
+  ShardSampler(std::vector<std::pair<size_t, size_t>> ranges);
+  void reset(torch::optional<size_t> new_size) override;
+  torch::optional<std::vector<size_t>> next(size_t batch_size) override;
+  void save(torch::serialize::OutputArchive& archive) const override;
+  void load(torch::serialize::InputArchive& archive) override;
+
+private:
+  std::vector<std::pair<size_t, size_t>> ranges_;
+  torch::Tensor indices_;
+  int64_t index_;
+};
+
+//yields a fixed order of indices, like SequentialSampler over a permutation
+class OrderedSampler : public torch::data::samplers::Sampler<>{
+
+public:
+  OrderedSampler(std::vector<size_t> order);
+  void reset(torch::optional<size_t> new_size) override;
+  torch::optional<std::vector<size_t>> next(size_t batch_size) override;
+  void save(torch::serialize::OutputArchive& archive) const override;
+  void load(torch::serialize::InputArchive& archive) override;
+
+private:
+  std::vector<size_t> order_;
+  size_t index_;
+};
+
+//endless stream of batches over the members of a ConcatDataset
+//every draw picks a member by weight and takes its next image in a per-member random order,
+//an image waits with others of its group until the group fills a batch
+//a member's group ids are loaded the first time it is picked
+class WeightedBatchSampler : public torch::data::samplers::Sampler<>{
+
+public:
+  using GroupLoader = std::function<std::vector<int>(size_t member)>;
+  WeightedBatchSampler(std::vector<float> weights, GroupLoader load_groups, int batch_size);
+  void reset(torch::optional<size_t> new_size) override;
+  torch::optional<std::vector<size_t>> next(size_t batch_size) override;
+  void save(torch::serialize::OutputArchive& archive) const override;
+  void load(torch::serialize::InputArchive& archive) override;
+
+private:
+  struct Member{
+    bool loaded = false;
+    std::vector<int> group_ids;
+    std::vector<size_t> order;
+    size_t position = 0;
+  };
+  size_t Draw(size_t m);
+
+  GroupLoader load_groups_;
+  int batch_size_;
+  std::vector<Member> members_;
+  std::discrete_distribution<size_t> pick_;
+  std::mt19937_64 engine_;
+  //global indices waiting for their group to fill a batch
+  std::map<int, std::vector<size_t>> pending_;
+};
+
 class IterationBasedBatchSampler : public torch::data::samplers::Sampler<>{
 
 public:
@@ -0,0 +1,122 @@
+#pragma once
+#include "coco.h"
+#include "coco_cache.h"
+#include <atomic>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+
+namespace rcnn{
+namespace data{
+
+//packed dataset shard
+//encoded images back to back, then the targets of those images as flat coco tables,
+//then a footer locating every section, so one image is one seek and a whole shard one sequential read
+const char SHARD_MAGIC[8] = {'R', 'C', 'N', 'N', 'S', 'H', 'D', '\0'};
+const uint32_t SHARD_VERSION = 2;
+const char SHARD_EXTENSION[] = ".shard";
+
+enum ShardSection{
+  SHARD_ENTRIES = 0,
+  SHARD_IMAGES,
+  SHARD_ANNOTATIONS,
+  SHARD_CATEGORIES,
+  SHARD_COORDS,
+  SHARD_RINGS,
+  SHARD_COUNTS,
+  SHARD_STRINGS,
+  SHARD_NUM_SECTIONS
+};
+
+//encoded bytes of one image, entries are in the order the images were added
+struct ShardEntry{
+  int32_t image_id;
+  uint32_t reserved;
+  uint64_t offset;
+  uint64_t size;
+};
+
+//last bytes of a shard
+struct ShardFooter{
+  coco::CacheSectionEntry sections[SHARD_NUM_SECTIONS];
+  char magic[8];
+  uint32_t version;
+  uint32_t byte_order;
+};
+
+class ShardWriter{
+
+public:
+  //writes to a temporary file that Close renames to path
+  ShardWriter(const std::string& path);
+  //appends the bytes of image_id, its record, annotations and every category are copied from coco
+  void Add(const coco::COCO& coco, int image_id, const std::vector<unsigned char>& bytes);
+  //writes the targets and the footer
+  bool Close();
+  size_t size() const;
+  uint64_t bytes() const;
+
+private:
+  std::string path_;
+  std::ofstream ofs_;
+  coco::IndexBuilder targets_;
+  std::vector<ShardEntry> entries_;
+  uint64_t offset_;
+};
+
+class ShardReader{
+
+public:
+  ShardReader(const std::string& path);
+  ~ShardReader();
+  ShardReader(const ShardReader& other) = delete;
+  ShardReader& operator=(const ShardReader& other) = delete;
+  bool valid() const;
+  //appends the targets to builder, categories only when builder has none yet
+  bool ReadTargets(coco::IndexBuilder& builder) const;
+  //thread safe, the first read of every pass asks the kernel to read the whole shard ahead
+  bool Read(size_t entry, std::vector<unsigned char>& bytes);
+  const std::vector<ShardEntry>& entries() const;
+  const std::string& path() const;
+
+private:
+  template<typename T>
+  bool ReadSection(ShardSection section, std::vector<T>& values) const;
+
+  std::string path_;
+  int fd_;
+  uint64_t size_;
+  ShardFooter footer_;
+  std::vector<ShardEntry> entries_;
+  std::atomic<uint64_t> reads_;
+};
+
+//every shard of a directory, in file name order
+class ShardSet{
+
+public:
+  ShardSet(const std::string& directory);
+  //builds the index of every shard's targets into coco
+  void LoadTargets(coco::COCO& coco) const;
+  bool Read(int image_id, std::vector<unsigned char>& bytes);
+  //shard holding image_id, -1 if none does
+  int Find(int image_id) const;
+  size_t size() const;
+  const std::string& directory() const;
+
+private:
+  std::string directory_;
+  std::vector<std::unique_ptr<ShardReader>> shards_;
+  //image id to shard and entry
+  std::unordered_map<int, std::pair<int, uint32_t>> locations_;
+
+friend std::ostream& operator << (std::ostream& os, const ShardSet& shards);
+};
+
+}//data
+}//rcnn
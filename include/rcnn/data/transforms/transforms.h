@@ -57,6 +57,29 @@ private:
   float prob_;
 };
 
+//random brightness, contrast, saturation and hue with the factor ranges of torchvision's ColorJitter,
+//always applied in the fixed order brightness, contrast, saturation, hue. the hue shift is a rotation
+//around the gray axis in yiq space rather than an hsv shift. the four adjustments are linear in the pixel
+//values, so they fold into one 3x4 matrix applied by cv::transform with a single saturating uint8 clamp
+//at the end instead of a clamp after each step
+class ColorJitter : public MatToMatTransform{
+
+public:
+  ColorJitter(float brightness = 0, float contrast = 0, float saturation = 0, float hue = 0);
+  torch::data::Example<cv::Mat, RCNNData> operator()(torch::data::Example<cv::Mat, RCNNData> input) override;
+  //draws the factors and returns an adjusted copy of the bgr image
+  cv::Mat Apply(const cv::Mat& img) const;
+  //affine map on bgr pixels, mean_gray is only used by the contrast
+  static cv::Matx34f Matrix(float brightness_factor, float contrast_factor, float saturation_factor, float hue_factor, float mean_gray);
+  bool enabled() const;
+
+private:
+  float brightness_;
+  float contrast_;
+  float saturation_;
+  float hue_;
+};
+
 class ToTensor : public MatToTensorTransform{
 
 public:
@@ -74,17 +97,43 @@ private:
   bool to_bgr255_;
 };
 
+//Resize, ColorJitter, RandomHorizontalFlip, RandomVerticalFlip, ToTensor and Normalize in one transform.
+//the image is resized once, then a single pass reads it mirrored as needed and writes
+//normalized chw planes through a per-channel table holding the values of ToTensor + Normalize
+class ResizeFlipNormalize : public MatToTensorTransform{
+
+public:
+  ResizeFlipNormalize(int min_size, int max_size, float horizontal_flip_prob, float vertical_flip_prob,
+                      std::vector<float> mean, std::vector<float> stddev, bool to_bgr255, ColorJitter color_jitter = ColorJitter());
+  torch::data::Example<torch::Tensor, RCNNData> operator()(torch::data::Example<cv::Mat, RCNNData> input) override;
+  //resizes and color jitters input in place, draws the flips and applies them to the target, pixels are written by WritePlanes
+  std::pair<bool, bool> Prepare(torch::data::Example<cv::Mat, RCNNData>& input);
+  //rows of a plane are row_stride floats apart, planes are plane_stride floats apart
+  void WritePlanes(const cv::Mat& img, bool flip_horizontal, bool flip_vertical, float* dst, int64_t row_stride, int64_t plane_stride) const;
+
+private:
+  Resize resize_;
+  ColorJitter color_jitter_;
+  float horizontal_flip_prob_;
+  float vertical_flip_prob_;
+  std::vector<float> table_;//256 entries per channel
+};
+
 class Compose : public MatToTensorTransform{
 
 public:
   Compose(std::vector<std::shared_ptr<MatToMatTransform>> MtoMtransforms,
                  std::vector<std::shared_ptr<TensorToTensorTransform>> TtoTtransforms);
+  Compose(std::shared_ptr<ResizeFlipNormalize> fused);
   torch::data::Example<torch::Tensor, RCNNData> operator()(torch::data::Example<cv::Mat, RCNNData> input) override;
+  //null unless built from a fused transform
+  std::shared_ptr<ResizeFlipNormalize> fused() const;
 
 private:
   std::vector<std::shared_ptr<MatToMatTransform>> MtoMtransforms_;
   ToTensor to_tensor;
   std::vector<std::shared_ptr<TensorToTensorTransform>> TtoTtransforms_;
+  std::shared_ptr<ResizeFlipNormalize> fused_;
 };
 
 }//data
@@ -1,4 +1,5 @@
 #pragma once
+#include <functional>
 #include <map>
 #include <cassert>
 #include <iostream>
@@ -6,6 +7,7 @@
 #include <bounding_box.h>
 #include <modeling.h>
 #include <timer.h>
+#include <prefetcher.h>
 
 #include <torch/torch.h>
 
@@ -18,8 +20,10 @@ using namespace rcnn::modeling;
 using namespace std;
 using namespace rcnn::utils;
 
+//predictions are kept by image id, or handed to on_result as they come out when it is given
 template<typename Dataset>
-map<int64_t, BoxList> compute_on_dataset(GeneralizedRCNN& model, Dataset& dataset, torch::Device& device, Timer& inference_timer, int total_size){
+map<int64_t, BoxList> compute_on_dataset(GeneralizedRCNN& model, Dataset& dataset, torch::Device& device, Timer& inference_timer, int total_size, int prefetch_depth = 2,
+                                         function<void(int64_t, BoxList&)> on_result = nullptr){
   torch::NoGradGuard guard;
   model->eval();
   model->to(device);
@@ -27,21 +31,27 @@ map<int64_t, BoxList> compute_on_dataset(GeneralizedRCNN& model, Dataset& datase
   map<int64_t, BoxList> results_map;
   torch::Device cpu_device = torch::Device("cpu");
   int progress = 0;
-  for(auto& batch : *dataset){
+  auto prefetcher = rcnn::data::MakePrefetcher(*dataset, device, prefetch_depth);
+  while(torch::optional<rcnn::data::batch> batch = prefetcher->Next()){
     vector<BoxList> output;
-    ImageList images = get<0>(batch).to(device);
-    vector<int64_t> image_ids = get<2>(batch);
+    ImageList images = get<0>(*batch);
+    vector<int64_t> image_ids = get<2>(*batch);
     inference_timer.tic();
     output = model->forward(images);
     inference_timer.toc();
     for(auto& i : output)
       i = i.To(cpu_device);
     assert(output.size() == image_ids.size());
-    for(int i = 0; i < output.size(); ++i)
-      results_map.insert({image_ids[i], output[i]});
+    for(int i = 0; i < output.size(); ++i){
+      if(on_result)
+        on_result(image_ids[i], output[i]);
+      else
+        results_map.insert({image_ids[i], output[i]});
+    }
     progress += images.get_tensors().size(0);
     std::cout << progress << "/" << total_size << "\n";
   }
+  cout << *prefetcher << "\n";
   return results_map;
 }
 
@@ -9,7 +9,9 @@
 namespace rcnn{
 namespace modeling{
 
-torch::Tensor ProjectMasksOnBoxes(torch::Tensor segmentation_masks, rcnn::structures::BoxList proposals, int discretization_size);
+torch::Tensor ProjectMasksOnBoxes(rcnn::structures::SegmentationMask segmentation_masks, rcnn::structures::BoxList proposals, int discretization_size);
+//the targets rasterized over their own boxes by the loader, cropped by the proposals with ROIAlign
+torch::Tensor CropMaskRasters(torch::Tensor rasters, torch::Tensor target_boxes, rcnn::structures::BoxList proposals, int discretization_size);
 
 class MaskRCNNLossComputation{
 
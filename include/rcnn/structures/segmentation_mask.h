@@ -14,33 +14,15 @@ enum Flip{
 
 torch::Tensor ArrayToTensor(coco::Masks mask);
 
-class Polygons{
-
-public:
-  Polygons(std::vector<std::vector<double>> polygons, std::pair<int, int> size, std::string mode);
-  Polygons(std::vector<torch::Tensor> polygons, std::pair<int, int> size, std::string mode);
-  Polygons(const Polygons& other);
-  Polygons Transpose(const Flip method);
-  Polygons Crop(const std::tuple<int, int, int, int> box);
-  Polygons Resize(std::pair<int, int> size);
-  // Polygons Convert(std::string mode);
-  torch::Tensor GetMaskTensor();
-
-private:
-  std::pair<int, int> size_;
-  std::string mode_;
-  std::vector<torch::Tensor> polygons_;
-
-friend std::ostream& operator << (std::ostream& os, const Polygons& bml);
-
-};
-
+//the polygons of every instance in one buffer of interleaved x, y coordinates,
+//ring r spans coords[ring_offsets[r], ring_offsets[r + 1]) and instance i owns rings [instance_rings[i], instance_rings[i + 1])
+//flips, crops and resizes keep the layout and run one loop over the coordinates
 class SegmentationMask{
 
 public:
   SegmentationMask(std::vector<std::vector<std::vector<double>>> polygons, std::pair<int, int> size, std::string mode);
-  SegmentationMask(std::vector<Polygons> polygons, std::pair<int, int> size, std::string mode);
-  SegmentationMask(const SegmentationMask& other);
+  SegmentationMask(std::vector<float> coords, std::vector<int64_t> ring_offsets, std::vector<int64_t> instance_rings, std::pair<int, int> size, std::string mode);
+  SegmentationMask(const SegmentationMask& other) = default;
   SegmentationMask(SegmentationMask&& other) = default;
   SegmentationMask& operator=(const SegmentationMask& other) = default;
   SegmentationMask& operator=(SegmentationMask&& other) = default;
@@ -51,13 +33,24 @@ public:
   SegmentationMask Resize(std::pair<int, int> size);
   SegmentationMask to();
   int Length();
+  //sets the pixels inside the polygons of instance i in a row major height x width mask, same pixels as frPoly and merge
+  void FillMask(int64_t i, float* mask) const;
   torch::Tensor GetMaskTensor();
+  //instance i cropped by row i of the xyxy boxes and rasterized at resolution x resolution,
+  //the pixels of Crop, Resize and GetMaskTensor without the intermediate masks
+  torch::Tensor ProjectOnBoxes(torch::Tensor boxes, int resolution) const;
 
   SegmentationMask operator[](torch::Tensor item);
   SegmentationMask operator[](const int64_t item);
 
 private:
-  std::vector<Polygons> polygons_;
+  //same layout with new coordinates
+  SegmentationMask WithCoords(std::vector<float> coords, std::pair<int, int> size) const;
+  SegmentationMask Select(const std::vector<int64_t>& items) const;
+
+  std::vector<float> coords_;
+  std::vector<int64_t> ring_offsets_;
+  std::vector<int64_t> instance_rings_;
   std::pair<int, int> size_;
   std::string mode_;
 
@@ -1,12 +1,16 @@
 #include "coco.h"
+#include "coco_cache.h"
+#include "coco_reader.h"
 #include "mask.h"
 #include <rapidjson/istreamwrapper.h>
 #include <fstream>
 #include <cassert>
 #include <algorithm>
+#include <cstdlib>
 #include <cstring>
 #include <iostream>
 #include <ctime>
+#include <thread>
 
 
 namespace coco{
@@ -65,145 +69,443 @@ Categories::Categories(const Value& value)
 
 Categories::Categories(): id(0), name(""), supercategory(""){}
 
-COCO::COCO(std::string annotation_file){
-  std::cout << "loading annotations into memory...\n";
-  time_t start = time(0);
-  std::ifstream ifs(annotation_file);
-  IStreamWrapper isw(ifs);
-  std::cout << "Done : " << difftime(time(0), start) << "s\n";
-  dataset.ParseStream(isw);
-  assert(dataset.IsObject());
-  CreateIndex();
+IndexBuilder::IndexBuilder() :rings{0}, strings{'\0'}{}
+
+uint32_t IndexBuilder::AddString(const char* str, size_t length){
+  uint32_t offset = static_cast<uint32_t>(strings.size());
+  strings.insert(strings.end(), str, str + length);
+  strings.push_back('\0');
+  return offset;
 }
 
-COCO::COCO(){};
+namespace{
 
-COCO::COCO(const COCO& other) :anns(other.anns), imgs(other.imgs), cats(other.cats), imgToAnns(other.imgToAnns), catToImgs(other.catToImgs){
-  dataset.CopyFrom(other.dataset, dataset.GetAllocator());
+size_t NumThreads(size_t work){
+  size_t threads = std::max(1u, std::thread::hardware_concurrency());
+  //not worth a thread below this many rows
+  return std::max<size_t>(1, std::min(threads, work / 16384));
 }
 
-COCO::COCO(COCO&& other) :anns(other.anns), imgs(other.imgs), cats(other.cats), imgToAnns(other.imgToAnns), catToImgs(other.catToImgs){
-  dataset.CopyFrom(other.dataset.Move(), dataset.GetAllocator());
+//runs func(begin, end) over contiguous chunks of [0, n) on separate threads
+template<typename Func>
+void ParallelFor(size_t n, Func func){
+  size_t num_threads = NumThreads(n);
+  if(num_threads == 1){
+    func(0, n);
+    return;
+  }
+  std::vector<std::thread> workers;
+  size_t chunk = (n + num_threads - 1) / num_threads;
+  for(size_t begin = 0; begin < n; begin += chunk)
+    workers.emplace_back(func, begin, std::min(n, begin + chunk));
+  for(auto& worker : workers)
+    worker.join();
 }
 
-COCO COCO::operator=(const COCO& other){
-  if(this != &other){
-    anns = other.anns;
-    imgs = other.imgs;
-    imgToAnns = other.imgToAnns;
-    catToImgs = other.catToImgs;
-    dataset.CopyFrom(other.dataset, dataset.GetAllocator());
+//stable, chunks are sorted on separate threads and merged pairwise
+template<typename Record, typename Key>
+std::vector<uint32_t> SortRows(const Table<Record>& table, Key key){
+  std::vector<uint32_t> rows(table.size());
+  for(uint32_t i = 0; i < rows.size(); ++i)
+    rows[i] = i;
+  auto less = [&](uint32_t a, uint32_t b){
+    return key(table[a]) < key(table[b]);
+  };
+  size_t num_threads = NumThreads(rows.size());
+  size_t chunk = (rows.size() + num_threads - 1) / std::max<size_t>(num_threads, 1);
+  ParallelFor(rows.size(), [&](size_t begin, size_t end){
+    std::stable_sort(rows.begin() + begin, rows.begin() + end, less);
+  });
+  for(size_t width = chunk; width < rows.size(); width *= 2){
+    for(size_t begin = 0; begin + width < rows.size(); begin += 2 * width)
+      std::inplace_merge(rows.begin() + begin, rows.begin() + begin + width, rows.begin() + std::min(rows.size(), begin + 2 * width), less);
   }
-  return *this;
+  return rows;
+}
+
+template<typename Record, typename Id>
+const Record* FindById(const Table<Record>& table, const Table<uint32_t>& by_id, Id id){
+  auto it = std::lower_bound(by_id.begin(), by_id.end(), id, [&](uint32_t row, Id value){
+    return table[row].id < value;
+  });
+  if(it == by_id.end() || table[*it].id != id)
+    return nullptr;
+  return &table[*it];
 }
 
-COCO COCO::operator=(COCO&& other){
-  if(this != &other){
-    anns = other.anns;
-    imgs = other.imgs;
-    imgToAnns = other.imgToAnns;
-    catToImgs = other.catToImgs;
-    dataset.CopyFrom(other.dataset.Move(), dataset.GetAllocator());
+}//namespace
+
+COCO::COCO(std::string annotation_file, bool use_cache){
+  std::string cache_file = CachePath(annotation_file);
+  if(use_cache && LoadCache(*this, cache_file, annotation_file)){
+    std::cout << "loaded annotation cache " << cache_file << "\n";
+    return;
+  }
+  std::cout << "loading annotations into memory...\n";
+  time_t start = time(0);
+  IndexBuilder builder;
+  bool parsed = ReadAnnotationFile(annotation_file, builder);
+  std::cout << "Done : " << difftime(time(0), start) << "s\n";
+  //a partial index must never be cached under the stamp of the source file
+  if(!parsed){
+    std::cout << "could not parse annotation file " << annotation_file << "\n";
+    std::abort();
   }
-  return *this;
+  CreateIndex(builder);
+  if(use_cache && !WriteCache(*this, cache_file, annotation_file))
+    std::cout << "could not write annotation cache " << cache_file << "\n";
 }
 
-void COCO::CreateIndex(){
-  std::cout << "creating index...\n";
+COCO::COCO(){};
+
+void COCO::CreateIndex(const Value& dataset){
+  IndexBuilder builder;
+
+  if(dataset.HasMember("images")){
+    builder.images.reserve(dataset["images"].Size());
+    for(auto& img : dataset["images"].GetArray()){
+      ImageRecord record;
+      record.id = img["id"].GetInt();
+      record.width = img["width"].GetInt();
+      record.height = img["height"].GetInt();
+      record.file_name = builder.AddString(img["file_name"].GetString(), img["file_name"].GetStringLength());
+      builder.images.push_back(record);
+    }
+  }
+
   if(dataset.HasMember("annotations")){
     assert(dataset["annotations"].IsArray());
+    builder.annotations.reserve(dataset["annotations"].Size());
     for(auto& ann : dataset["annotations"].GetArray()){
-      if(imgToAnns.count(ann["image_id"].GetInt())){ // if it exists
-        imgToAnns[ann["image_id"].GetInt()].emplace_back(ann);
-      }
-      else{
-        imgToAnns[ann["image_id"].GetInt()] = std::vector<Annotation> {Annotation(ann)};
+      AnnotationRecord record;
+      record.id = static_cast<int64_t>(ann["id"].GetDouble());
+      record.image_id = ann["image_id"].GetInt();
+      record.category_id = ann["category_id"].GetInt();
+      record.area = ann["area"].GetDouble();
+      record.iscrowd = ann["iscrowd"].GetInt();
+      for(int i = 0; i < 4; ++i)
+        record.bbox[i] = ann["bbox"][i].GetDouble();
+      record.segm_type = SEGM_NONE;
+      record.segm_begin = record.segm_end = 0;
+      record.rle_h = record.rle_w = 0;
+      if(ann.HasMember("score"))
+        builder.scores.push_back(ann["score"].GetDouble());
+
+      if(ann.HasMember("segmentation")){
+        const Value& segm = ann["segmentation"];
+        if(segm.IsArray()){
+          record.segm_type = SEGM_POLYGON;
+          record.segm_begin = static_cast<uint32_t>(builder.rings.size() - 1);
+          for(auto& polygon : segm.GetArray()){
+            for(auto& coord : polygon.GetArray())
+              builder.coords.push_back(coord.GetDouble());
+            builder.rings.push_back(static_cast<uint32_t>(builder.coords.size()));
+          }
+          record.segm_end = static_cast<uint32_t>(builder.rings.size() - 1);
+        }
+        else if(segm.IsObject()){
+          record.rle_h = segm["size"][0].GetInt();
+          record.rle_w = segm["size"][1].GetInt();
+          if(segm["counts"].IsArray()){
+            record.segm_type = SEGM_RLE;
+            record.segm_begin = static_cast<uint32_t>(builder.counts.size());
+            for(auto& count : segm["counts"].GetArray())
+              builder.counts.push_back(count.GetUint());
+            record.segm_end = static_cast<uint32_t>(builder.counts.size());
+          }
+          else{
+            assert(segm["counts"].IsString());
+            record.segm_type = SEGM_COMPRESSED_RLE;
+            record.segm_begin = builder.AddString(segm["counts"].GetString(), segm["counts"].GetStringLength());
+            record.segm_end = segm["counts"].GetStringLength();
+          }
+        }
       }
-      anns[static_cast<int64_t>(ann["id"].GetDouble())] = Annotation(ann);
-    }
-  }
-
-  if(dataset.HasMember("images")){
-    for(auto& img : dataset["images"].GetArray()){
-      imgs[img["id"].GetInt()] = Image(img);
+      builder.annotations.push_back(record);
     }
+    //scored results score every annotation
+    assert(builder.scores.empty() || builder.scores.size() == builder.annotations.size());
   }
 
   if(dataset.HasMember("categories")){
     assert(dataset["categories"].IsArray());
     for(auto& cat : dataset["categories"].GetArray()){
-      cats[cat["id"].GetInt()] = Categories(cat);
+      CategoryRecord record;
+      record.id = cat["id"].GetInt();
+      record.name = builder.AddString(cat["name"].GetString(), cat["name"].GetStringLength());
+      if(cat.HasMember("supercategory"))
+        record.supercategory = builder.AddString(cat["supercategory"].GetString(), cat["supercategory"].GetStringLength());
+      else
+        record.supercategory = 0;
+      builder.categories.push_back(record);
     }
   }
 
-  if(dataset.HasMember("categories") && dataset.HasMember("annotations")){
-    for(auto& ann : dataset["annotations"].GetArray()){
-      if(catToImgs.count(ann["category_id"].GetInt())){
-        catToImgs[ann["category_id"].GetInt()].push_back(ann["image_id"].GetInt());
-      }
-      else{
-        catToImgs.insert(
-          {ann["category_id"].GetInt(), std::vector<int> {ann["image_id"].GetInt()}}
-        );
-      }
-    }
-  }//ann and cat
+  CreateIndex(builder);
+}
+
+void COCO::CreateIndex(IndexBuilder& builder){
+  std::cout << "creating index...\n";
+  images.Own(std::move(builder.images));
+  annotations.Own(std::move(builder.annotations));
+  categories.Own(std::move(builder.categories));
+  coords.Own(std::move(builder.coords));
+  rings.Own(std::move(builder.rings));
+  counts.Own(std::move(builder.counts));
+  strings.Own(std::move(builder.strings));
+  scores.Own(std::move(builder.scores));
+  BuildLookups();
   std::cout << "index created!\n";
 }
 
+void COCO::BuildLookups(){
+  std::vector<uint32_t> img_rows_by_id, ann_rows_by_id, cat_rows_by_id, ann_rows_by_area;
+  std::thread img_sort([&](){
+    img_rows_by_id = SortRows(images, [](const ImageRecord& r){ return r.id; });
+    ann_rows_by_area = SortRows(annotations, [](const AnnotationRecord& r){ return r.area; });
+  });
+  cat_rows_by_id = SortRows(categories, [](const CategoryRecord& r){ return r.id; });
+  ann_rows_by_id = SortRows(annotations, [](const AnnotationRecord& r){ return r.id; });
+  img_sort.join();
+  img_by_id.Own(std::move(img_rows_by_id));
+  ann_by_id.Own(std::move(ann_rows_by_id));
+  cat_by_id.Own(std::move(cat_rows_by_id));
+  area_rows.Own(std::move(ann_rows_by_area));
+
+  //row of the image and category of every annotation, UINT32_MAX if missing
+  std::vector<uint32_t> ann_image_row(annotations.size()), ann_cat_row(annotations.size());
+  ParallelFor(annotations.size(), [&](size_t begin, size_t end){
+    for(size_t i = begin; i < end; ++i){
+      const ImageRecord* img = FindImage(annotations[i].image_id);
+      const CategoryRecord* cat = FindCategory(annotations[i].category_id);
+      ann_image_row[i] = img ? static_cast<uint32_t>(img - images.data()) : UINT32_MAX;
+      ann_cat_row[i] = cat ? static_cast<uint32_t>(cat - categories.data()) : UINT32_MAX;
+    }
+  });
+
+  //image -> annotation rows in file order, category -> image ids with one entry per annotation like pycocotools,
+  //category -> annotation rows in file order
+  std::vector<uint32_t> img_offsets, img_rows, cat_offsets, cat_rows, crowd;
+  std::vector<int32_t> cat_ids;
+  std::thread img_csr([&](){
+    for(uint32_t i = 0; i < annotations.size(); ++i){
+      if(annotations[i].iscrowd)
+        crowd.push_back(i);
+    }
+    img_offsets.assign(images.size() + 1, 0);
+    for(auto& row : ann_image_row){
+      if(row != UINT32_MAX)
+        img_offsets[row + 1]++;
+    }
+    for(size_t i = 1; i < img_offsets.size(); ++i)
+      img_offsets[i] += img_offsets[i - 1];
+    img_rows.resize(img_offsets.back());
+    std::vector<uint32_t> cursor(img_offsets.begin(), img_offsets.end() - 1);
+    for(size_t i = 0; i < ann_image_row.size(); ++i){
+      if(ann_image_row[i] != UINT32_MAX)
+        img_rows[cursor[ann_image_row[i]]++] = static_cast<uint32_t>(i);
+    }
+  });
+
+  cat_offsets.assign(categories.size() + 1, 0);
+  for(auto& row : ann_cat_row){
+    if(row != UINT32_MAX)
+      cat_offsets[row + 1]++;
+  }
+  for(size_t i = 1; i < cat_offsets.size(); ++i)
+    cat_offsets[i] += cat_offsets[i - 1];
+  cat_ids.resize(cat_offsets.back());
+  cat_rows.resize(cat_offsets.back());
+  std::vector<uint32_t> cursor(cat_offsets.begin(), cat_offsets.end() - 1);
+  for(size_t i = 0; i < ann_cat_row.size(); ++i){
+    if(ann_cat_row[i] != UINT32_MAX){
+      uint32_t position = cursor[ann_cat_row[i]]++;
+      cat_ids[position] = annotations[i].image_id;
+      cat_rows[position] = static_cast<uint32_t>(i);
+    }
+  }
+  img_csr.join();
+
+  img_ann_offsets.Own(std::move(img_offsets));
+  img_ann_rows.Own(std::move(img_rows));
+  cat_ann_offsets.Own(cat_offsets);
+  cat_img_offsets.Own(std::move(cat_offsets));
+  cat_img_ids.Own(std::move(cat_ids));
+  cat_ann_rows.Own(std::move(cat_rows));
+  crowd_rows.Own(std::move(crowd));
+}
+
+const ImageRecord* COCO::FindImage(int id) const{
+  return FindById(images, img_by_id, id);
+}
+
+const AnnotationRecord* COCO::FindAnnotation(int64_t id) const{
+  return FindById(annotations, ann_by_id, id);
+}
+
+const CategoryRecord* COCO::FindCategory(int id) const{
+  return FindById(categories, cat_by_id, id);
+}
+
+ArrayView<uint32_t> COCO::ImageAnnotationRows(int image_id) const{
+  const ImageRecord* img = FindImage(image_id);
+  if(!img)
+    return ArrayView<uint32_t>();
+  size_t row = img - images.data();
+  return ArrayView<uint32_t>(img_ann_rows.data() + img_ann_offsets[row], img_ann_offsets[row + 1] - img_ann_offsets[row]);
+}
+
+ArrayView<int32_t> COCO::CategoryImageIds(int category_id) const{
+  const CategoryRecord* cat = FindCategory(category_id);
+  if(!cat)
+    return ArrayView<int32_t>();
+  size_t row = cat - categories.data();
+  return ArrayView<int32_t>(cat_img_ids.data() + cat_img_offsets[row], cat_img_offsets[row + 1] - cat_img_offsets[row]);
+}
+
+AnnotationRange COCO::ImageAnnotations(int image_id) const{
+  return AnnotationRange(annotations.data(), ImageAnnotationRows(image_id));
+}
+
+AnnotationRange COCO::CategoryAnnotations(int category_id) const{
+  const CategoryRecord* cat = FindCategory(category_id);
+  if(!cat)
+    return AnnotationRange();
+  size_t row = cat - categories.data();
+  return AnnotationRange(annotations.data(), ArrayView<uint32_t>(cat_ann_rows.data() + cat_ann_offsets[row], cat_ann_offsets[row + 1] - cat_ann_offsets[row]));
+}
+
+AnnotationRange COCO::AnnotationsInArea(double min_area, double max_area) const{
+  auto begin = std::upper_bound(area_rows.begin(), area_rows.end(), min_area, [&](double value, uint32_t row){
+    return value < annotations[row].area;
+  });
+  auto end = std::lower_bound(begin, area_rows.end(), max_area, [&](uint32_t row, double value){
+    return annotations[row].area < value;
+  });
+  return AnnotationRange(annotations.data(), ArrayView<uint32_t>(begin, end - begin));
+}
+
+AnnotationRange COCO::CrowdAnnotations() const{
+  return AnnotationRange(annotations.data(), crowd_rows.view());
+}
+
+const char* COCO::String(uint32_t offset) const{
+  return strings.data() + offset;
+}
+
+Annotation COCO::ToAnnotation(const AnnotationRecord& record) const{
+  Annotation ann;
+  ann.id = record.id;
+  ann.image_id = record.image_id;
+  ann.category_id = record.category_id;
+  ann.area = record.area;
+  ann.iscrowd = record.iscrowd;
+  ann.bbox.assign(record.bbox, record.bbox + 4);
+  if(record.segm_type == SEGM_POLYGON){
+    ann.segmentation.reserve(record.segm_end - record.segm_begin);
+    for(uint32_t r = record.segm_begin; r < record.segm_end; ++r)
+      ann.segmentation.emplace_back(coords.data() + rings[r], coords.data() + rings[r + 1]);
+  }
+  else if(record.segm_type == SEGM_RLE){
+    ann.counts.assign(counts.data() + record.segm_begin, counts.data() + record.segm_end);
+    ann.size = std::make_pair(record.rle_h, record.rle_w);
+  }
+  else if(record.segm_type == SEGM_COMPRESSED_RLE){
+    ann.compressed_rle.assign(String(record.segm_begin), record.segm_end);
+    ann.size = std::make_pair(record.rle_h, record.rle_w);
+  }
+  return ann;
+}
+
+Image COCO::ToImage(const ImageRecord& record) const{
+  Image img;
+  img.id = record.id;
+  img.width = record.width;
+  img.height = record.height;
+  img.file_name = String(record.file_name);
+  return img;
+}
+
+Categories COCO::ToCategories(const CategoryRecord& record) const{
+  Categories cat;
+  cat.id = record.id;
+  cat.name = String(record.name);
+  cat.supercategory = String(record.supercategory);
+  return cat;
+}
+
 std::vector<int64_t> COCO::GetAnnIds(const std::vector<int> imgIds, 
                            const std::vector<int> catIds, 
                            const std::vector<float> areaRng, 
                            Crowd iscrowd)
 {
+  //start from the smallest index that covers a filter, the remaining filters are checked per row
   std::vector<int64_t> returnAnns;
-  std::vector<Annotation> tmp_anns;
-  if(imgIds.size() == 0 && catIds.size() == 0 && areaRng.size() == 0){
-    for(auto& ann : dataset["annotations"].GetArray()){
-      tmp_anns.emplace_back(ann);
+  std::vector<uint32_t> rows;
+  bool scan_all = false;
+  if(imgIds.size() != 0){
+    for(auto& imgId : imgIds){
+      ArrayView<uint32_t> img_rows = ImageAnnotationRows(imgId);
+      rows.insert(rows.end(), img_rows.begin(), img_rows.end());
     }
   }
   else{
-    if(imgIds.size() != 0){
-      for(auto& imgId : imgIds){
-        if(imgToAnns.count(imgId)){//if it exists
-          tmp_anns.insert(tmp_anns.end(), imgToAnns[imgId].begin(), imgToAnns[imgId].end());
-        }
-      }
+    size_t cat_size = SIZE_MAX, area_size = SIZE_MAX, crowd_size = SIZE_MAX;
+    if(catIds.size() != 0){
+      cat_size = 0;
+      for(auto& catId : catIds)
+        cat_size += CategoryAnnotations(catId).size();
     }
-    else{
-      for(auto& ann : dataset["annotations"].GetArray()){
-        tmp_anns.emplace_back(ann);
-      }
+    if(areaRng.size() != 0)
+      area_size = AnnotationsInArea(areaRng[0], areaRng[1]).size();
+    if(iscrowd == T)
+      crowd_size = crowd_rows.size();
+    size_t best = std::min(std::min(cat_size, area_size), crowd_size);
+
+    if(best == SIZE_MAX || best == annotations.size()){
+      scan_all = true;
     }
-
-    if(catIds.size() != 0){
-      for(auto it = tmp_anns.begin(); it != tmp_anns.end(); ++it){
-        if(std::find(catIds.begin(), catIds.end(), it->category_id) == catIds.end()){
-          it = tmp_anns.erase(it);
+    else{
+      if(best == cat_size){
+        for(auto& catId : catIds){
+          ArrayView<uint32_t> cat_rows = CategoryAnnotations(catId).rows();
+          rows.insert(rows.end(), cat_rows.begin(), cat_rows.end());
         }
       }
-    }
-
-    if(areaRng.size() != 0){
-      for(auto it = tmp_anns.begin(); it != tmp_anns.end(); ++it){
-        if(it->area <= areaRng[0] || it->area >= areaRng[1]){
-          it = tmp_anns.erase(it);
-        }
+      else if(best == area_size){
+        ArrayView<uint32_t> area = AnnotationsInArea(areaRng[0], areaRng[1]).rows();
+        rows.assign(area.begin(), area.end());
+      }
+      else{
+        rows.assign(crowd_rows.begin(), crowd_rows.end());
       }
+      //back to file order
+      std::sort(rows.begin(), rows.end());
+      rows.erase(std::unique(rows.begin(), rows.end()), rows.end());
     }
   }
 
-  if(iscrowd == none){
-    for(auto& i : tmp_anns){
-      returnAnns.push_back(i.id);
+  bool check = (iscrowd == T);
+  auto keep = [&](const AnnotationRecord& ann){
+    if(catIds.size() != 0 && std::find(catIds.begin(), catIds.end(), ann.category_id) == catIds.end())
+      return false;
+    if(areaRng.size() != 0 && (ann.area <= areaRng[0] || ann.area >= areaRng[1]))
+      return false;
+    if(iscrowd != none && static_cast<bool>(ann.iscrowd) != check)
+      return false;
+    return true;
+  };
+  if(scan_all){
+    for(auto& ann : annotations){
+      if(keep(ann))
+        returnAnns.push_back(ann.id);
     }
   }
   else{
-    bool check = (iscrowd == F ? false : true);
-    for(auto& i : tmp_anns){
-      if(i.iscrowd == check)
-        returnAnns.push_back(i.id);
+    returnAnns.reserve(rows.size());
+    for(auto& row : rows){
+      if(keep(annotations[row]))
+        returnAnns.push_back(annotations[row].id);
     }
   }
   return returnAnns;
@@ -214,100 +516,119 @@ std::vector<int> COCO::GetCatIds(const std::vector<std::string> catNms,
                                  const std::vector<int> catIds)
 {
   std::vector<int> returnIds;
-  std::vector<Categories> cats;
-  for(auto& cat: dataset["categories"].GetArray()){
-    cats.emplace_back(cat);
-  }
-  if(catNms.size() != 0){
-    for(auto it = cats.begin(); it != cats.end();){
-      if(std::find(catNms.begin(), catNms.end(), it->name) == catNms.end())
-        it = cats.erase(it);
-      else
-        it++;
-    }
-  }
-
-  if(supNms.size() != 0){
-    for(auto it = cats.begin(); it != cats.end();){
-      if(std::find(supNms.begin(), supNms.end(), it->supercategory) == supNms.end())
-        it = cats.erase(it);
-      else
-        it++;
-    }
-  }
-
-  if(catIds.size() != 0){
-    for(auto it = cats.begin(); it != cats.end();){
-      if(std::find(catIds.begin(), catIds.end(), it->id) == catIds.end())
-        it = cats.erase(it);
-      else
-        it++;
-    }
-  }
-  for(auto& cat: cats){
+  for(auto& cat : categories){
+    if(catNms.size() != 0 && std::find(catNms.begin(), catNms.end(), std::string(String(cat.name))) == catNms.end())
+      continue;
+    if(supNms.size() != 0 && std::find(supNms.begin(), supNms.end(), std::string(String(cat.supercategory))) == supNms.end())
+      continue;
+    if(catIds.size() != 0 && std::find(catIds.begin(), catIds.end(), cat.id) == catIds.end())
+      continue;
     returnIds.push_back(cat.id);
   }
+  return returnIds;
+}
 
+std::vector<int> COCO::GetImgIds(){
+  std::vector<int> returnIds;
+  returnIds.reserve(images.size());
+  for(auto& row : img_by_id)
+    returnIds.push_back(images[row].id);
   return returnIds;
-  
 }
 
 std::vector<Annotation> COCO::LoadAnns(std::vector<int64_t> ids){
   std::vector<Annotation> returnAnns;
-  for(auto& id : ids)
-    returnAnns.push_back(anns[id]);
-
+  returnAnns.reserve(ids.size());
+  for(auto& id : ids){
+    const AnnotationRecord* record = FindAnnotation(id);
+    returnAnns.push_back(record ? ToAnnotation(*record) : Annotation());
+  }
   return returnAnns;
 }
 
 std::vector<Image> COCO::LoadImgs(std::vector<int> ids){
   std::vector<Image> returnImgs;
-  for(auto& id : ids)
-    returnImgs.push_back(imgs[id]);
-
+  returnImgs.reserve(ids.size());
+  for(auto& id : ids){
+    const ImageRecord* record = FindImage(id);
+    returnImgs.push_back(record ? ToImage(*record) : Image());
+  }
   return returnImgs;
 }
 
+std::vector<Categories> COCO::LoadCats(std::vector<int> ids){
+  std::vector<Categories> returnCats;
+  if(ids.size() == 0){
+    for(auto& cat : categories)
+      returnCats.push_back(ToCategories(cat));
+    return returnCats;
+  }
+  for(auto& id : ids){
+    const CategoryRecord* record = FindCategory(id);
+    returnCats.push_back(record ? ToCategories(*record) : Categories());
+  }
+  return returnCats;
+}
+
 COCO COCO::LoadRes(std::string res_file){
   COCO res = COCO();
-  res.dataset.SetObject();
+  Document dataset;
+  dataset.SetObject();
+  Document::AllocatorType& a = dataset.GetAllocator();
   //it only supports json file
   std::ifstream ifs(res_file);
   IStreamWrapper isw(ifs);
   Document anno;
   anno.ParseStream(isw);
 
+  Value copied_images(kArrayType);
+  for(auto& img : images){
+    Value node(kObjectType);
+    node.AddMember("id", img.id, a);
+    node.AddMember("width", img.width, a);
+    node.AddMember("height", img.height, a);
+    node.AddMember("file_name", Value(String(img.file_name), a), a);
+    copied_images.PushBack(node, a);
+  }
+  dataset.AddMember("images", copied_images, a);
+
+  Value copied_categories(kArrayType);
+  for(auto& cat : categories){
+    Value node(kObjectType);
+    node.AddMember("id", cat.id, a);
+    node.AddMember("name", Value(String(cat.name), a), a);
+    node.AddMember("supercategory", Value(String(cat.supercategory), a), a);
+    copied_categories.PushBack(node, a);
+  }
+  dataset.AddMember("categories", copied_categories, a);
+
   // std::vector<int> annsImgIds;
   // for(auto& ann : anno.GetArray())
   //   annsImgIds.push_back(ann["image_id"].GetInt());
   //no image id check
   //no caption implementation
-  if(anno[0].HasMember("bbox") && !anno[0]["bbox"].Empty()){
-    Document::AllocatorType& a = res.dataset.GetAllocator(); 
-    Value copied_categories(dataset["categories"], a);
-    res.dataset.AddMember("categories", copied_categories.Move(), a);
+  if(anno.Size() > 0 && anno[0].HasMember("bbox") && !anno[0]["bbox"].Empty()){
+    Document::AllocatorType& aa = anno.GetAllocator();
     for(int i = 0; i < anno.Size(); ++i){
       Value& bb = anno[i]["bbox"];
-      int x1 = bb[0].GetDouble(), x2 = bb[0].GetDouble() + bb[1].GetDouble(), y1 = bb[1].GetDouble(), y2 = bb[1].GetDouble() + bb[3].GetDouble();
+      double x1 = bb[0].GetDouble(), x2 = bb[0].GetDouble() + bb[2].GetDouble(), y1 = bb[1].GetDouble(), y2 = bb[1].GetDouble() + bb[3].GetDouble();
       if(!anno[i].HasMember("segmentation")){
         Value seg(kArrayType);
         Value coords(kArrayType);
-        coords.PushBack(x1, a).PushBack(y1, a)
-              .PushBack(x1, a).PushBack(y2, a)
-              .PushBack(x2, a).PushBack(y1, a)
-              .PushBack(x2, a).PushBack(y2, a);
+        coords.PushBack(x1, aa).PushBack(y1, aa)
+              .PushBack(x1, aa).PushBack(y2, aa)
+              .PushBack(x2, aa).PushBack(y2, aa)
+              .PushBack(x2, aa).PushBack(y1, aa);
         
-        anno[i].AddMember("segmentation", seg.PushBack(coords, a).Move(), a);
+        anno[i].AddMember("segmentation", seg.PushBack(coords, aa).Move(), aa);
       }
-      anno[i].AddMember("area", bb[2].GetDouble() * bb[3].GetDouble(), a);
-      anno[i].AddMember("id", i+1, a);
-      anno[i].AddMember("iscrowd", 0, a);
+      anno[i].AddMember("area", bb[2].GetDouble() * bb[3].GetDouble(), aa);
+      anno[i].AddMember("id", i+1, aa);
+      anno[i].AddMember("iscrowd", 0, aa);
     }
   }
-  else if(anno[0].HasMember("segmentation")){
-    Document::AllocatorType& a = res.dataset.GetAllocator(); 
-    Value copied_categories(dataset["categories"], a);
-    res.dataset.AddMember("categories", copied_categories.Move(), a);
+  else if(anno.Size() > 0 && anno[0].HasMember("segmentation")){
+    Document::AllocatorType& aa = anno.GetAllocator();
     for(int i = 0; i < anno.Size(); ++i){
       std::vector<RLEstr> rlestr;
       rlestr.emplace_back(
@@ -320,23 +641,22 @@ COCO COCO::LoadRes(std::string res_file){
       if(!anno[i].HasMember("bbox")){
         std::vector<double> bbox = coco::toBbox(rlestr);
         Value bb(kArrayType);
-        for(auto& i : bbox)
-          bb.PushBack(i, a);
-        anno[i].AddMember("bbox", bb, a);
+        for(auto& j : bbox)
+          bb.PushBack(j, aa);
+        anno[i].AddMember("bbox", bb, aa);
       }
 
-      anno[i].AddMember("area", seg[0], a);
-      anno[i].AddMember("id", i+1, a);
-      anno[i].AddMember("iscrowd", 0, a);
+      anno[i].AddMember("area", seg[0], aa);
+      anno[i].AddMember("id", i+1, aa);
+      anno[i].AddMember("iscrowd", 0, aa);
     }
   }
   //no keypoints
 
-  Document::AllocatorType& a = res.dataset.GetAllocator(); 
   Value copied_annotations(anno, a);
-  res.dataset.AddMember("annotations", copied_annotations, a);
+  dataset.AddMember("annotations", copied_annotations, a);
   
-  res.CreateIndex();
+  res.CreateIndex(dataset);
   return res;
 }
 
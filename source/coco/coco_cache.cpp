@@ -0,0 +1,230 @@
+#include "coco_cache.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <vector>
+
+
+namespace coco{
+
+namespace{
+
+const size_t HASH_BLOCK = 1 << 20;
+
+uint64_t Fnv1a(const char* data, size_t size, uint64_t hash){
+  for(size_t i = 0; i < size; ++i){
+    hash ^= static_cast<unsigned char>(data[i]);
+    hash *= 1099511628211ULL;
+  }
+  return hash;
+}
+
+uint64_t Align(uint64_t offset){
+  return (offset + 7) & ~static_cast<uint64_t>(7);
+}
+
+template<typename T>
+void AddSection(CacheHeader& header, CacheSection section, const Table<T>& table, uint64_t& offset){
+  header.sections[section].offset = offset;
+  header.sections[section].count = table.size();
+  header.sections[section].element_size = sizeof(T);
+  offset = Align(offset + table.size() * sizeof(T));
+}
+
+template<typename T>
+void WriteSection(std::ofstream& ofs, const CacheSectionEntry& entry, const Table<T>& table){
+  static const char padding[8] = {0};
+  uint64_t position = static_cast<uint64_t>(ofs.tellp());
+  ofs.write(padding, entry.offset - position);
+  ofs.write(reinterpret_cast<const char*>(table.data()), table.size() * sizeof(T));
+}
+
+template<typename T>
+bool ViewSection(const MappedFile& file, const CacheHeader& header, CacheSection section, Table<T>& table){
+  const CacheSectionEntry& entry = header.sections[section];
+  if(entry.element_size != sizeof(T) || entry.offset % 8 != 0 || entry.offset + entry.count * sizeof(T) > file.size())
+    return false;
+  table.View(reinterpret_cast<const T*>(file.data() + entry.offset), entry.count);
+  return true;
+}
+
+}//namespace
+
+MappedFile::MappedFile(const std::string& path) :data_(nullptr), size_(0){
+  int fd = open(path.c_str(), O_RDONLY);
+  if(fd < 0)
+    return;
+  struct stat st;
+  if(fstat(fd, &st) == 0 && st.st_size > 0){
+    void* mapped = mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    if(mapped != MAP_FAILED){
+      data_ = mapped;
+      size_ = st.st_size;
+    }
+  }
+  close(fd);
+}
+
+MappedFile::~MappedFile(){
+  if(data_)
+    munmap(data_, size_);
+}
+
+bool MappedFile::valid() const{
+  return data_ != nullptr;
+}
+
+const char* MappedFile::data() const{
+  return static_cast<const char*>(data_);
+}
+
+size_t MappedFile::size() const{
+  return size_;
+}
+
+bool StampFile(const std::string& path, SourceStamp& stamp){
+  struct stat st;
+  if(stat(path.c_str(), &st) != 0)
+    return false;
+  stamp.size = st.st_size;
+  stamp.mtime = st.st_mtime;
+
+  std::ifstream ifs(path, std::ios::binary);
+  if(!ifs)
+    return false;
+  std::vector<char> block(HASH_BLOCK);
+  uint64_t hash = Fnv1a(reinterpret_cast<const char*>(&stamp.size), sizeof(stamp.size), 14695981039346656037ULL);
+  ifs.read(block.data(), block.size());
+  hash = Fnv1a(block.data(), ifs.gcount(), hash);
+  if(stamp.size > 2 * HASH_BLOCK){
+    ifs.clear();
+    ifs.seekg(stamp.size - HASH_BLOCK);
+    ifs.read(block.data(), block.size());
+    hash = Fnv1a(block.data(), ifs.gcount(), hash);
+  }
+  stamp.hash = hash;
+  return true;
+}
+
+std::string CachePath(const std::string& annotation_file){
+  return annotation_file + ".cache";
+}
+
+bool WriteCache(const COCO& coco, const std::string& cache_file, const std::string& annotation_file){
+  CacheHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+  header.version = CACHE_VERSION;
+  header.byte_order = CACHE_BYTE_ORDER;
+  if(!StampFile(annotation_file, header.source))
+    return false;
+
+  uint64_t offset = Align(sizeof(CacheHeader));
+  AddSection(header, CACHE_IMAGES, coco.images, offset);
+  AddSection(header, CACHE_ANNOTATIONS, coco.annotations, offset);
+  AddSection(header, CACHE_CATEGORIES, coco.categories, offset);
+  AddSection(header, CACHE_COORDS, coco.coords, offset);
+  AddSection(header, CACHE_RINGS, coco.rings, offset);
+  AddSection(header, CACHE_COUNTS, coco.counts, offset);
+  AddSection(header, CACHE_STRINGS, coco.strings, offset);
+  AddSection(header, CACHE_IMG_BY_ID, coco.img_by_id, offset);
+  AddSection(header, CACHE_ANN_BY_ID, coco.ann_by_id, offset);
+  AddSection(header, CACHE_CAT_BY_ID, coco.cat_by_id, offset);
+  AddSection(header, CACHE_IMG_ANN_OFFSETS, coco.img_ann_offsets, offset);
+  AddSection(header, CACHE_IMG_ANN_ROWS, coco.img_ann_rows, offset);
+  AddSection(header, CACHE_CAT_IMG_OFFSETS, coco.cat_img_offsets, offset);
+  AddSection(header, CACHE_CAT_IMG_IDS, coco.cat_img_ids, offset);
+  AddSection(header, CACHE_CAT_ANN_OFFSETS, coco.cat_ann_offsets, offset);
+  AddSection(header, CACHE_CAT_ANN_ROWS, coco.cat_ann_rows, offset);
+  AddSection(header, CACHE_AREA_ROWS, coco.area_rows, offset);
+  AddSection(header, CACHE_CROWD_ROWS, coco.crowd_rows, offset);
+
+  std::string tmp_file = cache_file + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream ofs(tmp_file, std::ios::binary | std::ios::trunc);
+    if(!ofs)
+      return false;
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    WriteSection(ofs, header.sections[CACHE_IMAGES], coco.images);
+    WriteSection(ofs, header.sections[CACHE_ANNOTATIONS], coco.annotations);
+    WriteSection(ofs, header.sections[CACHE_CATEGORIES], coco.categories);
+    WriteSection(ofs, header.sections[CACHE_COORDS], coco.coords);
+    WriteSection(ofs, header.sections[CACHE_RINGS], coco.rings);
+    WriteSection(ofs, header.sections[CACHE_COUNTS], coco.counts);
+    WriteSection(ofs, header.sections[CACHE_STRINGS], coco.strings);
+    WriteSection(ofs, header.sections[CACHE_IMG_BY_ID], coco.img_by_id);
+    WriteSection(ofs, header.sections[CACHE_ANN_BY_ID], coco.ann_by_id);
+    WriteSection(ofs, header.sections[CACHE_CAT_BY_ID], coco.cat_by_id);
+    WriteSection(ofs, header.sections[CACHE_IMG_ANN_OFFSETS], coco.img_ann_offsets);
+    WriteSection(ofs, header.sections[CACHE_IMG_ANN_ROWS], coco.img_ann_rows);
+    WriteSection(ofs, header.sections[CACHE_CAT_IMG_OFFSETS], coco.cat_img_offsets);
+    WriteSection(ofs, header.sections[CACHE_CAT_IMG_IDS], coco.cat_img_ids);
+    WriteSection(ofs, header.sections[CACHE_CAT_ANN_OFFSETS], coco.cat_ann_offsets);
+    WriteSection(ofs, header.sections[CACHE_CAT_ANN_ROWS], coco.cat_ann_rows);
+    WriteSection(ofs, header.sections[CACHE_AREA_ROWS], coco.area_rows);
+    WriteSection(ofs, header.sections[CACHE_CROWD_ROWS], coco.crowd_rows);
+    if(!ofs.good()){
+      std::remove(tmp_file.c_str());
+      return false;
+    }
+  }
+  if(std::rename(tmp_file.c_str(), cache_file.c_str()) != 0){
+    std::remove(tmp_file.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool LoadCache(COCO& coco, const std::string& cache_file, const std::string& annotation_file){
+  std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>(cache_file);
+  if(!file->valid() || file->size() < sizeof(CacheHeader))
+    return false;
+
+  CacheHeader header;
+  std::memcpy(&header, file->data(), sizeof(header));
+  if(std::memcmp(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 || header.version != CACHE_VERSION || header.byte_order != CACHE_BYTE_ORDER)
+    return false;
+
+  SourceStamp stamp;
+  if(!StampFile(annotation_file, stamp))
+    return false;
+  if(stamp.size != header.source.size || stamp.mtime != header.source.mtime || stamp.hash != header.source.hash)
+    return false;
+
+  COCO mapped;
+  bool ok = ViewSection(*file, header, CACHE_IMAGES, mapped.images)
+         && ViewSection(*file, header, CACHE_ANNOTATIONS, mapped.annotations)
+         && ViewSection(*file, header, CACHE_CATEGORIES, mapped.categories)
+         && ViewSection(*file, header, CACHE_COORDS, mapped.coords)
+         && ViewSection(*file, header, CACHE_RINGS, mapped.rings)
+         && ViewSection(*file, header, CACHE_COUNTS, mapped.counts)
+         && ViewSection(*file, header, CACHE_STRINGS, mapped.strings)
+         && ViewSection(*file, header, CACHE_IMG_BY_ID, mapped.img_by_id)
+         && ViewSection(*file, header, CACHE_ANN_BY_ID, mapped.ann_by_id)
+         && ViewSection(*file, header, CACHE_CAT_BY_ID, mapped.cat_by_id)
+         && ViewSection(*file, header, CACHE_IMG_ANN_OFFSETS, mapped.img_ann_offsets)
+         && ViewSection(*file, header, CACHE_IMG_ANN_ROWS, mapped.img_ann_rows)
+         && ViewSection(*file, header, CACHE_CAT_IMG_OFFSETS, mapped.cat_img_offsets)
+         && ViewSection(*file, header, CACHE_CAT_IMG_IDS, mapped.cat_img_ids)
+         && ViewSection(*file, header, CACHE_CAT_ANN_OFFSETS, mapped.cat_ann_offsets)
+         && ViewSection(*file, header, CACHE_CAT_ANN_ROWS, mapped.cat_ann_rows)
+         && ViewSection(*file, header, CACHE_AREA_ROWS, mapped.area_rows)
+         && ViewSection(*file, header, CACHE_CROWD_ROWS, mapped.crowd_rows);
+  if(!ok)
+    return false;
+  //csr tables must agree with the record tables
+  if(mapped.img_ann_offsets.size() != mapped.images.size() + 1 || mapped.cat_img_offsets.size() != mapped.categories.size() + 1
+     || mapped.cat_ann_offsets.size() != mapped.categories.size() + 1 || mapped.area_rows.size() != mapped.annotations.size())
+    return false;
+
+  mapped.mapping_ = file;
+  coco = mapped;
+  return true;
+}
+
+}
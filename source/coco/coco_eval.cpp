@@ -0,0 +1,462 @@
+#include "coco_eval.h"
+#include "mask_api.h"
+#include <algorithm>
+#include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstdio>
+#include <iostream>
+#include <numeric>
+#include <thread>
+
+
+namespace coco{
+
+namespace{
+
+//runs func(j) for every j in [0, n) on every core, jobs are handed out one at a time since their cost varies a lot
+template<typename Func>
+void ParallelFor(size_t n, Func func){
+  size_t num_threads = std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n);
+  std::atomic<size_t> next(0);
+  auto work = [&next, &func, n]{
+    for(size_t j = next++; j < n; j = next++)
+      func(j);
+  };
+  if(num_threads <= 1){
+    work();
+    return;
+  }
+  std::vector<std::thread> workers;
+  for(size_t i = 0; i < num_threads; ++i)
+    workers.emplace_back(work);
+  for(auto& worker : workers)
+    worker.join();
+}
+
+//np.linspace, including its rounding
+std::vector<double> Linspace(double start, double stop, int num){
+  std::vector<double> values(num);
+  double step = (stop - start) / (num - 1);
+  for(int i = 0; i < num; ++i)
+    values[i] = i * step + start;
+  values.back() = stop;
+  return values;
+}
+
+bool OutsideRange(double area, const std::array<double, 2>& range){
+  return area < range[0] || area > range[1];
+}
+
+//annToRLE of pycocotools, R owns its counts
+void AnnotationToRLE(const COCO& coco, const AnnotationRecord& ann, RLE* R){
+  const ImageRecord* img = coco.FindImage(ann.image_id);
+  siz h = img->height, w = img->width;
+  if(ann.segm_type == SEGM_POLYGON){
+    siz n = ann.segm_end - ann.segm_begin;
+    std::vector<RLE> rles(n);
+    //frPyObjects reads rings of 4 values as boxes
+    bool boxes = n > 0 && coco.rings[ann.segm_begin + 1] - coco.rings[ann.segm_begin] == 4;
+    for(siz r = 0; r < n; ++r){
+      uint32_t begin = coco.rings[ann.segm_begin + r], end = coco.rings[ann.segm_begin + r + 1];
+      if(boxes)
+        rleFrBbox(&rles[r], const_cast<double*>(coco.coords.data() + begin), h, w, 1);
+      else
+        rleFrPoly(&rles[r], coco.coords.data() + begin, (end - begin) / 2, h, w);
+    }
+    rleMerge(rles.data(), R, n, 0);
+    for(auto& rle : rles)
+      rleFree(&rle);
+  }
+  else if(ann.segm_type == SEGM_RLE)
+    rleInit(R, ann.rle_h, ann.rle_w, ann.segm_end - ann.segm_begin, const_cast<uint*>(coco.counts.data() + ann.segm_begin));
+  else if(ann.segm_type == SEGM_COMPRESSED_RLE)
+    rleFrString(R, std::string(coco.String(ann.segm_begin), ann.segm_end), ann.rle_h, ann.rle_w);
+  else
+    rleInit(R, h, w, 0, nullptr);
+}
+
+double Seconds(std::chrono::steady_clock::time_point start){
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+}//namespace
+
+Params::Params()
+  :iou_thrs(Linspace(.5, .95, 10)),
+   rec_thrs(Linspace(.0, 1., 101)),
+   max_dets{1, 10, 100},
+   area_rng{{{0, 1e10}}, {{0, 32 * 32}}, {{32 * 32, 96 * 96}}, {{96 * 96, 1e10}}},
+   area_rng_lbl{"all", "small", "medium", "large"}{}
+
+COCOeval::COCOeval(const COCO& coco_gt, const COCO& coco_dt, std::string iou_type)
+  :coco_gt_(coco_gt), coco_dt_(coco_dt), iou_type_(iou_type)
+{
+  assert(iou_type_ == "bbox" || iou_type_ == "segm");
+  assert(coco_dt_.scores.size() == coco_dt_.annotations.size());
+  for(auto& img : coco_gt_.images)
+    params.img_ids.push_back(img.id);
+  for(auto& cat : coco_gt_.categories)
+    params.cat_ids.push_back(cat.id);
+  std::sort(params.img_ids.begin(), params.img_ids.end());
+  std::sort(params.cat_ids.begin(), params.cat_ids.end());
+}
+
+COCOeval::COCOeval(const COCO& coco_gt, std::string iou_type)
+  :COCOeval(coco_gt, COCO(), iou_type)
+{
+  added_.assign(params.img_ids.size(), 0);
+}
+
+void COCOeval::Evaluate(){
+  std::cout << "Running per image evaluation...\n";
+  std::cout << "Evaluate annotation type *" << iou_type_ << "*\n";
+  assert(added_.empty());
+  auto start = std::chrono::steady_clock::now();
+
+  std::vector<std::vector<Pair>> by_cat(params.cat_ids.size());
+  for(int i = 0; i < static_cast<int>(params.img_ids.size()); ++i){
+    AddRows(coco_gt_, i, true, by_cat);
+    AddRows(coco_dt_, i, false, by_cat);
+  }
+  pairs_.clear();
+  for(auto& pairs : by_cat)
+    for(auto& pair : pairs)
+      pairs_.push_back(std::move(pair));
+
+  size_t A = params.area_rng.size();
+  eval_imgs_.assign(pairs_.size() * A, EvalImage());
+  ParallelFor(pairs_.size(), [this, A](size_t j){
+    EvaluatePair(coco_dt_, pairs_[j], &eval_imgs_[j * A]);
+  });
+  std::cout << "DONE (t=" << Seconds(start) << "s).\n";
+}
+
+void COCOeval::AddRows(const COCO& coco, int i, bool gt, std::vector<std::vector<Pair>>& by_cat) const{
+  //annotations of an image in file order, bucketed by category like getAnnIds
+  AnnotationRange anns = coco.ImageAnnotations(params.img_ids[i]);
+  for(auto it = anns.begin(); it != anns.end(); ++it){
+    auto k = std::lower_bound(params.cat_ids.begin(), params.cat_ids.end(), it->category_id);
+    if(k == params.cat_ids.end() || *k != it->category_id)
+      continue;
+    std::vector<Pair>& pairs = by_cat[k - params.cat_ids.begin()];
+    if(pairs.empty() || pairs.back().img != i){
+      pairs.emplace_back();
+      pairs.back().img = i;
+      pairs.back().cat = k - params.cat_ids.begin();
+    }
+    (gt ? pairs.back().gt_rows : pairs.back().dt_rows).push_back(it.row());
+  }
+}
+
+void COCOeval::AddImage(int image_id, const float* boxes, const float* scores, const int64_t* category_ids, size_t n){
+  assert(iou_type_ == "bbox");
+  IndexBuilder builder;
+  for(size_t i = 0; i < n; ++i){
+    AnnotationRecord record = AnnotationRecord();
+    record.id = i + 1;
+    record.image_id = image_id;
+    record.category_id = category_ids[i];
+    std::copy(boxes + i * 4, boxes + i * 4 + 4, record.bbox);
+    record.area = static_cast<double>(boxes[i * 4 + 2]) * boxes[i * 4 + 3];
+    //bbox ious never look at the box polygon LoadRes adds
+    record.segm_type = SEGM_NONE;
+    builder.annotations.push_back(record);
+    builder.scores.push_back(scores[i]);
+  }
+  AddImage(image_id, builder);
+}
+
+void COCOeval::AddImage(int image_id, const std::vector<RLEstr>& rles, const float* scores, const int64_t* category_ids){
+  assert(iou_type_ == "segm");
+  IndexBuilder builder;
+  for(size_t i = 0; i < rles.size(); ++i){
+    AnnotationRecord record = AnnotationRecord();
+    record.id = i + 1;
+    record.image_id = image_id;
+    record.category_id = category_ids[i];
+    //area and box of the mask, like LoadRes
+    RLE R;
+    rleFrString(&R, rles[i].counts, rles[i].size.first, rles[i].size.second);
+    uint area;
+    double bbox[4];
+    rleArea(&R, 1, &area);
+    rleToBbox(&R, bbox, 1);
+    rleFree(&R);
+    record.area = area;
+    std::copy(bbox, bbox + 4, record.bbox);
+    record.segm_type = SEGM_COMPRESSED_RLE;
+    record.segm_begin = builder.AddString(rles[i].counts.c_str(), rles[i].counts.size());
+    record.segm_end = rles[i].counts.size();
+    record.rle_h = rles[i].size.first;
+    record.rle_w = rles[i].size.second;
+    builder.annotations.push_back(record);
+    builder.scores.push_back(scores[i]);
+  }
+  AddImage(image_id, builder);
+}
+
+void COCOeval::AddImage(int image_id, IndexBuilder& builder){
+  //unknown and repeated images are skipped, a repeat would count its ground truth twice
+  auto img = std::lower_bound(params.img_ids.begin(), params.img_ids.end(), image_id);
+  if(img == params.img_ids.end() || *img != image_id){
+    std::cout << "image " << image_id << " is not in the ground truth\n";
+    return;
+  }
+  int i = img - params.img_ids.begin();
+  if(added_[i]){
+    std::cout << "image " << image_id << " was already added\n";
+    return;
+  }
+  added_[i] = 1;
+  ImageRecord record = *coco_gt_.FindImage(image_id);
+  record.file_name = 0;
+  builder.images.push_back(record);
+  COCO coco_dt;
+  coco_dt.CreateIndex(builder);
+
+  std::vector<std::vector<Pair>> by_cat(params.cat_ids.size());
+  AddRows(coco_gt_, i, true, by_cat);
+  AddRows(coco_dt, i, false, by_cat);
+  size_t A = params.area_rng.size();
+  for(auto& pairs : by_cat){
+    for(auto& pair : pairs){
+      eval_imgs_.resize(eval_imgs_.size() + A);
+      EvaluatePair(coco_dt, pair, &eval_imgs_[eval_imgs_.size() - A]);
+      pairs_.emplace_back();
+      pairs_.back().img = pair.img;
+      pairs_.back().cat = pair.cat;
+    }
+  }
+}
+
+std::vector<double> COCOeval::ComputeIoU(const COCO& coco_dt, const std::vector<uint32_t>& gt_rows, const std::vector<uint32_t>& dt_rows) const{
+  siz G = gt_rows.size(), D = dt_rows.size();
+  std::vector<double> ious(G * D);
+  if(G == 0 || D == 0)
+    return ious;
+  std::vector<double> gt_boxes(G * 4), dt_boxes(D * 4);
+  std::vector<byte> iscrowd(G);
+  for(siz g = 0; g < G; ++g)
+    iscrowd[g] = coco_gt_.annotations[gt_rows[g]].iscrowd;
+  if(iou_type_ == "bbox"){
+    for(siz g = 0; g < G; ++g){
+      const AnnotationRecord& gt = coco_gt_.annotations[gt_rows[g]];
+      std::copy(gt.bbox, gt.bbox + 4, &gt_boxes[g * 4]);
+    }
+    for(siz d = 0; d < D; ++d){
+      const AnnotationRecord& dt = coco_dt.annotations[dt_rows[d]];
+      std::copy(dt.bbox, dt.bbox + 4, &dt_boxes[d * 4]);
+    }
+    bbIou(dt_boxes.data(), gt_boxes.data(), D, G, iscrowd.data(), ious.data());
+    return ious;
+  }
+
+  //every mask is decoded once, and only pairs whose mask boxes overlap are compared pixel run by pixel run
+  std::vector<RLE> gts(G), dts(D);
+  for(siz g = 0; g < G; ++g)
+    AnnotationToRLE(coco_gt_, coco_gt_.annotations[gt_rows[g]], &gts[g]);
+  for(siz d = 0; d < D; ++d)
+    AnnotationToRLE(coco_dt, coco_dt.annotations[dt_rows[d]], &dts[d]);
+  rleToBbox(gts.data(), gt_boxes.data(), G);
+  rleToBbox(dts.data(), dt_boxes.data(), D);
+  bbIou(dt_boxes.data(), gt_boxes.data(), D, G, iscrowd.data(), ious.data());
+  for(siz g = 0; g < G; ++g)
+    for(siz d = 0; d < D; ++d)
+      if(ious[g * D + d] > 0)
+        ious[g * D + d] = rleIouPair(&dts[d], &gts[g], iscrowd[g]);
+  for(auto& rle : gts)
+    rleFree(&rle);
+  for(auto& rle : dts)
+    rleFree(&rle);
+  return ious;
+}
+
+void COCOeval::EvaluatePair(const COCO& coco_dt, Pair& pair, EvalImage* evals) const{
+  //highest score first, ties in file order
+  std::stable_sort(pair.dt_rows.begin(), pair.dt_rows.end(), [&coco_dt](uint32_t a, uint32_t b){
+    return coco_dt.scores[a] > coco_dt.scores[b];
+  });
+  if(pair.dt_rows.size() > static_cast<size_t>(params.max_dets.back()))
+    pair.dt_rows.resize(params.max_dets.back());
+  std::vector<double> ious = ComputeIoU(coco_dt, pair.gt_rows, pair.dt_rows);
+
+  size_t T = params.iou_thrs.size(), G = pair.gt_rows.size(), D = pair.dt_rows.size();
+  for(size_t a = 0; a < params.area_rng.size(); ++a){
+    //ignored ground truths last
+    std::vector<uint8_t> ignore(G);
+    for(size_t g = 0; g < G; ++g){
+      const AnnotationRecord& gt = coco_gt_.annotations[pair.gt_rows[g]];
+      ignore[g] = gt.iscrowd || OutsideRange(gt.area, params.area_rng[a]);
+    }
+    std::vector<size_t> order(G);
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&ignore](size_t x, size_t y){ return ignore[x] < ignore[y]; });
+
+    EvalImage& eval = evals[a];
+    eval.dt_matched.assign(T * D, 0);
+    eval.dt_ignore.assign(T * D, 0);
+    eval.num_gt = std::count(ignore.begin(), ignore.end(), 0);
+    std::vector<uint8_t> gt_matched(T * G, 0);
+    for(size_t t = 0; t < T; ++t){
+      for(size_t d = 0; d < D; ++d){
+        double iou = std::min(params.iou_thrs[t], 1 - 1e-10);
+        int m = -1;
+        for(size_t gi = 0; gi < G; ++gi){
+          size_t g = order[gi];
+          if(gt_matched[t * G + g] && !coco_gt_.annotations[pair.gt_rows[g]].iscrowd)
+            continue;
+          //a match that is not ignored beats the ignored ground truths that follow
+          if(m > -1 && !ignore[m] && ignore[g])
+            break;
+          if(ious[g * D + d] < iou)
+            continue;
+          iou = ious[g * D + d];
+          m = g;
+        }
+        if(m == -1)
+          continue;
+        eval.dt_ignore[t * D + d] = ignore[m];
+        eval.dt_matched[t * D + d] = 1;
+        gt_matched[t * G + m] = 1;
+      }
+    }
+    //unmatched detections outside the area range are ignored
+    eval.dt_scores.resize(D);
+    for(size_t d = 0; d < D; ++d){
+      eval.dt_scores[d] = coco_dt.scores[pair.dt_rows[d]];
+      if(!OutsideRange(coco_dt.annotations[pair.dt_rows[d]].area, params.area_rng[a]))
+        continue;
+      for(size_t t = 0; t < T; ++t)
+        if(!eval.dt_matched[t * D + d])
+          eval.dt_ignore[t * D + d] = 1;
+    }
+  }
+}
+
+void COCOeval::Accumulate(){
+  std::cout << "Accumulating evaluation results...\n";
+  auto start = std::chrono::steady_clock::now();
+  size_t T = params.iou_thrs.size(), R = params.rec_thrs.size(), K = params.cat_ids.size();
+  size_t A = params.area_rng.size(), M = params.max_dets.size();
+  precision.assign(T * R * K * A * M, -1);
+  recall.assign(T * K * A * M, -1);
+
+  //pairs by category then image, online pairs come in the order of their images
+  std::vector<size_t> order(pairs_.size());
+  std::iota(order.begin(), order.end(), 0);
+  std::stable_sort(order.begin(), order.end(), [this](size_t x, size_t y){
+    return std::make_pair(pairs_[x].cat, pairs_[x].img) < std::make_pair(pairs_[y].cat, pairs_[y].img);
+  });
+  std::vector<size_t> cat_begin(K + 1, pairs_.size());
+  for(size_t j = pairs_.size(); j-- > 0;)
+    cat_begin[pairs_[order[j]].cat] = j;
+  for(size_t k = K; k-- > 0;)
+    cat_begin[k] = std::min(cat_begin[k], cat_begin[k + 1]);
+
+  ParallelFor(K, [&](size_t k){
+    for(size_t a = 0; a < A; ++a){
+      for(size_t m = 0; m < M; ++m){
+        size_t max_det = params.max_dets[m];
+        //detections of every image, in image order
+        std::vector<double> scores;
+        std::vector<std::pair<size_t, size_t>> sources;//(eval, detection)
+        int num_gt = 0;
+        for(size_t j = cat_begin[k]; j < cat_begin[k + 1]; ++j){
+          const EvalImage& eval = eval_imgs_[order[j] * A + a];
+          num_gt += eval.num_gt;
+          for(size_t d = 0; d < std::min(max_det, eval.dt_scores.size()); ++d){
+            scores.push_back(eval.dt_scores[d]);
+            sources.emplace_back(order[j] * A + a, d);
+          }
+        }
+        if(cat_begin[k] == cat_begin[k + 1] || num_gt == 0)
+          continue;
+        std::vector<size_t> inds(scores.size());
+        std::iota(inds.begin(), inds.end(), 0);
+        std::stable_sort(inds.begin(), inds.end(), [&scores](size_t x, size_t y){ return scores[x] > scores[y]; });
+
+        size_t nd = inds.size();
+        std::vector<double> rc(nd), pr(nd);
+        for(size_t t = 0; t < T; ++t){
+          double tp = 0, fp = 0;
+          for(size_t n = 0; n < nd; ++n){
+            const EvalImage& eval = eval_imgs_[sources[inds[n]].first];
+            size_t d = sources[inds[n]].second, offset = t * eval.dt_scores.size() + d;
+            if(!eval.dt_ignore[offset])
+              (eval.dt_matched[offset] ? tp : fp) += 1;
+            rc[n] = tp / num_gt;
+            pr[n] = tp / (fp + tp + 2.220446049250313e-16);
+          }
+          recall[((t * K + k) * A + a) * M + m] = nd ? rc.back() : 0;
+          //precision envelope
+          for(size_t n = nd; n-- > 1;)
+            if(pr[n] > pr[n - 1])
+              pr[n - 1] = pr[n];
+          //recall thresholds beyond the reached recall keep precision 0
+          for(size_t r = 0; r < R; ++r){
+            size_t pi = std::lower_bound(rc.begin(), rc.end(), params.rec_thrs[r]) - rc.begin();
+            precision[(((t * R + r) * K + k) * A + a) * M + m] = pi < nd ? pr[pi] : 0;
+          }
+        }
+      }
+    }
+  });
+  std::cout << "DONE (t=" << Seconds(start) << "s).\n";
+}
+
+double COCOeval::SummarizeOne(bool ap, double iou_thr, const std::string& area_rng, int max_dets) const{
+  size_t T = params.iou_thrs.size(), R = params.rec_thrs.size(), K = params.cat_ids.size();
+  size_t A = params.area_rng.size(), M = params.max_dets.size();
+  size_t a = std::find(params.area_rng_lbl.begin(), params.area_rng_lbl.end(), area_rng) - params.area_rng_lbl.begin();
+  size_t m = std::find(params.max_dets.begin(), params.max_dets.end(), max_dets) - params.max_dets.begin();
+  double sum = 0;
+  size_t count = 0;
+  for(size_t t = 0; t < T; ++t){
+    //a negative threshold averages over all of them
+    if(iou_thr >= 0 && params.iou_thrs[t] != iou_thr)
+      continue;
+    for(size_t k = 0; k < K; ++k){
+      for(size_t r = 0; r < (ap ? R : 1); ++r){
+        double s = ap ? precision[(((t * R + r) * K + k) * A + a) * M + m] : recall[((t * K + k) * A + a) * M + m];
+        if(s > -1){
+          sum += s;
+          count++;
+        }
+      }
+    }
+  }
+  double mean = count ? sum / count : -1;
+
+  char iou_str[16];
+  if(iou_thr < 0)
+    snprintf(iou_str, sizeof(iou_str), "%0.2f:%0.2f", params.iou_thrs.front(), params.iou_thrs.back());
+  else
+    snprintf(iou_str, sizeof(iou_str), "%0.2f", iou_thr);
+  char line[128];
+  snprintf(line, sizeof(line), " %-18s %s @[ IoU=%-9s | area=%6s | maxDets=%3d ] = %0.3f",
+           ap ? "Average Precision" : "Average Recall", ap ? "(AP)" : "(AR)", iou_str, area_rng.c_str(), max_dets, mean);
+  std::cout << line << "\n";
+  return mean;
+}
+
+void COCOeval::Summarize(){
+  assert(!precision.empty());
+  int max_det = params.max_dets.back();
+  stats = std::vector<double>{
+    SummarizeOne(true, -1, "all", max_det),
+    SummarizeOne(true, .5, "all", max_det),
+    SummarizeOne(true, .75, "all", max_det),
+    SummarizeOne(true, -1, "small", max_det),
+    SummarizeOne(true, -1, "medium", max_det),
+    SummarizeOne(true, -1, "large", max_det),
+    SummarizeOne(false, -1, "all", params.max_dets[0]),
+    SummarizeOne(false, -1, "all", params.max_dets[1]),
+    SummarizeOne(false, -1, "all", max_det),
+    SummarizeOne(false, -1, "small", max_det),
+    SummarizeOne(false, -1, "medium", max_det),
+    SummarizeOne(false, -1, "large", max_det)
+  };
+}
+
+}
@@ -0,0 +1,304 @@
+#include "coco_reader.h"
+#include <rapidjson/reader.h>
+#include <rapidjson/filereadstream.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+
+
+namespace coco{
+
+namespace{
+
+enum Section{
+  SECTION_NONE,
+  SECTION_IMAGES,
+  SECTION_ANNOTATIONS,
+  SECTION_CATEGORIES
+};
+
+enum Field{
+  FIELD_OTHER,
+  FIELD_ID,
+  FIELD_IMAGE_ID,
+  FIELD_CATEGORY_ID,
+  FIELD_AREA,
+  FIELD_ISCROWD,
+  FIELD_BBOX,
+  FIELD_SEGMENTATION,
+  FIELD_WIDTH,
+  FIELD_HEIGHT,
+  FIELD_FILE_NAME,
+  FIELD_NAME,
+  FIELD_SUPERCATEGORY,
+  FIELD_SIZE,
+  FIELD_COUNTS
+};
+
+Field ToField(const char* str, SizeType length){
+  static const struct{ const char* name; Field field; } fields[] = {
+    {"id", FIELD_ID}, {"image_id", FIELD_IMAGE_ID}, {"category_id", FIELD_CATEGORY_ID},
+    {"area", FIELD_AREA}, {"iscrowd", FIELD_ISCROWD}, {"bbox", FIELD_BBOX},
+    {"segmentation", FIELD_SEGMENTATION}, {"width", FIELD_WIDTH}, {"height", FIELD_HEIGHT},
+    {"file_name", FIELD_FILE_NAME}, {"name", FIELD_NAME}, {"supercategory", FIELD_SUPERCATEGORY},
+    {"size", FIELD_SIZE}, {"counts", FIELD_COUNTS}
+  };
+  for(auto& f : fields){
+    if(std::strlen(f.name) == length && std::strncmp(f.name, str, length) == 0)
+      return f.field;
+  }
+  return FIELD_OTHER;
+}
+
+//depth counts the open containers:
+//1 top level object, 2 section array, 3 record object, 4 bbox/segmentation, 5 ring/size/counts
+class AnnotationHandler : public BaseReaderHandler<UTF8<>, AnnotationHandler>{
+
+public:
+  AnnotationHandler(IndexBuilder& builder)
+                   :builder_(builder),
+                    depth_(0),
+                    skip_depth_(0),
+                    section_(SECTION_NONE),
+                    field_(FIELD_OTHER),
+                    segm_field_(FIELD_OTHER),
+                    segm_object_(false),
+                    index_(0){}
+
+  bool Default(){ return true; }
+  bool Int(int i){ return Number(i); }
+  bool Uint(unsigned u){ return Number(u); }
+  bool Int64(int64_t i){ return Number(static_cast<double>(i)); }
+  bool Uint64(uint64_t u){ return Number(static_cast<double>(u)); }
+  bool Double(double d){ return Number(d); }
+
+  bool String(const char* str, SizeType length, bool copy){
+    if(skip_depth_ || depth_ < 3)
+      return true;
+    if(depth_ == 3){
+      if(section_ == SECTION_IMAGES && field_ == FIELD_FILE_NAME)
+        image_.file_name = builder_.AddString(str, length);
+      else if(section_ == SECTION_CATEGORIES && field_ == FIELD_NAME)
+        category_.name = builder_.AddString(str, length);
+      else if(section_ == SECTION_CATEGORIES && field_ == FIELD_SUPERCATEGORY)
+        category_.supercategory = builder_.AddString(str, length);
+    }
+    else if(depth_ == 4 && segm_object_ && segm_field_ == FIELD_COUNTS){
+      annotation_.segm_type = SEGM_COMPRESSED_RLE;
+      annotation_.segm_begin = builder_.AddString(str, length);
+      annotation_.segm_end = length;
+    }
+    return true;
+  }
+
+  bool Key(const char* str, SizeType length, bool copy){
+    if(skip_depth_)
+      return true;
+    if(depth_ == 1){
+      section_ = SECTION_NONE;
+      if(length == 6 && std::strncmp(str, "images", length) == 0)
+        section_ = SECTION_IMAGES;
+      else if(length == 11 && std::strncmp(str, "annotations", length) == 0)
+        section_ = SECTION_ANNOTATIONS;
+      else if(length == 10 && std::strncmp(str, "categories", length) == 0)
+        section_ = SECTION_CATEGORIES;
+    }
+    else if(depth_ == 3)
+      field_ = ToField(str, length);
+    else if(depth_ == 4 && segm_object_)
+      segm_field_ = ToField(str, length);
+    return true;
+  }
+
+  bool StartObject(){
+    depth_++;
+    if(skip_depth_ || depth_ == 1)
+      return true;
+    if(depth_ == 3 && section_ != SECTION_NONE)
+      BeginRecord();
+    else if(depth_ == 4 && section_ == SECTION_ANNOTATIONS && field_ == FIELD_SEGMENTATION){
+      segm_object_ = true;
+      segm_field_ = FIELD_OTHER;
+    }
+    else
+      skip_depth_ = depth_;
+    return true;
+  }
+
+  bool EndObject(SizeType member_count){
+    if(skip_depth_){
+      if(skip_depth_ == depth_)
+        skip_depth_ = 0;
+      depth_--;
+      return true;
+    }
+    if(depth_ == 3 && section_ != SECTION_NONE)
+      EndRecord();
+    else if(depth_ == 4 && segm_object_)
+      segm_object_ = false;
+    depth_--;
+    return true;
+  }
+
+  bool StartArray(){
+    depth_++;
+    if(skip_depth_)
+      return true;
+    bool annotation = section_ == SECTION_ANNOTATIONS;
+    if(depth_ == 2 && section_ != SECTION_NONE)
+      return true;
+    if(depth_ == 4 && annotation && field_ == FIELD_BBOX){
+      index_ = 0;
+      return true;
+    }
+    if(depth_ == 4 && annotation && field_ == FIELD_SEGMENTATION){
+      annotation_.segm_type = SEGM_POLYGON;
+      annotation_.segm_begin = static_cast<uint32_t>(builder_.rings.size() - 1);
+      return true;
+    }
+    if(depth_ == 5 && annotation && annotation_.segm_type == SEGM_POLYGON && !segm_object_)
+      return true;
+    if(depth_ == 5 && annotation && segm_object_ && segm_field_ == FIELD_SIZE){
+      index_ = 0;
+      return true;
+    }
+    if(depth_ == 5 && annotation && segm_object_ && segm_field_ == FIELD_COUNTS){
+      annotation_.segm_type = SEGM_RLE;
+      annotation_.segm_begin = static_cast<uint32_t>(builder_.counts.size());
+      return true;
+    }
+    skip_depth_ = depth_;
+    return true;
+  }
+
+  bool EndArray(SizeType element_count){
+    if(skip_depth_){
+      if(skip_depth_ == depth_)
+        skip_depth_ = 0;
+      depth_--;
+      return true;
+    }
+    if(depth_ == 5 && !segm_object_)
+      builder_.rings.push_back(static_cast<uint32_t>(builder_.coords.size()));
+    else if(depth_ == 5 && segm_object_ && segm_field_ == FIELD_COUNTS)
+      annotation_.segm_end = static_cast<uint32_t>(builder_.counts.size());
+    else if(depth_ == 4 && field_ == FIELD_SEGMENTATION && !segm_object_)
+      annotation_.segm_end = static_cast<uint32_t>(builder_.rings.size() - 1);
+    else if(depth_ == 2)
+      section_ = SECTION_NONE;
+    depth_--;
+    return true;
+  }
+
+private:
+  bool Number(double value){
+    if(skip_depth_ || depth_ < 3)
+      return true;
+    if(depth_ == 3)
+      SetField(value);
+    else if(depth_ == 4 && field_ == FIELD_BBOX){
+      if(index_ < 4)
+        annotation_.bbox[index_] = value;
+      index_++;
+    }
+    else if(depth_ == 5 && !segm_object_)
+      builder_.coords.push_back(value);
+    else if(depth_ == 5 && segm_field_ == FIELD_SIZE){
+      if(index_ == 0)
+        annotation_.rle_h = static_cast<int32_t>(value);
+      else if(index_ == 1)
+        annotation_.rle_w = static_cast<int32_t>(value);
+      index_++;
+    }
+    else if(depth_ == 5 && segm_field_ == FIELD_COUNTS)
+      builder_.counts.push_back(static_cast<uint32_t>(value));
+    return true;
+  }
+
+  void SetField(double value){
+    if(section_ == SECTION_IMAGES){
+      if(field_ == FIELD_ID)
+        image_.id = static_cast<int32_t>(value);
+      else if(field_ == FIELD_WIDTH)
+        image_.width = static_cast<int32_t>(value);
+      else if(field_ == FIELD_HEIGHT)
+        image_.height = static_cast<int32_t>(value);
+    }
+    else if(section_ == SECTION_ANNOTATIONS){
+      if(field_ == FIELD_ID)
+        annotation_.id = static_cast<int64_t>(value);
+      else if(field_ == FIELD_IMAGE_ID)
+        annotation_.image_id = static_cast<int32_t>(value);
+      else if(field_ == FIELD_CATEGORY_ID)
+        annotation_.category_id = static_cast<int32_t>(value);
+      else if(field_ == FIELD_AREA)
+        annotation_.area = value;
+      else if(field_ == FIELD_ISCROWD)
+        annotation_.iscrowd = static_cast<int32_t>(value);
+    }
+    else if(section_ == SECTION_CATEGORIES && field_ == FIELD_ID)
+      category_.id = static_cast<int32_t>(value);
+  }
+
+  void BeginRecord(){
+    field_ = FIELD_OTHER;
+    std::memset(&image_, 0, sizeof(image_));
+    std::memset(&annotation_, 0, sizeof(annotation_));
+    std::memset(&category_, 0, sizeof(category_));
+  }
+
+  void EndRecord(){
+    if(section_ == SECTION_IMAGES)
+      builder_.images.push_back(image_);
+    else if(section_ == SECTION_ANNOTATIONS)
+      builder_.annotations.push_back(annotation_);
+    else if(section_ == SECTION_CATEGORIES)
+      builder_.categories.push_back(category_);
+    field_ = FIELD_OTHER;
+  }
+
+  IndexBuilder& builder_;
+  int depth_;
+  int skip_depth_;
+  Section section_;
+  Field field_;
+  Field segm_field_;
+  bool segm_object_;
+  int index_;
+  ImageRecord image_;
+  AnnotationRecord annotation_;
+  CategoryRecord category_;
+};
+
+}//namespace
+
+bool ReadAnnotationFile(const std::string& annotation_file, IndexBuilder& builder){
+  FILE* fp = std::fopen(annotation_file.c_str(), "rb");
+  if(!fp)
+    return false;
+
+  //rough per-byte ratios of coco instance files, reserved capacity that is never touched stays virtual
+  struct stat st;
+  if(stat(annotation_file.c_str(), &st) == 0){
+    size_t bytes = static_cast<size_t>(st.st_size);
+    builder.images.reserve(bytes / 2048);
+    builder.annotations.reserve(bytes / 256);
+    builder.coords.reserve(bytes / 6);
+    builder.rings.reserve(bytes / 256);
+  }
+
+  char buffer[1 << 16];
+  FileReadStream is(fp, buffer, sizeof(buffer));
+  AnnotationHandler handler(builder);
+  Reader reader;
+  ParseResult result = reader.Parse(is, handler);
+  std::fclose(fp);
+  if(result.IsError()){
+    std::cout << "annotation parse error at offset " << result.Offset() << "\n";
+    return false;
+  }
+  return true;
+}
+
+}
@@ -0,0 +1,219 @@
+#include "coco_results.h"
+#include "coco_cache.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+
+namespace coco{
+
+ResultsWriter::ResultsWriter(const std::string& results_file, bool binary)
+  :file_(fopen(results_file.c_str(), "wb")), binary_(binary), count_(0), buffer_(1 << 16)
+{
+  //writes and Close fail without a file
+  if(!file_){
+    std::cout << "could not open results file " << results_file << "\n";
+    return;
+  }
+  stream_.reset(new FileWriteStream(file_, buffer_.data(), buffer_.size()));
+  if(binary_){
+    ResultsHeader header;
+    std::memset(&header, 0, sizeof(header));
+    std::memcpy(header.magic, RESULTS_MAGIC, sizeof(RESULTS_MAGIC));
+    header.version = RESULTS_VERSION;
+    header.byte_order = CACHE_BYTE_ORDER;
+    const char* bytes = reinterpret_cast<const char*>(&header);
+    for(size_t i = 0; i < sizeof(header); ++i)
+      stream_->Put(bytes[i]);
+  }
+  else{
+    writer_.reset(new Writer<FileWriteStream>(*stream_));
+    writer_->StartArray();
+  }
+}
+
+ResultsWriter::~ResultsWriter(){
+  if(file_)
+    Close();
+}
+
+bool ResultsWriter::Write(int64_t image_id, const float* boxes, const float* scores, const int64_t* category_ids, size_t n){
+  if(!file_)
+    return false;
+  for(size_t i = 0; i < n; ++i){
+    if(binary_){
+      DetectionRecord record;
+      record.image_id = image_id;
+      record.category_id = category_ids[i];
+      record.score = scores[i];
+      std::memcpy(record.bbox, boxes + i * 4, sizeof(record.bbox));
+      const char* bytes = reinterpret_cast<const char*>(&record);
+      for(size_t j = 0; j < sizeof(record); ++j)
+        stream_->Put(bytes[j]);
+      continue;
+    }
+    //floats are written widened to double, like the values of a Document
+    writer_->StartObject();
+    writer_->Key("image_id");
+    writer_->Int64(image_id);
+    writer_->Key("score");
+    writer_->Double(scores[i]);
+    writer_->Key("bbox");
+    writer_->StartArray();
+    for(int j = 0; j < 4; ++j)
+      writer_->Double(boxes[i * 4 + j]);
+    writer_->EndArray();
+    writer_->Key("category_id");
+    writer_->Int64(category_ids[i]);
+    writer_->EndObject();
+  }
+  count_ += n;
+  return true;
+}
+
+bool ResultsWriter::Write(int64_t image_id, const std::vector<RLEstr>& rles, const float* scores, const int64_t* category_ids){
+  assert(!binary_);
+  if(!file_)
+    return false;
+  for(size_t i = 0; i < rles.size(); ++i){
+    writer_->StartObject();
+    writer_->Key("image_id");
+    writer_->Int64(image_id);
+    writer_->Key("score");
+    writer_->Double(scores[i]);
+    writer_->Key("segmentation");
+    writer_->StartObject();
+    writer_->Key("size");
+    writer_->StartArray();
+    writer_->Uint64(rles[i].size.first);
+    writer_->Uint64(rles[i].size.second);
+    writer_->EndArray();
+    writer_->Key("counts");
+    writer_->String(rles[i].counts.c_str(), rles[i].counts.size());
+    writer_->EndObject();
+    writer_->Key("category_id");
+    writer_->Int64(category_ids[i]);
+    writer_->EndObject();
+  }
+  count_ += rles.size();
+  return true;
+}
+
+bool ResultsWriter::Close(){
+  if(!file_)
+    return false;
+  if(writer_)
+    writer_->EndArray();
+  stream_->Flush();
+  bool good = !ferror(file_);
+  good = fclose(file_) == 0 && good;
+  file_ = nullptr;
+  return good;
+}
+
+size_t ResultsWriter::count() const{
+  return count_;
+}
+
+std::vector<RLEstr> EncodeMasks(const uint8_t* masks, siz n, siz h, siz w){
+  std::vector<RLEstr> rles(n);
+  auto encode = [&rles, masks, h, w](siz begin, siz end){
+    //counts are reused across the masks of a thread
+    std::vector<uint> cnts;
+    for(siz i = begin; i < end; ++i){
+      const uint8_t* mask = masks + i * h * w;
+      cnts.clear();
+      uint8_t p = 0;
+      uint c = 0;
+      //rle runs down the columns
+      for(siz x = 0; x < w; ++x){
+        for(siz y = 0; y < h; ++y){
+          uint8_t v = mask[y * w + x] != 0;
+          if(v != p){
+            cnts.push_back(c);
+            c = 0;
+            p = v;
+          }
+          c++;
+        }
+      }
+      cnts.push_back(c);
+      RLE R{h, w, cnts.size(), cnts.data()};
+      char* counts = rleToString(&R);
+      rles[i] = RLEstr(std::make_pair(h, w), counts);
+      delete[] counts;
+    }
+  };
+
+  //not worth a thread below about a megapixel of masks
+  siz num_threads = std::max<siz>(1, std::min<siz>(std::min<siz>(std::max(1u, std::thread::hardware_concurrency()), n), n * h * w >> 20));
+  if(num_threads == 1){
+    encode(0, n);
+    return rles;
+  }
+  std::vector<std::thread> workers;
+  siz chunk = (n + num_threads - 1) / num_threads;
+  for(siz begin = 0; begin < n; begin += chunk)
+    workers.emplace_back(encode, begin, std::min(n, begin + chunk));
+  for(auto& worker : workers)
+    worker.join();
+  return rles;
+}
+
+COCO LoadDetections(const COCO& coco_gt, const std::string& results_file){
+  std::ifstream ifs(results_file, std::ios::binary);
+  ResultsHeader header;
+  bool valid = static_cast<bool>(ifs.read(reinterpret_cast<char*>(&header), sizeof(header)));
+  valid = valid && std::memcmp(header.magic, RESULTS_MAGIC, sizeof(RESULTS_MAGIC)) == 0;
+  valid = valid && header.version == RESULTS_VERSION && header.byte_order == CACHE_BYTE_ORDER;
+
+  IndexBuilder builder;
+  for(auto& img : coco_gt.images){
+    ImageRecord record = img;
+    const char* file_name = coco_gt.String(img.file_name);
+    record.file_name = builder.AddString(file_name, std::strlen(file_name));
+    builder.images.push_back(record);
+  }
+  for(auto& cat : coco_gt.categories){
+    CategoryRecord record = cat;
+    const char* name = coco_gt.String(cat.name);
+    const char* supercategory = coco_gt.String(cat.supercategory);
+    record.name = builder.AddString(name, std::strlen(name));
+    record.supercategory = builder.AddString(supercategory, std::strlen(supercategory));
+    builder.categories.push_back(record);
+  }
+
+  //an unreadable file gives a result set without detections
+  if(!valid)
+    std::cout << "not a detections file " << results_file << "\n";
+
+  //same ids, areas and box polygons as LoadRes gives json results
+  DetectionRecord detection;
+  while(valid && ifs.read(reinterpret_cast<char*>(&detection), sizeof(detection))){
+    AnnotationRecord record;
+    record.id = builder.annotations.size() + 1;
+    record.image_id = detection.image_id;
+    record.category_id = detection.category_id;
+    std::copy(detection.bbox, detection.bbox + 4, record.bbox);
+    record.area = static_cast<double>(detection.bbox[2]) * detection.bbox[3];
+    record.iscrowd = 0;
+    double x1 = detection.bbox[0], y1 = detection.bbox[1], x2 = x1 + detection.bbox[2], y2 = y1 + detection.bbox[3];
+    record.segm_type = SEGM_POLYGON;
+    record.segm_begin = static_cast<uint32_t>(builder.rings.size() - 1);
+    builder.coords.insert(builder.coords.end(), {x1, y1, x1, y2, x2, y2, x2, y1});
+    builder.rings.push_back(static_cast<uint32_t>(builder.coords.size()));
+    record.segm_end = static_cast<uint32_t>(builder.rings.size() - 1);
+    record.rle_h = record.rle_w = 0;
+    builder.annotations.push_back(record);
+    builder.scores.push_back(detection.score);
+  }
+
+  COCO res;
+  res.CreateIndex(builder);
+  return res;
+}
+
+}
@@ -126,18 +126,22 @@ void rleIou(RLE *dt, RLE *gt, siz m, siz n, byte *iscrowd, double *o) {
   delete[] gb;
   for( g=0; g<n; g++ ) for( d=0; d<m; d++ ) if(o[g*m+d]>0) {
     crowd=iscrowd!=NULL && iscrowd[g];
-    if(dt[d].h!=gt[g].h || dt[d].w!=gt[g].w) { o[g*m+d]=-1; continue; }
-    siz ka, kb, a, b; uint c, ca, cb, ct, i, u; int va, vb;
-    ca=dt[d].cnts[0]; ka=dt[d].m; va=vb=0;
-    cb=gt[g].cnts[0]; kb=gt[g].m; a=b=1; i=u=0; ct=1;
-    while( ct>0 ) {
-      c=umin(ca,cb); if(va||vb) { u+=c; if(va&&vb) i+=c; } ct=0;
-      ca-=c; if(!ca && a<ka) { ca=dt[d].cnts[a++]; va=!va; } ct+=ca;
-      cb-=c; if(!cb && b<kb) { cb=gt[g].cnts[b++]; vb=!vb; } ct+=cb;
-    }
-    if(i==0) u=1; else if(crowd) rleArea(dt+d,1,&u);
-    o[g*m+d] = (double)i/(double)u;
+    o[g*m+d] = rleIouPair(dt+d, gt+g, crowd);
+  }
+}
+
+double rleIouPair( const RLE *dt, const RLE *gt, int iscrowd ) {
+  if(dt->h!=gt->h || dt->w!=gt->w) return -1;
+  siz ka, kb, a, b; uint c, ca, cb, ct, i, u; int va, vb;
+  ca=dt->cnts[0]; ka=dt->m; va=vb=0;
+  cb=gt->cnts[0]; kb=gt->m; a=b=1; i=u=0; ct=1;
+  while( ct>0 ) {
+    c=umin(ca,cb); if(va||vb) { u+=c; if(va&&vb) i+=c; } ct=0;
+    ca-=c; if(!ca && a<ka) { ca=dt->cnts[a++]; va=!va; } ct+=ca;
+    cb-=c; if(!cb && b<kb) { cb=gt->cnts[b++]; vb=!vb; } ct+=cb;
   }
+  if(i==0) u=1; else if(iscrowd) rleArea(dt,1,&u);
+  return (double)i/(double)u;
 }
 
 void rleNms( RLE *dt, siz n, uint *keep, double thr ) {
@@ -204,9 +208,10 @@ int uintCompare(const void *a, const void *b) {
   uint c=*((uint*)a), d=*((uint*)b); return c>d?1:c<d?-1:0;
 }
 
-void rleFrPoly( RLE *R, const double *xy, siz k, siz h, siz w ) {
+/* column major positions where the mask of the polygon toggles, sorted and closed by h*w */
+static siz polyToggles( const double *xy, siz k, siz h, siz w, uint **toggles ) {
   /* upsample and get discrete points densely along entire boundary */
-  siz j, m=0; double scale=5; int *x, *y, *u, *v; uint *a, *b;
+  siz j, m=0; double scale=5; int *x, *y, *u, *v; uint *a;
   x = new int[k+1]; //malloc(sizeof(int)*(k+1)); 
   y = new int[k+1]; //malloc(sizeof(int)*(k+1));
   for(j=0; j<k; j++) x[j]=(int)(scale*xy[j*2+0]+.5); x[k]=x[0];
@@ -241,7 +246,6 @@ void rleFrPoly( RLE *R, const double *xy, siz k, siz h, siz w ) {
     if(yd<0) yd=0; else if(yd>h) yd=h; yd=ceil(yd);
     x[m]=(int) xd; y[m]=(int) yd; m++;
   }
-  /* compute rle encoding given y-boundary points */
   k=m;
   a = new uint[k+1]; //malloc(sizeof(uint)*(k+1));
   for( j=0; j<k; j++ ) a[j]=(uint)(x[j]*(int)(h)+y[j]);
@@ -250,7 +254,14 @@ void rleFrPoly( RLE *R, const double *xy, siz k, siz h, siz w ) {
   delete[] v;
   delete[] x;
   delete[] y;
-  qsort(a,k,sizeof(uint),uintCompare); uint p=0;
+  qsort(a,k,sizeof(uint),uintCompare);
+  *toggles=a; return k;
+}
+
+void rleFrPoly( RLE *R, const double *xy, siz k, siz h, siz w ) {
+  /* compute rle encoding given y-boundary points */
+  siz j, m; uint *a, *b;
+  k=polyToggles(xy,k,h,w,&a); uint p=0;
   for( j=0; j<k; j++ ) { uint t=a[j]; a[j]-=p; p=t; }
   b = new uint[k]; //malloc(sizeof(uint)*k); 
   j=m=0; b[m++]=a[j++];
@@ -261,6 +272,17 @@ void rleFrPoly( RLE *R, const double *xy, siz k, siz h, siz w ) {
   delete[] b;//free(a); free(b);
 }
 
+void polyFill( const double *xy, siz k, siz h, siz w, float *mask ) {
+  /* the pixels of rleFrPoly, runs between pairs of toggles are set without building the rle */
+  siz j, n; uint *a, p, e;
+  n=polyToggles(xy,k,h,w,&a);
+  for( j=0; j+1<n; j+=2 ) {
+    e=a[j+1]; if(e>h*w) e=h*w;
+    for( p=a[j]; p<e; p++ ) mask[(p%h)*w+p/h]=1;
+  }
+  delete[] a;
+}
+
 char* rleToString( const RLE *R ) {
   /* Similar to LEB128 but using 6 bits/char and ascii chars 48-111. */
   siz i, m=R->m, p=0; long x; int more;
@@ -30,6 +30,11 @@ void SetCFGFromFile(const std::string file_path){
   SetNode((*cfg)["INPUT"]["PIXEL_STD"], "(1., 1., 1.)");
   SetNode((*cfg)["INPUT"]["TO_BGR255"], true);
   SetNode((*cfg)["INPUT"]["VERTICAL_FLIP_PROB_TRAIN"], 0.0);
+  //one pass resize, flip and normalize instead of the transform chain
+  SetNode((*cfg)["INPUT"]["FUSED_TRANSFORMS"], true);
+  //decode jpegs at 1/2, 1/4 or 1/8 scale when the resize shrinks them that much anyway.
+  //faster, but the dct downscale gives slightly different pixels than a full decode and resize
+  SetNode((*cfg)["INPUT"]["REDUCED_DECODE"], false);
 
   SetNode((*cfg)["INPUT"]["RIGHTNESS"], 0.0);
   SetNode((*cfg)["INPUT"]["CONTRAST"], 0.0);
@@ -40,11 +45,27 @@ void SetCFGFromFile(const std::string file_path){
   SetNode((*cfg)["DATASETS"], YAML::Node());
   SetNode((*cfg)["DATASETS"]["TRAIN"], "(COCO, )");
   SetNode((*cfg)["DATASETS"]["TEST"], "(COCO, )");
+  //sampling weights of the TRAIN datasets, one per dataset, empty samples them uniformly
+  SetNode((*cfg)["DATASETS"]["TRAIN_WEIGHTS"], "()");
   //DATALOADER
   SetNode((*cfg)["DATALOADER"], YAML::Node());
   SetNode((*cfg)["DATALOADER"]["NUM_WORKERS"], 4);
   SetNode((*cfg)["DATALOADER"]["SIZE_DIVISIBILITY"], 0);
   SetNode((*cfg)["DATALOADER"]["ASPECT_RATIO_GROUPING"], true);
+  //group boundaries on height / width, used when SIZE_BUCKET_STEP is 0
+  SetNode((*cfg)["DATALOADER"]["ASPECT_RATIO_BINS"], "(1.0, )");
+  //group by resized height and width rounded up to this step instead, 0 disables it
+  SetNode((*cfg)["DATALOADER"]["SIZE_BUCKET_STEP"], 0);
+  //decoded image cache shared by the loader workers, 0 disables it
+  SetNode((*cfg)["DATALOADER"]["IMAGE_CACHE_BYTES"], 0);
+  SetNode((*cfg)["DATALOADER"]["IMAGE_CACHE_SHARDS"], 16);
+  //cache the encoded file bytes instead, decoding on every access
+  SetNode((*cfg)["DATALOADER"]["IMAGE_CACHE_ENCODED"], false);
+  //idle batch buffers kept for reuse by the collator, 0 disables the pool.
+  //buffers are reused by exact batch shape, so enable it together with SIZE_BUCKET_STEP
+  SetNode((*cfg)["DATALOADER"]["BATCH_POOL_BYTES"], 0);
+  //batches kept ready on device by the prefetch thread
+  SetNode((*cfg)["DATALOADER"]["PREFETCH_DEPTH"], 2);
   
   //BACKBONE
   SetNode((*cfg)["MODEL"]["BACKBONE"], YAML::Node());
@@ -122,6 +143,8 @@ void SetCFGFromFile(const std::string file_path){
   SetNode((*cfg)["MODEL"]["ROI_MASK_HEAD"]["MLP_HEAD_DIM"], 1024);
   SetNode((*cfg)["MODEL"]["ROI_MASK_HEAD"]["CONV_LAYERS"], "(256, 256, 256, 256)");
   SetNode((*cfg)["MODEL"]["ROI_MASK_HEAD"]["RESOLUTION"], 14);
+  //rasterize the mask targets at this resolution in the data loader workers, 0 rasterizes per proposal in the loss
+  SetNode((*cfg)["MODEL"]["ROI_MASK_HEAD"]["TARGET_RASTER_RESOLUTION"], 0);
   SetNode((*cfg)["MODEL"]["ROI_MASK_HEAD"]["SHARE_BOX_FEATURE_EXTRACTOR"], true);
   SetNode((*cfg)["MODEL"]["ROI_MASK_HEAD"]["POSTPROCESS_MASKS"], false);
   SetNode((*cfg)["MODEL"]["ROI_MASK_HEAD"]["POSTPROCESS_MASKS_THRESHOLD"], 0.5);
@@ -171,6 +194,12 @@ void SetCFGFromFile(const std::string file_path){
   SetNode((*cfg)["TEST"]["EXPECTED_RESULTS_SIGMA_TOL"], 4);
   SetNode((*cfg)["TEST"]["IMS_PER_BATCH"], 8);
   SetNode((*cfg)["TEST"]["DETECTIONS_PER_IMG"], 100);
+  //bbox results are written as binary records instead of json
+  SetNode((*cfg)["TEST"]["BINARY_RESULTS"], false);
+  //predictions are matched while inference runs instead of being kept until the end
+  SetNode((*cfg)["TEST"]["ONLINE_EVALUATION"], false);
+  //images between running AP reports of the online evaluation, 0 reports only at the end
+  SetNode((*cfg)["TEST"]["ONLINE_EVALUATION_PERIOD"], 0);
 
   SetNode((*cfg)["TEST"]["BBOX_AUG"], YAML::Node());
   SetNode((*cfg)["TEST"]["BBOX_AUG"]["ENABLED"], false);
@@ -228,7 +257,7 @@ std::vector<float> GetCFG<std::vector<float>>(std::initializer_list<const char*>
     elements.push_back(std::stof(token));
     svalue.erase(0, pos + 1);
   }
-  if(svalue.size() > 1){
+  if(!svalue.empty()){
     elements.push_back(std::stof(svalue));
   }
   return elements;
@@ -258,7 +287,7 @@ std::vector<int64_t> GetCFG<std::vector<int64_t>>(std::initializer_list<const ch
     elements.push_back(std::stoi(token));
     svalue.erase(0, pos + 1);
   }
-  if(svalue.size() > 1){
+  if(!svalue.empty()){
     elements.push_back(std::stoi(svalue));
   }
   return elements;
@@ -292,7 +321,7 @@ std::vector<std::string> GetCFG<std::vector<std::string>>(std::initializer_list<
       splitted.push_back(token);
       svalue.erase(0, pos + 1);
     }
-    if(svalue.size() > 1){
+    if(!svalue.empty()){
       splitted.push_back(svalue);
     }
   }
@@ -17,10 +17,18 @@ const std::map<std::string, args> DatasetCatalog::DATASETS{
   {"coco_2014_val",
     args{{"img_dir", "coco/val2014"}, {"ann_file", "coco/annotations/instances_val2014.json"}}},
   {"coco_2014_minival",
-    args{{"img_dir", "coco/val2014"}, {"ann_file", "coco/annotations/instances_valminusminival2014.json"}}}
+    args{{"img_dir", "coco/val2014"}, {"ann_file", "coco/annotations/instances_valminusminival2014.json"}}},
+  //packed by coco_to_shards
+  {"coco_2017_train_shards",
+    args{{"shard_dir", "coco/train2017_shards"}}},
+  {"coco_2017_val_shards",
+    args{{"shard_dir", "coco/val2017_shards"}}}
 };
 
 std::tuple<std::string, std::string, std::string> DatasetCatalog::operator[](std::string name){
+  if(name.find("coco") != std::string::npos && DatasetCatalog::DATASETS.at(name).count("shard_dir")){
+    return std::make_tuple("COCOShardDataset", DATA_DIR + "/" + DatasetCatalog::DATASETS.at(name).at("shard_dir"), std::string());
+  }
   if(name.find("coco") != std::string::npos){
     return std::make_tuple("COCODataset", DATA_DIR + "/" + DatasetCatalog::DATASETS.at(name).at("img_dir"), DATA_DIR + "/" + DatasetCatalog::DATASETS.at(name).at("ann_file"));
   }
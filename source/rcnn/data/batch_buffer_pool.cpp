@@ -0,0 +1,96 @@
+#include "batch_buffer_pool.h"
+#include <iostream>
+
+
+namespace rcnn{
+namespace data{
+
+namespace{
+
+int64_t ShapeBytes(const std::vector<int64_t>& shape){
+  int64_t numel = 1;
+  for(auto& size : shape)
+    numel *= size;
+  return numel * static_cast<int64_t>(sizeof(float));
+}
+
+}//namespace
+
+BatchBufferPool::State::~State(){
+  for(auto& bucket : idle){
+    for(auto& buffer : bucket.second)
+      delete[] buffer;
+  }
+}
+
+void BatchBufferPool::State::Release(const std::vector<int64_t>& shape, float* buffer){
+  int64_t bytes = ShapeBytes(shape);
+  std::lock_guard<std::mutex> lock(mutex);
+  bytes_in_use -= bytes;
+  if(bytes_held + bytes > max_bytes){
+    delete[] buffer;
+    return;
+  }
+  idle[shape].push_back(buffer);
+  bytes_held += bytes;
+}
+
+BatchBufferPool::BatchBufferPool(int64_t max_bytes) :state_(std::make_shared<State>(max_bytes)){}
+
+torch::Tensor BatchBufferPool::Get(std::vector<int64_t> shape){
+  int64_t bytes = ShapeBytes(shape);
+  float* buffer = nullptr;
+  {
+    std::lock_guard<std::mutex> lock(state_->mutex);
+    auto bucket = state_->idle.find(shape);
+    if(bucket != state_->idle.end() && !bucket->second.empty()){
+      buffer = bucket->second.back();
+      bucket->second.pop_back();
+      state_->bytes_held -= bytes;
+      state_->hits++;
+    }
+    else{
+      state_->misses++;
+    }
+    state_->bytes_in_use += bytes;
+  }
+  if(!buffer)
+    buffer = new float[bytes / sizeof(float)];
+
+  std::shared_ptr<State> state = state_;
+  return torch::from_blob(buffer, shape, [state, shape](void* data){
+    state->Release(shape, static_cast<float*>(data));
+  }, torch::kF32);
+}
+
+int64_t BatchBufferPool::hits() const{
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->hits;
+}
+
+int64_t BatchBufferPool::misses() const{
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->misses;
+}
+
+int64_t BatchBufferPool::bytes_held() const{
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->bytes_held;
+}
+
+int64_t BatchBufferPool::bytes_in_use() const{
+  std::lock_guard<std::mutex> lock(state_->mutex);
+  return state_->bytes_in_use;
+}
+
+std::ostream& operator << (std::ostream& os, const BatchBufferPool& pool){
+  os << "BatchBufferPool(";
+  os << "hits=" << pool.hits() << ", ";
+  os << "misses=" << pool.misses() << ", ";
+  os << "bytes_held=" << pool.bytes_held() << ", ";
+  os << "bytes_in_use=" << pool.bytes_in_use() << ")";
+  return os;
+}
+
+}//data
+}//rcnn
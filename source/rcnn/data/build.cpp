@@ -3,6 +3,7 @@
 #include "tovec.h"
 
 #include <cassert>
+#include <cstdlib>
 #include <type_traits>
 #include <iostream>
 
@@ -23,20 +24,97 @@
 namespace rcnn{
 namespace data{
 
-//supports only coco dataset
-//TODO Concat dataset
-COCODataset BuildDataset(std::vector<std::string> dataset_list, bool is_train){
-  assert(dataset_list.size() == 1);
+namespace{
+
+//config of a dataset, read once so members can be opened on other threads
+struct DatasetOptions{
+  int decode_min_size;//0 decodes at full resolution
+  int decode_max_size;
+  int64_t image_cache_bytes;
+  int image_cache_shards;
+  bool image_cache_encoded;
+};
+
+DatasetOptions ReadOptions(bool is_train){
+  DatasetOptions options{0, 0, 0, 0, false};
+  if(rcnn::config::GetCFG<bool>({"INPUT", "REDUCED_DECODE"})){
+    if(is_train){
+      options.decode_min_size = rcnn::config::GetCFG<int>({"INPUT", "MIN_SIZE_TRAIN"});
+      options.decode_max_size = rcnn::config::GetCFG<int>({"INPUT", "MAX_SIZE_TRAIN"});
+    }
+    else{
+      options.decode_min_size = rcnn::config::GetCFG<int>({"INPUT", "MIN_SIZE_TEST"});
+      options.decode_max_size = rcnn::config::GetCFG<int>({"INPUT", "MAX_SIZE_TEST"});
+    }
+  }
+  options.image_cache_bytes = rcnn::config::GetCFG<int64_t>({"DATALOADER", "IMAGE_CACHE_BYTES"});
+  options.image_cache_shards = rcnn::config::GetCFG<int>({"DATALOADER", "IMAGE_CACHE_SHARDS"});
+  options.image_cache_encoded = rcnn::config::GetCFG<bool>({"DATALOADER", "IMAGE_CACHE_ENCODED"});
+  return options;
+}
+
+COCODataset OpenDataset(const std::string& name, bool is_train, const DatasetOptions& options){
   rcnn::config::DatasetCatalog dataset_catalog = rcnn::config::DatasetCatalog();
   std::string dataset_name, img_dir, ann_file;
-  std::tie(dataset_name, img_dir, ann_file) = dataset_catalog[dataset_list[0]];
-
-  if(dataset_name.compare("COCODataset") == 0)
-    return COCODataset(ann_file, img_dir, is_train);
+  std::tie(dataset_name, img_dir, ann_file) = dataset_catalog[name];
+
+  if(dataset_name.compare("COCODataset") == 0 || dataset_name.compare("COCOShardDataset") == 0){
+    //shards keep the images and the annotations together in img_dir
+    COCODataset dataset = dataset_name.compare("COCOShardDataset") == 0 ? COCODataset(std::make_shared<ShardSet>(img_dir), is_train) : COCODataset(ann_file, img_dir, is_train);
+    if(options.decode_min_size > 0)
+      dataset.coco_detection.SetDecodeSize(options.decode_min_size, options.decode_max_size);
+    if(options.image_cache_bytes > 0){
+      auto image_cache = std::make_shared<ImageCache>(options.image_cache_bytes, options.image_cache_shards);
+      dataset.coco_detection.SetImageCache(image_cache, options.image_cache_encoded);
+    }
+    return dataset;
+  }
   else
     assert(false);
 }
 
+}//namespace
+
+//supports only coco dataset
+COCODataset BuildDataset(std::vector<std::string> dataset_list, bool is_train){
+  assert(dataset_list.size() == 1);
+  return OpenDataset(dataset_list[0], is_train, ReadOptions(is_train));
+}
+
+ConcatDataset BuildConcatDataset(std::vector<std::string> dataset_list, bool is_train){
+  assert(!dataset_list.empty());
+  DatasetOptions options = ReadOptions(is_train);
+  //members split the image cache budget
+  options.image_cache_bytes /= static_cast<int64_t>(dataset_list.size());
+  std::vector<ConcatDataset::Opener> openers;
+  for(auto& name : dataset_list){
+    openers.push_back([name, is_train, options]{
+      return OpenDataset(name, is_train, options);
+    });
+  }
+  std::vector<float> weights;
+  if(is_train)
+    weights = rcnn::config::GetCFG<std::vector<float>>({"DATASETS", "TRAIN_WEIGHTS"});
+  if(!weights.empty() && weights.size() != dataset_list.size()){
+    std::cout << "DATASETS.TRAIN_WEIGHTS needs " << dataset_list.size() << " weights, one per dataset in DATASETS.TRAIN, but has " << weights.size() << "\n";
+    std::abort();
+  }
+  //discrete_distribution is undefined for negative weights or a zero sum
+  float sum = 0;
+  for(auto& weight : weights){
+    if(!(weight >= 0)){
+      std::cout << "DATASETS.TRAIN_WEIGHTS must not be negative, but has " << weight << "\n";
+      std::abort();
+    }
+    sum += weight;
+  }
+  if(!weights.empty() && !(sum > 0)){
+    std::cout << "DATASETS.TRAIN_WEIGHTS needs at least one positive weight\n";
+    std::abort();
+  }
+  return ConcatDataset(dataset_list, openers, weights);
+}
+
 // template<>
 // torch::data::StatelessDataLoader<COCODataset, IterationBasedBatchSampler> MakeDataLoader(bool is_train /*, is_distributed=false */, int start_iter){
 
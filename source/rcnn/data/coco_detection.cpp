@@ -1,4 +1,11 @@
 #include "coco_detection.h"
+#include "transforms/transforms.h"
+#include <cassert>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+#include <iterator>
+#include <utility>
 
 
 namespace rcnn{
@@ -6,33 +13,161 @@ namespace data{
 
 COCODetection::COCODetection(std::string root, std::string annFile)
                             :root_(root),
-                             coco_(coco::COCO(annFile))
+                             coco_(coco::COCO(annFile)),
+                             image_cache_encoded_(false),
+                             decode_min_size_(0),
+                             decode_max_size_(0),
+                             full_size_ids_(std::make_shared<FullSizeIds>())
 {
-  ids_.reserve(coco_.imgs.size());
-  for(auto& img : coco_.imgs)
-    ids_.push_back(img.first);  
+  SetIds(coco_.GetImgIds());
 }
 
-torch::data::Example<cv::Mat, std::vector<coco::Annotation>> COCODetection::get(size_t index){
-  int img_id = ids_.at(index);
-  std::vector<int64_t> ann_ids = coco_.GetAnnIds(std::vector<int>{img_id});
-  std::vector<coco::Annotation> target = coco_.LoadAnns(ann_ids);
-  std::string path(coco_.LoadImgs(std::vector<int>{img_id})[0].file_name);
-  cv::Mat img = cv::imread(root_ + "/" + path, cv::IMREAD_COLOR);
-  
+COCODetection::COCODetection(std::shared_ptr<ShardSet> shards)
+                            :root_(shards->directory()),
+                             image_cache_encoded_(false),
+                             decode_min_size_(0),
+                             decode_max_size_(0),
+                             shards_(shards),
+                             full_size_ids_(std::make_shared<FullSizeIds>())
+{
+  shards_->LoadTargets(coco_);
+  SetIds(coco_.GetImgIds());
+}
+
+//target views the annotation table of coco_, valid while this dataset is alive
+torch::data::Example<cv::Mat, DetectionTarget> COCODetection::get(size_t index){
+  int img_id = ids_->at(index);
+  const coco::ImageRecord* img_info = coco_.FindImage(img_id);
+  assert(img_info);
+  std::string path = root_ + "/" + coco_.String(img_info->file_name);
+  int reduction = DecodeReduction(*img_info);
+  cv::Mat img = LoadImage(img_id, path, reduction);
 
-  torch::data::Example<cv::Mat, std::vector<coco::Annotation>> value{img, target};
+  DetectionTarget target{coco_.ImageAnnotations(img_id), img.cols, img.rows};
+  if(reduction > 1){
+    //libjpeg rounds the reduced size up, other decoders down
+    if(std::abs(img.cols - img_info->width / reduction) <= 1 && std::abs(img.rows - img_info->height / reduction) <= 1){
+      target.width = img_info->width;
+      target.height = img_info->height;
+    }
+    else{
+      //metadata does not match the file, annotations refer to the real size.
+      //the id is decoded at full resolution from now on, so the cached image below stays valid
+      std::cout << "size of " << path << " does not match its annotation, decoding at full resolution\n";
+      {
+        std::lock_guard<std::mutex> lock(full_size_ids_->mutex);
+        full_size_ids_->ids.insert(img_id);
+      }
+      img = ReadImage(img_id, path, cv::IMREAD_COLOR);
+      if(image_cache_ && !image_cache_encoded_)
+        image_cache_->Put(img_id, img);
+      target.width = img.cols;
+      target.height = img.rows;
+    }
+  }
+
+  torch::data::Example<cv::Mat, DetectionTarget> value{img, target};
   return value;
 }
 
+void COCODetection::SetDecodeSize(int min_size, int max_size){
+  decode_min_size_ = min_size;
+  decode_max_size_ = max_size;
+}
+
+int COCODetection::DecodeReduction(const coco::ImageRecord& info) const{
+  if(decode_min_size_ <= 0 || info.width <= 0 || info.height <= 0)
+    return 1;
+  {
+    std::lock_guard<std::mutex> lock(full_size_ids_->mutex);
+    if(full_size_ids_->ids.count(info.id))
+      return 1;
+  }
+  int h, w;
+  std::tie(h, w) = Resize(decode_min_size_, decode_max_size_).get_size(std::make_pair(info.width, info.height));
+  //largest reduction that still leaves Resize shrinking the image
+  for(int reduction : {8, 4, 2}){
+    if(info.width / reduction >= w && info.height / reduction >= h)
+      return reduction;
+  }
+  return 1;
+}
+
+void COCODetection::SetImageCache(std::shared_ptr<ImageCache> image_cache, bool encoded){
+  image_cache_ = image_cache;
+  image_cache_encoded_ = encoded;
+}
+
+cv::Mat COCODetection::LoadImage(int img_id, const std::string& path, int reduction){
+  int flags = cv::IMREAD_COLOR;
+  if(reduction == 2)
+    flags = cv::IMREAD_REDUCED_COLOR_2;
+  else if(reduction == 4)
+    flags = cv::IMREAD_REDUCED_COLOR_4;
+  else if(reduction == 8)
+    flags = cv::IMREAD_REDUCED_COLOR_8;
+
+  if(!image_cache_)
+    return ReadImage(img_id, path, flags);
+
+  cv::Mat img;
+  if(image_cache_encoded_){
+    cv::Mat encoded;
+    if(!image_cache_->Get(img_id, encoded)){
+      encoded = cv::Mat(ReadBytes(img_id, path), true);
+      image_cache_->Put(img_id, encoded);
+    }
+    return cv::imdecode(encoded, flags);
+  }
+  //cached images already have the reduction of their id, a size mismatch replaces both at once
+  if(!image_cache_->Get(img_id, img)){
+    img = ReadImage(img_id, path, flags);
+    image_cache_->Put(img_id, img);
+  }
+  return img;
+}
+
+cv::Mat COCODetection::ReadImage(int img_id, const std::string& path, int flags){
+  if(shards_)
+    return cv::imdecode(ReadBytes(img_id, path), flags);
+  return cv::imread(path, flags);
+}
+
+std::vector<uchar> COCODetection::ReadBytes(int img_id, const std::string& path){
+  std::vector<uchar> bytes;
+  if(shards_){
+    //empty bytes would decode to an empty image deep inside the transforms
+    if(!shards_->Read(img_id, bytes)){
+      std::cout << "could not read image " << img_id << " from " << shards_->directory() << "\n";
+      std::abort();
+    }
+    return bytes;
+  }
+  std::ifstream ifs(path, std::ios::binary);
+  bytes.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+  return bytes;
+}
+
 torch::optional<size_t> COCODetection::size() const{
-  return ids_.size();
+  return ids_->size();
+}
+
+const std::vector<int>& COCODetection::ids() const{
+  return *ids_;
+}
+
+void COCODetection::SetIds(std::vector<int> ids){
+  ids_ = std::make_shared<const std::vector<int>>(std::move(ids));
 }
 
 std::ostream& operator << (std::ostream& os, const COCODetection& bml){
   os << "Dataset COCODetection\n";
   os << "   Number of datapoints: " << bml.size().value() << "\n";
   os << "   Root Location: " << bml.root_ << "\n";
+  if(bml.shards_)
+    os << "   " << *bml.shards_ << "\n";
+  if(bml.image_cache_)
+    os << "   " << *bml.image_cache_ << "\n";
   return os;
 }
 
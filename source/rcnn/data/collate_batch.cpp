@@ -1,4 +1,6 @@
 #include "collate_batch.h"
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 
 #include "opencv2/imgproc/imgproc.hpp"
@@ -8,30 +10,141 @@
 namespace rcnn{
 namespace data{
 
-BatchCollator::BatchCollator(int size_divisible) :size_divisible_(size_divisible){}
+PaddingStats::PaddingStats() :image_pixels_(0), batch_pixels_(0), batches_(0){}
 
-batch BatchCollator::apply_batch(std::vector<torch::data::Example<torch::Tensor, RCNNData>> examples)
+void PaddingStats::Add(int64_t image_pixels, int64_t batch_pixels){
+  image_pixels_ += image_pixels;
+  batch_pixels_ += batch_pixels;
+  batches_++;
+}
+
+double PaddingStats::padded_fraction() const{
+  int64_t batch_pixels = batch_pixels_;
+  return batch_pixels > 0 ? 1. - static_cast<double>(image_pixels_) / batch_pixels : 0.;
+}
+
+int64_t PaddingStats::batches() const{
+  return batches_;
+}
+
+void PaddingStats::Reset(){
+  image_pixels_ = 0;
+  batch_pixels_ = 0;
+  batches_ = 0;
+}
+
+std::ostream& operator << (std::ostream& os, const PaddingStats& stats){
+  os << "PaddingStats(batches=" << stats.batches() << ", padded_fraction=" << stats.padded_fraction() << ")";
+  return os;
+}
+
+namespace{
+
+void AddMaskRasters(std::vector<rcnn::structures::BoxList>& boxes, int resolution){
+  for(auto& target : boxes){
+    rcnn::structures::SegmentationMask* masks = target.GetMasksField("masks");
+    if(masks)
+      target.AddField("mask_rasters", masks->ProjectOnBoxes(target.Convert("xyxy").get_bbox(), resolution));
+  }
+}
+
+}//namespace
+
+BatchCollator::BatchCollator(Compose transforms, int size_divisible, std::shared_ptr<BatchBufferPool> pool, int mask_raster_resolution)
+                            :transforms_(transforms),
+                             size_divisible_(size_divisible),
+                             pool_(pool),
+                             mask_raster_resolution_(mask_raster_resolution),
+                             padding_(std::make_shared<PaddingStats>()){}
+
+batch BatchCollator::apply_batch(std::vector<torch::data::Example<cv::Mat, RCNNData>> examples)
 {
-  std::vector<torch::Tensor> tensors;
   std::vector<rcnn::structures::BoxList> boxes;
   std::vector<int64_t> ids;
-  tensors.reserve(examples.size());
   boxes.reserve(examples.size());
   ids.reserve(examples.size());
+
+  std::shared_ptr<ResizeFlipNormalize> fused = transforms_.fused();
+  if(!fused){
+    std::vector<torch::Tensor> tensors;
+    tensors.reserve(examples.size());
+    for(auto& example : examples){
+      auto transformed = transforms_(example);
+      tensors.push_back(transformed.data);
+      boxes.push_back(transformed.target.target);
+      ids.push_back(transformed.target.idx);
+    }
+    if(mask_raster_resolution_ > 0)
+      AddMaskRasters(boxes, mask_raster_resolution_);
+    std::vector<std::pair<int64_t, int64_t>> image_sizes;
+    int64_t max_height = 0, max_width = 0, image_pixels = 0;
+    for(auto& tensor : tensors){
+      image_sizes.push_back(std::make_pair(tensor.size(2), tensor.size(3)));
+      max_height = std::max(max_height, tensor.size(2));
+      max_width = std::max(max_width, tensor.size(3));
+      image_pixels += tensor.size(2) * tensor.size(3);
+    }
+    if(size_divisible_ > 0){
+      int64_t stride = size_divisible_;
+      max_height = static_cast<int64_t>(std::ceil(max_height / static_cast<double>(stride)) * stride);
+      max_width = static_cast<int64_t>(std::ceil(max_width / static_cast<double>(stride)) * stride);
+    }
+    padding_->Add(image_pixels, static_cast<int64_t>(tensors.size()) * max_height * max_width);
+    if(!pool_){
+      rcnn::structures::ImageList image_list = rcnn::structures::ToImageList(tensors, size_divisible_);
+      return std::make_tuple(image_list, boxes, ids);
+    }
+    torch::Tensor batched_imgs = pool_->Get({static_cast<int64_t>(tensors.size()), 3, max_height, max_width});
+    batched_imgs.zero_();
+    for(size_t i = 0; i < tensors.size(); ++i)
+      batched_imgs[i].narrow(1, 0, tensors[i].size(2)).narrow(2, 0, tensors[i].size(3)).copy_(tensors[i][0]);
+    return std::make_tuple(rcnn::structures::ImageList(batched_imgs, image_sizes), boxes, ids);
+  }
+
+  //resize first, the padded shape depends on every image of the batch
+  std::vector<std::pair<bool, bool>> flips;
+  std::vector<std::pair<int64_t, int64_t>> image_sizes;
+  flips.reserve(examples.size());
+  image_sizes.reserve(examples.size());
+  int64_t max_height = 0, max_width = 0, image_pixels = 0;
   for(auto& example : examples){
-    // cv::Mat warp = cv::Mat(example.data.size(2), example.data.size(3), CV_32FC3, example.data.permute({0, 2, 3, 1}).contiguous().data<float>());
-    // cv::imwrite("../resource/tmp/collate" + std::to_string(example.target.idx) + ".jpg", warp);
-    tensors.push_back(example.data);
+    flips.push_back(fused->Prepare(example));
+    image_sizes.push_back(std::make_pair(static_cast<int64_t>(example.data.rows), static_cast<int64_t>(example.data.cols)));
+    image_pixels += static_cast<int64_t>(example.data.rows) * example.data.cols;
+    max_height = std::max(max_height, static_cast<int64_t>(example.data.rows));
+    max_width = std::max(max_width, static_cast<int64_t>(example.data.cols));
     boxes.push_back(example.target.target);
     ids.push_back(example.target.idx);
   }
-  rcnn::structures::ImageList image_list = rcnn::structures::ToImageList(tensors, size_divisible_);
-  // for(int i = 0; i < tensors.size(); ++i){
-  //   cv::Mat warpt = cv::Mat(image_list.get_tensors()[i].size(1), image_list.get_tensors()[i].size(2), CV_32FC3, image_list.get_tensors()[i].permute({1, 2, 0}).contiguous().data<float>());
-  //   cv::imwrite("../resource/tmp/divisible" + std::to_string(i) + ".jpg", warpt);
-  // }
-  return std::make_tuple(image_list, boxes, ids);
+  if(mask_raster_resolution_ > 0)
+    AddMaskRasters(boxes, mask_raster_resolution_);
+  if(size_divisible_ > 0){
+    int64_t stride = size_divisible_;
+    max_height = static_cast<int64_t>(std::ceil(max_height / static_cast<double>(stride)) * stride);
+    max_width = static_cast<int64_t>(std::ceil(max_width / static_cast<double>(stride)) * stride);
+  }
+
+  padding_->Add(image_pixels, static_cast<int64_t>(examples.size()) * max_height * max_width);
+
+  std::vector<int64_t> shape{static_cast<int64_t>(examples.size()), 3, max_height, max_width};
+  torch::Tensor batched_imgs = pool_ ? pool_->Get(shape) : torch::empty(shape, torch::kF32);
+  float* data = batched_imgs.data<float>();
+  int64_t plane = max_height * max_width;
+  for(size_t i = 0; i < examples.size(); ++i){
+    float* slot = data + i * 3 * plane;
+    fused->WritePlanes(examples[i].data, flips[i].first, flips[i].second, slot, max_width, plane);
+    int64_t h = image_sizes[i].first, w = image_sizes[i].second;
+    for(int c = 0; c < 3; ++c){
+      float* channel = slot + c * plane;
+      if(w < max_width){
+        for(int64_t y = 0; y < h; ++y)
+          std::fill(channel + y * max_width + w, channel + (y + 1) * max_width, 0.f);
+      }
+      std::fill(channel + h * max_width, channel + plane, 0.f);
+    }
+  }
+  return std::make_tuple(rcnn::structures::ImageList(batched_imgs, image_sizes), boxes, ids);
 }
 
 }
-}
\ No newline at end of file
+}
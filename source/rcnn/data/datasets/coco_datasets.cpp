@@ -1,6 +1,8 @@
 #include "datasets/coco_datasets.h"
+#include "datasets/dataset_stats.h"
 #include <algorithm>
 #include <iostream>
+#include <utility>
 
 #include <bounding_box.h>
 #include <segmentation_mask.h>
@@ -27,6 +29,24 @@ bool has_valid_annotation(std::vector<coco::Annotation> anno){
   return true;
 }
 
+bool _has_only_empty_bbox(const coco::AnnotationRange& anno){
+  for(auto& i : anno){
+    if(i.bbox[2] > 1 && i.bbox[3] > 1)
+      return false;
+  }
+  return true;
+}
+
+bool has_valid_annotation(const coco::AnnotationRange& anno){
+  if(anno.empty())
+    return false;
+
+  if(_has_only_empty_bbox(anno))
+    return false;
+
+  return true;
+}
+
 // template<typename Self>
 // torch::optional<size_t> RCNNDataset<Self>::size() const{
 //   assert(false);
@@ -40,77 +60,107 @@ bool has_valid_annotation(std::vector<coco::Annotation> anno){
 // }
 
 COCODataset::COCODataset(std::string annFile, std::string root, bool remove_images_without_annotations) :coco_detection(root, annFile){
-  std::sort(coco_detection.ids_.begin(), coco_detection.ids_.end());
-  if(remove_images_without_annotations){
-    std::vector<int> ids;
-    for(auto& i : coco_detection.ids_){
-      auto ann_ids = coco_detection.coco_.GetAnnIds(std::vector<int> {i});
-      std::vector<coco::Annotation> anno = coco_detection.coco_.LoadAnns(ann_ids);
-      if(has_valid_annotation(anno))
-        ids.push_back(i);
-    }
-    coco_detection.ids_ = ids;
+  Init(remove_images_without_annotations, annFile);
+}
+
+COCODataset::COCODataset(std::shared_ptr<ShardSet> shards, bool remove_images_without_annotations) :coco_detection(shards){
+  Init(remove_images_without_annotations, "");
+}
+
+void COCODataset::Init(bool remove_images_without_annotations, const std::string& annotation_file){
+  //ids in id order, sizes and category ids come from the stats sidecar when it is current
+  DatasetStats stats = LoadOrComputeStats(coco_detection.coco_, annotation_file);
+  std::shared_ptr<Index> index = std::make_shared<Index>();
+  std::vector<int> ids;
+  ids.reserve(stats.images.size());
+  index->image_sizes.reserve(stats.images.size());
+  for(auto& img : stats.images){
+    if(remove_images_without_annotations && !img.valid)
+      continue;
+    ids.push_back(img.id);
+    index->image_sizes.push_back(std::make_pair(img.width, img.height));
   }
+  coco_detection.SetIds(std::move(ids));
 
-  for(auto& cat : coco_detection.coco_.cats)
-    categories[cat.second.id] = cat.second.name;
+  for(auto& cat : coco_detection.coco_.categories)
+    index->categories[cat.id] = coco_detection.coco_.String(cat.name);
   
-  std::vector<int> catIds = coco_detection.coco_.GetCatIds();
-  for(int i = 0; i < catIds.size(); ++i)
-    json_category_id_to_contiguous_id[catIds[i]] = i + 1;
+  for(int i = 0; i < stats.category_ids.size(); ++i)
+    index->json_category_id_to_contiguous_id[stats.category_ids[i]] = i + 1;
+
+  for(auto i = index->json_category_id_to_contiguous_id.begin(); i != index->json_category_id_to_contiguous_id.end(); ++i)
+    index->contiguous_category_id_to_json_id[i->second] = i->first;
+  index_ = index;
+}
 
-  for(auto i = json_category_id_to_contiguous_id.begin(); i != json_category_id_to_contiguous_id.end(); ++i)
-    contiguous_category_id_to_json_id[i->second] = i->first;
+const std::map<int64_t, std::string>& COCODataset::categories() const{
+  return index_->categories;
+}
+
+const std::map<int64_t, int64_t>& COCODataset::json_category_id_to_contiguous_id() const{
+  return index_->json_category_id_to_contiguous_id;
+}
 
-  for(int i = 0; i < coco_detection.ids_.size(); ++i)
-    id_to_img_map[i] = coco_detection.ids_[i];
+const std::map<int64_t, int64_t>& COCODataset::contiguous_category_id_to_json_id() const{
+  return index_->contiguous_category_id_to_json_id;
+}
+
+int64_t COCODataset::id_to_img_map(int64_t index) const{
+  return coco_detection.ids().at(index);
+}
+
+std::pair<int, int> COCODataset::image_size(int64_t index) const{
+  return index_->image_sizes.at(index);
 }
 
 torch::data::Example<cv::Mat, RCNNData> COCODataset::get(size_t idx){
   auto coco_data = coco_detection.get(idx);
   cv::Mat img = coco_data.data;
-  std::vector<coco::Annotation> anno = coco_data.target;
-  for(auto ann = anno.begin(); ann != anno.end();){
-    if(ann->iscrowd)
-      anno.erase(ann);
-    else
-      ann++;
-  }
+  RCNNData rcnn_data;
+  rcnn_data.idx = idx;
+  //boxes stay in the coordinates of the full image even when it was decoded smaller
+  rcnn_data.target = BuildTarget(coco_data.target.annotations, std::make_pair(coco_data.target.width, coco_data.target.height));
+  torch::data::Example<cv::Mat, RCNNData> value{img, rcnn_data};
+  return value;
+}
 
-  std::vector<std::vector<float>> boxes;
-  for(auto& obj : anno)
-    boxes.push_back(obj.bbox);
-  torch::Tensor boxes_tensor = torch::zeros({static_cast<int64_t>(boxes.size()) * 4}).to(torch::kF32);
-  int64_t index = 0;
-  for(auto& box : boxes){
-    for(auto& coord : box){
-      boxes_tensor[index] = coord;
-      index++;
+rcnn::structures::BoxList COCODataset::BuildTarget(const coco::AnnotationRange& anno, std::pair<int64_t, int64_t> image_size){
+  //non-crowd objects are gathered into flat buffers, boxes and labels become tensors with one copy
+  //and the polygon buffers move into the mask
+  const coco::COCO& coco_api = coco_detection.coco_;
+  std::vector<float> boxes, classes, coords;
+  std::vector<int64_t> ring_offsets{0}, instance_rings{0};
+  boxes.reserve(anno.size() * 4);
+  classes.reserve(anno.size());
+  instance_rings.reserve(anno.size() + 1);
+  for(auto& obj : anno){
+    if(obj.iscrowd)
+      continue;
+    boxes.insert(boxes.end(), obj.bbox, obj.bbox + 4);
+    auto category = index_->json_category_id_to_contiguous_id.find(obj.category_id);
+    classes.push_back(category != index_->json_category_id_to_contiguous_id.end() ? category->second : 0);
+    if(obj.segm_type == coco::SEGM_POLYGON){
+      for(uint32_t r = obj.segm_begin; r < obj.segm_end; ++r)
+        ring_offsets.push_back(ring_offsets.back() + coco_api.rings[r + 1] - coco_api.rings[r]);
+      coords.insert(coords.end(), coco_api.coords.data() + coco_api.rings[obj.segm_begin], coco_api.coords.data() + coco_api.rings[obj.segm_end]);
     }
+    instance_rings.push_back(ring_offsets.size() - 1);
   }
 
-  boxes_tensor = boxes_tensor.reshape({-1, 4});
-  rcnn::structures::BoxList target{boxes_tensor, std::make_pair(static_cast<int64_t>(img.cols), static_cast<int64_t>(img.rows)), "xywh"};
+  int64_t num_objs = static_cast<int64_t>(classes.size());
+  torch::Tensor boxes_tensor = torch::empty({num_objs, 4}, torch::kF32);
+  torch::Tensor classes_tensor = torch::empty({num_objs}, torch::kF32);
+  std::copy(boxes.begin(), boxes.end(), boxes_tensor.data<float>());
+  std::copy(classes.begin(), classes.end(), classes_tensor.data<float>());
+
+  rcnn::structures::BoxList target{boxes_tensor, image_size, "xywh"};
   target = target.Convert("xyxy");
-  
-  torch::Tensor classes = torch::zeros({static_cast<int64_t>(anno.size())}).to(torch::kF32);
-  for(int i = 0; i < anno.size(); ++i){
-    classes[i] = json_category_id_to_contiguous_id[anno[i].category_id];
-  }
-  
-  target.AddField("labels", classes);
-  std::vector<std::vector<std::vector<double>>> polys;
-  for(auto& obj : anno)
-    polys.push_back(obj.segmentation);
-  auto mask = new rcnn::structures::SegmentationMask(polys, std::make_pair(static_cast<int64_t>(img.cols), static_cast<int64_t>(img.rows)), "poly");
+  target.AddField("labels", classes_tensor);
+
+  auto mask = new rcnn::structures::SegmentationMask(std::move(coords), std::move(ring_offsets), std::move(instance_rings), image_size, "poly");
   target.AddField("masks", mask);
 
-  target = target.ClipToImage(true);
-  RCNNData rcnn_data;
-  rcnn_data.idx = idx;
-  rcnn_data.target = target;
-  torch::data::Example<cv::Mat, RCNNData> value{img, rcnn_data};
-  return value;
+  return target.ClipToImage(true);
 }
 
 torch::optional<size_t>  COCODataset::size() const{
@@ -118,8 +168,8 @@ torch::optional<size_t>  COCODataset::size() const{
 }
 
 coco::Image COCODataset::get_img_info(int64_t index){
-  auto img_id = id_to_img_map[index];
-  return coco_detection.coco_.imgs[img_id];
+  auto img_id = id_to_img_map(index);
+  return coco_detection.coco_.LoadImgs(std::vector<int>{static_cast<int>(img_id)})[0];
 }
 
 }//data
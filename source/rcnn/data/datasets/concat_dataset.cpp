@@ -0,0 +1,87 @@
+#include "datasets/concat_dataset.h"
+#include <cassert>
+#include <iostream>
+#include <tuple>
+
+
+namespace rcnn{
+namespace data{
+
+ConcatDataset::ConcatDataset(std::vector<std::string> names, std::vector<Opener> openers, std::vector<float> weights) :weights_(weights){
+  assert(names.size() == openers.size());
+  assert(weights.empty() || weights.size() == names.size());
+  for(size_t m = 0; m < names.size(); ++m){
+    std::shared_ptr<Member> member = std::make_shared<Member>();
+    member->name = names[m];
+    member->opener = openers[m];
+    member->opened = false;
+    members_.push_back(member);
+  }
+}
+
+torch::data::Example<cv::Mat, RCNNData> ConcatDataset::get(size_t index){
+  size_t m, local;
+  std::tie(m, local) = Decode(index);
+  torch::data::Example<cv::Mat, RCNNData> value = member(m).get(local);
+  value.target.idx = index;
+  return value;
+}
+
+torch::optional<size_t> ConcatDataset::size() const{
+  size_t size = 0;
+  for(size_t m = 0; m < members_.size(); ++m)
+    size += member(m).size().value();
+  return size;
+}
+
+size_t ConcatDataset::num_members() const{
+  return members_.size();
+}
+
+COCODataset& ConcatDataset::member(size_t m) const{
+  Member& member = *members_.at(m);
+  std::call_once(member.once, [&member]{
+    std::cout << "opening dataset " << member.name << "\n";
+    member.dataset.reset(new COCODataset(member.opener()));
+    assert(member.dataset->size().value() < (static_cast<size_t>(1) << MEMBER_SHIFT));
+    member.opened = true;
+  });
+  return *member.dataset;
+}
+
+bool ConcatDataset::opened(size_t m) const{
+  return members_.at(m)->opened;
+}
+
+const std::string& ConcatDataset::name(size_t m) const{
+  return members_.at(m)->name;
+}
+
+const std::vector<float>& ConcatDataset::weights() const{
+  return weights_;
+}
+
+size_t ConcatDataset::Encode(size_t member, size_t local){
+  return member << MEMBER_SHIFT | local;
+}
+
+std::pair<size_t, size_t> ConcatDataset::Decode(size_t index){
+  return std::make_pair(index >> MEMBER_SHIFT, index & ((static_cast<size_t>(1) << MEMBER_SHIFT) - 1));
+}
+
+std::ostream& operator << (std::ostream& os, const ConcatDataset& dataset){
+  os << "Dataset ConcatDataset\n";
+  for(size_t m = 0; m < dataset.num_members(); ++m){
+    os << "   " << dataset.name(m);
+    if(!dataset.weights_.empty())
+      os << " weight " << dataset.weights_[m];
+    if(dataset.opened(m))
+      os << "\n" << dataset.member(m).coco_detection;
+    else
+      os << " (not opened)\n";
+  }
+  return os;
+}
+
+}//data
+}//rcnn
@@ -0,0 +1,129 @@
+#include "datasets/dataset_stats.h"
+#include "datasets/coco_datasets.h"
+#include <unistd.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <thread>
+
+
+namespace rcnn{
+namespace data{
+
+DatasetStats ComputeStats(const coco::COCO& coco){
+  DatasetStats stats;
+  stats.images.resize(coco.images.size());
+  for(size_t i = 0; i < coco.images.size(); ++i){
+    const coco::ImageRecord& img = coco.images[i];
+    stats.images[i] = ImageStats{img.id, img.width, img.height, 0};
+  }
+  std::sort(stats.images.begin(), stats.images.end(), [](const ImageStats& a, const ImageStats& b){ return a.id < b.id; });
+
+  //the annotations of an image are checked independently of the others
+  size_t n = stats.images.size();
+  size_t num_threads = std::max<size_t>(1, std::min<size_t>(std::max(1u, std::thread::hardware_concurrency()), n / 4096));
+  size_t chunk = (n + num_threads - 1) / num_threads;
+  std::vector<std::thread> workers;
+  for(size_t begin = 0; begin < n; begin += chunk){
+    workers.emplace_back([&stats, &coco, begin, chunk, n]{
+      for(size_t i = begin; i < std::min(n, begin + chunk); ++i)
+        stats.images[i].valid = has_valid_annotation(coco.ImageAnnotations(stats.images[i].id));
+    });
+  }
+  for(auto& worker : workers)
+    worker.join();
+
+  //file order, like GetCatIds
+  for(auto& cat : coco.categories)
+    stats.category_ids.push_back(cat.id);
+  return stats;
+}
+
+std::string StatsPath(const std::string& annotation_file){
+  return annotation_file + ".stats";
+}
+
+bool WriteStats(const DatasetStats& stats, const std::string& stats_file, const std::string& annotation_file){
+  StatsHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, STATS_MAGIC, sizeof(STATS_MAGIC));
+  header.version = STATS_VERSION;
+  header.byte_order = coco::CACHE_BYTE_ORDER;
+  if(!coco::StampFile(annotation_file, header.source))
+    return false;
+  header.num_images = stats.images.size();
+  header.num_categories = stats.category_ids.size();
+
+  std::string tmp_file = stats_file + ".tmp" + std::to_string(getpid());
+  {
+    std::ofstream ofs(tmp_file, std::ios::binary | std::ios::trunc);
+    if(!ofs)
+      return false;
+    ofs.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    ofs.write(reinterpret_cast<const char*>(stats.images.data()), stats.images.size() * sizeof(ImageStats));
+    ofs.write(reinterpret_cast<const char*>(stats.category_ids.data()), stats.category_ids.size() * sizeof(int32_t));
+    if(!ofs.good()){
+      std::remove(tmp_file.c_str());
+      return false;
+    }
+  }
+  if(std::rename(tmp_file.c_str(), stats_file.c_str()) != 0){
+    std::remove(tmp_file.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool LoadStats(DatasetStats& stats, const std::string& stats_file, const std::string& annotation_file){
+  std::ifstream ifs(stats_file, std::ios::binary);
+  if(!ifs)
+    return false;
+  StatsHeader header;
+  if(!ifs.read(reinterpret_cast<char*>(&header), sizeof(header)))
+    return false;
+  if(std::memcmp(header.magic, STATS_MAGIC, sizeof(STATS_MAGIC)) != 0 || header.version != STATS_VERSION || header.byte_order != coco::CACHE_BYTE_ORDER)
+    return false;
+
+  coco::SourceStamp stamp;
+  if(!coco::StampFile(annotation_file, stamp))
+    return false;
+  if(stamp.size != header.source.size || stamp.mtime != header.source.mtime || stamp.hash != header.source.hash)
+    return false;
+
+  //a corrupted header must not size the tables, the sections have to fill the rest of the file exactly
+  ifs.seekg(0, std::ios::end);
+  uint64_t body = static_cast<uint64_t>(ifs.tellg()) - sizeof(header);
+  ifs.seekg(sizeof(header));
+  if(header.num_images > body / sizeof(ImageStats) || header.num_categories > body / sizeof(int32_t)
+     || header.num_images * sizeof(ImageStats) + header.num_categories * sizeof(int32_t) != body)
+    return false;
+
+  DatasetStats loaded;
+  loaded.images.resize(header.num_images);
+  loaded.category_ids.resize(header.num_categories);
+  ifs.read(reinterpret_cast<char*>(loaded.images.data()), loaded.images.size() * sizeof(ImageStats));
+  ifs.read(reinterpret_cast<char*>(loaded.category_ids.data()), loaded.category_ids.size() * sizeof(int32_t));
+  if(!ifs)
+    return false;
+  stats.images.swap(loaded.images);
+  stats.category_ids.swap(loaded.category_ids);
+  return true;
+}
+
+DatasetStats LoadOrComputeStats(const coco::COCO& coco, const std::string& annotation_file){
+  DatasetStats stats;
+  if(annotation_file.empty())
+    return ComputeStats(coco);
+  std::string stats_file = StatsPath(annotation_file);
+  if(LoadStats(stats, stats_file, annotation_file))
+    return stats;
+  stats = ComputeStats(coco);
+  if(!WriteStats(stats, stats_file, annotation_file))
+    std::cout << "could not write dataset stats " << stats_file << "\n";
+  return stats;
+}
+
+}//data
+}//rcnn
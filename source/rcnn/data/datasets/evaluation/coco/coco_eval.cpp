@@ -1,11 +1,14 @@
 #include "datasets/evaluation/coco/coco_eval.h"
 
-#include <rapidjson/ostreamwrapper.h>
-#include <rapidjson/writer.h>
+#include "defaults.h"
+#include "roi_heads/mask_head/inference.h"
 #include <fstream>
 
 #include <torch/torch.h>
 #include <coco.h>
+#include <coco_eval.h>
+#include <coco_results.h>
+#include <iomanip>
 #include <iostream>
 
 
@@ -14,76 +17,175 @@ namespace data{
 
 using namespace rapidjson;
 
+namespace{
+
+//json category ids of the labels of a prediction
+std::vector<int64_t> CategoryIds(rcnn::structures::BoxList& prediction, COCODataset& dataset){
+  torch::Tensor labels = prediction.GetField("labels").to(torch::kCPU).to(torch::kI64).contiguous();
+  const int64_t* label_data = labels.data<int64_t>();
+  std::vector<int64_t> category_ids(labels.size(0));
+  for(size_t i = 0; i < category_ids.size(); ++i)
+    category_ids[i] = dataset.contiguous_category_id_to_json_id().at(label_data[i]);
+  return category_ids;
+}
+
+//masks of a prediction resized to the original image, pasted into it when they are not yet
+std::vector<coco::RLEstr> EncodePredictionMasks(rcnn::structures::BoxList& prediction, std::pair<int, int> image_size){
+  torch::Tensor masks = prediction.GetField("mask");
+  if(masks.size(-2) != image_size.second || masks.size(-1) != image_size.first){
+    rcnn::modeling::Masker masker(0.5, 1);
+    masks = masker.ForwardSingleImage(masks, prediction);
+  }
+  //rles are encoded straight from the bytes of the masks
+  masks = masks.to(torch::kCPU).to(torch::kU8).contiguous();
+  return coco::EncodeMasks(masks.data<uint8_t>(), masks.size(0), masks.size(-2), masks.size(-1));
+}
+
+}//namespace
+
 void DoCOCOEvaluation(COCODataset& dataset, 
                  std::map<int64_t, rcnn::structures::BoxList>& predictions,
                  std::string output_folder,
-                 std::set<std::string> iou_types,
-                 std::string ann_file){
+                 std::set<std::string> iou_types){
   std::cout << "Preparing results for COCO format\n";
 
+  bool binary = rcnn::config::GetCFG<bool>({"TEST", "BINARY_RESULTS"});
   if(iou_types.count("bbox")){
     std::cout << "Preparing bbox results\n";
-    prepare_for_coco_detection(output_folder, predictions, dataset);
+    prepare_for_coco_detection(output_folder, predictions, dataset, binary);
+  }
+  if(iou_types.count("segm")){
+    std::cout << "Preparing segm results\n";
+    prepare_for_coco_segmentation(output_folder, predictions, dataset);
   }
 
-  std::cout << "Evaluation is not implemented!\n";
-  std::cout << "Run python script\n";
-  std::string types = "";
-  for(auto i = iou_types.begin(); i != iou_types.end(); ++i)
-    types = types + " " + *i;
+  coco::COCO& coco_gt = dataset.coco_detection.coco_;
+  std::map<std::string, std::vector<double>> results;
+  for(auto& iou_type : iou_types){
+    std::string res_file = output_folder + "/" + iou_type + (binary && iou_type == "bbox" ? ".bin" : ".json");
+    if(iou_type != "bbox" && iou_type != "segm"){
+      std::cout << iou_type << " evaluation is not implemented\n";
+      continue;
+    }
+    if(!std::ifstream(res_file)){
+      std::cout << "no " << iou_type << " results in " << res_file << "\n";
+      continue;
+    }
+    coco::COCO coco_dt = binary && iou_type == "bbox" ? coco::LoadDetections(coco_gt, res_file) : coco_gt.LoadRes(res_file);
+    coco::COCOeval coco_eval(coco_gt, coco_dt, iou_type);
+    coco_eval.Evaluate();
+    coco_eval.Accumulate();
+    coco_eval.Summarize();
+    results[iou_type] = coco_eval.stats;
+  }
 
-  system(("python ../python_utils/coco_eval.py " + ann_file + " " + output_folder + types).c_str());
+  PrintCOCOResults(results);
 }
                  //TODO expected results
 
-void prepare_for_coco_detection(std::string output_folder, std::map<int64_t, rcnn::structures::BoxList>& predictions, COCODataset& dataset){
-  Document coco_results;
-  auto& a = coco_results.GetAllocator();
-  coco_results.SetArray();
-  int64_t original_id, image_width, image_height, image_id;
-  coco::Image image_info;
-  rcnn::structures::BoxList prediction;
-  torch::Tensor bboxes, scores, labels;
+void prepare_for_coco_detection(std::string output_folder, std::map<int64_t, rcnn::structures::BoxList>& predictions, COCODataset& dataset, bool binary){
+  coco::ResultsWriter writer(output_folder + (binary ? "/bbox.bin" : "/bbox.json"), binary);
   for(auto prediction_set = predictions.begin(); prediction_set != predictions.end(); ++prediction_set){
-    image_id = prediction_set->first;
-    original_id = dataset.id_to_img_map[image_id];
-    prediction = prediction_set->second;
+    int64_t image_id = prediction_set->first;
+    rcnn::structures::BoxList prediction = prediction_set->second;
     if(prediction.Length() == 0)
       continue;
-    image_info = dataset.get_img_info(image_id);
-    image_height = image_info.height;
-    image_width = image_info.width;
-    prediction = prediction.Resize(std::make_pair(image_width, image_height));
+    std::pair<int, int> image_size = dataset.image_size(image_id);
+    prediction = prediction.Resize(std::make_pair(image_size.first, image_size.second));
     prediction = prediction.Convert("xywh");
 
-    bboxes = prediction.get_bbox();
-    //bboxes = bboxes.reshape({-1});
-    scores = prediction.GetField("scores");
-    labels = prediction.GetField("labels");
-
-    for(int i = 0; i < scores.size(0); ++i){
-      Value node(kObjectType);
-      node.AddMember("image_id", original_id, a);
-      node.AddMember("score", scores[i].item<double>(), a);
-      Value box(kArrayType);
-      box.PushBack(bboxes[i][0].item<float>(), a)
-         .PushBack(bboxes[i][1].item<float>(), a)
-         .PushBack(bboxes[i][2].item<float>(), a)
-         .PushBack(bboxes[i][3].item<float>(), a);
-      node.AddMember("bbox", box, a);
-      node.AddMember("category_id", dataset.contiguous_category_id_to_json_id[labels[i].item<int>()], a);
-      coco_results.PushBack(node, a);
+    //one copy to the cpu per field, the writer reads the raw arrays
+    torch::Tensor bboxes = prediction.get_bbox().to(torch::kCPU).to(torch::kF32).contiguous();
+    torch::Tensor scores = prediction.GetField("scores").to(torch::kCPU).to(torch::kF32).contiguous();
+    std::vector<int64_t> category_ids = CategoryIds(prediction, dataset);
+    writer.Write(dataset.id_to_img_map(image_id), bboxes.data<float>(), scores.data<float>(), category_ids.data(), category_ids.size());
+  }
+  if(!writer.Close())
+    std::cout << "could not write bbox results to " << output_folder << "\n";
+}
+
+void prepare_for_coco_segmentation(std::string output_folder, std::map<int64_t, rcnn::structures::BoxList>& predictions, COCODataset& dataset){
+  coco::ResultsWriter writer(output_folder + "/segm.json");
+  for(auto prediction_set = predictions.begin(); prediction_set != predictions.end(); ++prediction_set){
+    int64_t image_id = prediction_set->first;
+    rcnn::structures::BoxList prediction = prediction_set->second;
+    if(prediction.Length() == 0)
+      continue;
+    std::pair<int, int> image_size = dataset.image_size(image_id);
+    prediction = prediction.Resize(std::make_pair(image_size.first, image_size.second));
+    std::vector<coco::RLEstr> rles = EncodePredictionMasks(prediction, image_size);
+    torch::Tensor scores = prediction.GetField("scores").to(torch::kCPU).to(torch::kF32).contiguous();
+    std::vector<int64_t> category_ids = CategoryIds(prediction, dataset);
+    writer.Write(dataset.id_to_img_map(image_id), rles, scores.data<float>(), category_ids.data());
+  }
+  if(!writer.Close())
+    std::cout << "could not write segm results to " << output_folder << "\n";
+}
+
+void PrintCOCOResults(const std::map<std::string, std::vector<double>>& results){
+  //like COCOResults of maskrcnn_benchmark
+  for(auto& result : results){
+    std::cout << "Task: " << result.first << "\n";
+    std::cout << "AP, AP50, AP75, APs, APm, APl\n";
+    for(int i = 0; i < 6; ++i)
+      std::cout << std::fixed << std::setprecision(4) << result.second[i] << (i < 5 ? ", " : "\n");
+  }
+}
+
+COCOOnlineEvaluation::COCOOnlineEvaluation(COCODataset& dataset, std::set<std::string> iou_types)
+  :dataset_(dataset), count_(0)
+{
+  for(auto& iou_type : iou_types){
+    if(iou_type != "bbox" && iou_type != "segm"){
+      std::cout << iou_type << " evaluation is not implemented\n";
+      continue;
+    }
+    evals_.emplace(iou_type, coco::COCOeval(dataset.coco_detection.coco_, iou_type));
+  }
+}
+
+void COCOOnlineEvaluation::Add(int64_t image_id, rcnn::structures::BoxList prediction){
+  int original_id = dataset_.id_to_img_map(image_id);
+  //images without detections still count their ground truth
+  if(prediction.Length() == 0){
+    for(auto& eval : evals_){
+      if(eval.first == "bbox")
+        eval.second.AddImage(original_id, nullptr, nullptr, nullptr, 0);
+      else
+        eval.second.AddImage(original_id, std::vector<coco::RLEstr>{}, nullptr, nullptr);
+    }
+    count_++;
+    return;
+  }
+  std::pair<int, int> image_size = dataset_.image_size(image_id);
+  prediction = prediction.Resize(std::make_pair(image_size.first, image_size.second));
+  torch::Tensor scores = prediction.GetField("scores").to(torch::kCPU).to(torch::kF32).contiguous();
+  std::vector<int64_t> category_ids = CategoryIds(prediction, dataset_);
+  for(auto& eval : evals_){
+    if(eval.first == "bbox"){
+      torch::Tensor bboxes = prediction.Convert("xywh").get_bbox().to(torch::kCPU).to(torch::kF32).contiguous();
+      eval.second.AddImage(original_id, bboxes.data<float>(), scores.data<float>(), category_ids.data(), category_ids.size());
     }
+    else{
+      std::vector<coco::RLEstr> rles = EncodePredictionMasks(prediction, image_size);
+      eval.second.AddImage(original_id, rles, scores.data<float>(), category_ids.data());
+    }
+  }
+  count_++;
+}
+
+std::map<std::string, std::vector<double>> COCOOnlineEvaluation::Summarize(){
+  std::map<std::string, std::vector<double>> results;
+  for(auto& eval : evals_){
+    eval.second.Accumulate();
+    eval.second.Summarize();
+    results[eval.first] = eval.second.stats;
   }
- 
-  std::ofstream ofs(output_folder + "/bbox.json");
-  OStreamWrapper osw(ofs);
-  Writer<OStreamWrapper> writer(osw);
-  coco_results.Accept(writer);
+  return results;
 }
 
-void prepare_for_coco_segmentation(std::string output_folder, std::vector<rcnn::structures::BoxList>& predictions, COCODataset& dataset){
-  
+size_t COCOOnlineEvaluation::count() const{
+  return count_;
 }
 
 }
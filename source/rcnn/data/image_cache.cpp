@@ -0,0 +1,117 @@
+#include "image_cache.h"
+#include <algorithm>
+#include <iostream>
+
+
+namespace rcnn{
+namespace data{
+
+namespace{
+
+int64_t MatBytes(const cv::Mat& img){
+  return static_cast<int64_t>(img.total() * img.elemSize());
+}
+
+}//namespace
+
+ImageCache::ImageCache(int64_t byte_budget, int num_shards)
+                      :byte_budget_(byte_budget),
+                       shard_budget_(byte_budget / std::max(num_shards, 1)),
+                       hits_(0),
+                       misses_(0),
+                       evictions_(0)
+{
+  for(int i = 0; i < std::max(num_shards, 1); ++i)
+    shards_.emplace_back(new Shard());
+}
+
+ImageCache::Shard& ImageCache::GetShard(int64_t id){
+  //ids are mostly consecutive, so a plain modulo spreads them evenly
+  return *shards_[static_cast<uint64_t>(id) % shards_.size()];
+}
+
+bool ImageCache::Get(int64_t id, cv::Mat& img){
+  Shard& shard = GetShard(id);
+  {
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto entry = shard.entries.find(id);
+    if(entry != shard.entries.end()){
+      shard.lru.splice(shard.lru.begin(), shard.lru, entry->second);
+      img = entry->second->second;
+      hits_++;
+      return true;
+    }
+  }
+  misses_++;
+  return false;
+}
+
+void ImageCache::Put(int64_t id, const cv::Mat& img){
+  int64_t img_bytes = MatBytes(img);
+  if(img.empty() || img_bytes > shard_budget_)
+    return;
+
+  Shard& shard = GetShard(id);
+  std::lock_guard<std::mutex> lock(shard.mutex);
+  auto entry = shard.entries.find(id);
+  if(entry != shard.entries.end()){
+    shard.bytes -= MatBytes(entry->second->second);
+    shard.lru.erase(entry->second);
+    shard.entries.erase(entry);
+  }
+  while(shard.bytes + img_bytes > shard_budget_ && !shard.lru.empty()){
+    shard.bytes -= MatBytes(shard.lru.back().second);
+    shard.entries.erase(shard.lru.back().first);
+    shard.lru.pop_back();
+    evictions_++;
+  }
+  shard.lru.emplace_front(id, img);
+  shard.entries[id] = shard.lru.begin();
+  shard.bytes += img_bytes;
+}
+
+void ImageCache::Clear(){
+  for(auto& shard : shards_){
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    shard->lru.clear();
+    shard->entries.clear();
+    shard->bytes = 0;
+  }
+}
+
+int64_t ImageCache::hits() const{
+  return hits_;
+}
+
+int64_t ImageCache::misses() const{
+  return misses_;
+}
+
+int64_t ImageCache::evictions() const{
+  return evictions_;
+}
+
+int64_t ImageCache::bytes() const{
+  int64_t total = 0;
+  for(auto& shard : shards_){
+    std::lock_guard<std::mutex> lock(shard->mutex);
+    total += shard->bytes;
+  }
+  return total;
+}
+
+int64_t ImageCache::byte_budget() const{
+  return byte_budget_;
+}
+
+std::ostream& operator << (std::ostream& os, const ImageCache& cache){
+  os << "ImageCache(";
+  os << "hits=" << cache.hits() << ", ";
+  os << "misses=" << cache.misses() << ", ";
+  os << "evictions=" << cache.evictions() << ", ";
+  os << "bytes=" << cache.bytes() << "/" << cache.byte_budget() << ")";
+  return os;
+}
+
+}//data
+}//rcnn
@@ -1,7 +1,10 @@
 #include "samplers/build.h"
+#include <algorithm>
 #include <memory>
+#include <numeric>
 #include "bisect.h"
 #include "samplers/samplers.h"
+#include "transforms/transforms.h"
 
 #include <defaults.h>
 
@@ -23,18 +26,48 @@ std::vector<int> _quantize(std::vector<float> x, std::vector<float> bins){
   return quantized;
 }
 
-std::vector<float> _compute_aspect_ratios(COCODataset dataset){
+std::vector<float> _compute_aspect_ratios(COCODataset& dataset){
   std::vector<float> aspect_ratios;
-  float aspect_ratio;
-  for(int i = 0; i < *dataset.size(); ++i){
-    auto image_info = dataset.get_img_info(i);
-    aspect_ratio = static_cast<float>(image_info.height) / static_cast<float>(image_info.width);
-    aspect_ratios.push_back(aspect_ratio);
+  aspect_ratios.reserve(dataset.size().value());
+  for(size_t i = 0; i < dataset.size().value(); ++i){
+    std::pair<int, int> size = dataset.image_size(i);
+    aspect_ratios.push_back(static_cast<float>(size.second) / static_cast<float>(size.first));
   }
   return aspect_ratios;
 }
 
-std::shared_ptr<torch::data::samplers::Sampler<>> make_batch_data_sampler(COCODataset dataset, 
+std::vector<std::pair<int, int>> _compute_resized_sizes(COCODataset& dataset, int min_size, int max_size){
+  Resize resize(min_size, max_size);
+  std::vector<std::pair<int, int>> sizes;
+  sizes.reserve(dataset.size().value());
+  for(size_t i = 0; i < dataset.size().value(); ++i)
+    sizes.push_back(resize.get_size(dataset.image_size(i)));
+  return sizes;
+}
+
+std::vector<int> _compute_size_buckets(const std::vector<std::pair<int, int>>& sizes, int step){
+  std::vector<int> buckets;
+  buckets.reserve(sizes.size());
+  for(auto& size : sizes)
+    buckets.push_back(((size.first + step - 1) / step) << 16 | ((size.second + step - 1) / step));
+  return buckets;
+}
+
+std::vector<std::pair<size_t, size_t>> _compute_shard_ranges(COCODataset& dataset){
+  std::vector<std::pair<size_t, size_t>> ranges;
+  int current = -1;
+  for(size_t i = 0; i < dataset.coco_detection.ids().size(); ++i){
+    int shard = dataset.coco_detection.shards_->Find(dataset.coco_detection.ids()[i]);
+    if(ranges.empty() || shard != current)
+      ranges.emplace_back(i, i + 1);
+    else
+      ranges.back().second = i + 1;
+    current = shard;
+  }
+  return ranges;
+}
+
+std::shared_ptr<torch::data::samplers::Sampler<>> make_batch_data_sampler(COCODataset& dataset, 
                                                                           bool is_train,
                                                                           int start_iter)
 {
@@ -54,11 +87,35 @@ std::shared_ptr<torch::data::samplers::Sampler<>> make_batch_data_sampler(COCODa
     start_iter = 0;
   }
   bool aspect_grouping = rcnn::config::GetCFG<bool>({"DATALOADER", "ASPECT_RATIO_GROUPING"});
+  int bucket_step = rcnn::config::GetCFG<int>({"DATALOADER", "SIZE_BUCKET_STEP"});
+  std::vector<std::pair<int, int>> sizes;
+  if(bucket_step > 0){
+    if(is_train)
+      sizes = _compute_resized_sizes(dataset, rcnn::config::GetCFG<int>({"INPUT", "MIN_SIZE_TRAIN"}), rcnn::config::GetCFG<int>({"INPUT", "MAX_SIZE_TRAIN"}));
+    else
+      sizes = _compute_resized_sizes(dataset, rcnn::config::GetCFG<int>({"INPUT", "MIN_SIZE_TEST"}), rcnn::config::GetCFG<int>({"INPUT", "MAX_SIZE_TEST"}));
+  }
 
-  std::shared_ptr<torch::data::samplers::Sampler<>> sampler = make_data_sampler(dataset.size().value(), shuffle);
+  std::shared_ptr<torch::data::samplers::Sampler<>> sampler;
+  if(shuffle && dataset.coco_detection.shards_)
+    sampler = std::make_shared<ShardSampler>(_compute_shard_ranges(dataset));
+  else if(!shuffle && bucket_step > 0){
+    //images of the same resized shape become neighbours, so inference batches pad little
+    std::vector<size_t> order(sizes.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&sizes](size_t a, size_t b){
+      return sizes[a] < sizes[b];
+    });
+    sampler = std::make_shared<OrderedSampler>(order);
+  }
+  else
+    sampler = make_data_sampler(dataset.size().value(), shuffle);
   if(aspect_grouping){
-    std::vector<float> aspect_ratios = _compute_aspect_ratios(dataset);
-    std::vector<int> group_ids = _quantize(aspect_ratios, std::vector<float>{1});
+    std::vector<int> group_ids;
+    if(bucket_step > 0)
+      group_ids = _compute_size_buckets(sizes, bucket_step);
+    else
+      group_ids = _quantize(_compute_aspect_ratios(dataset), rcnn::config::GetCFG<std::vector<float>>({"DATALOADER", "ASPECT_RATIO_BINS"}));
     batch_sampler = std::make_shared<GroupedBatchSampler>(sampler, group_ids, images_per_batch, false);
   }
   else{
@@ -71,6 +128,37 @@ std::shared_ptr<torch::data::samplers::Sampler<>> make_batch_data_sampler(COCODa
 
   return batch_sampler;
 }
+
+std::shared_ptr<torch::data::samplers::Sampler<>> make_concat_batch_sampler(ConcatDataset& dataset, int start_iter){
+  if(dataset.num_members() == 1)
+    return make_batch_data_sampler(dataset.member(0), true, start_iter);
+
+  int64_t images_per_batch = rcnn::config::GetCFG<int64_t>({"SOLVER", "IMS_PER_BATCH"});
+  int num_iters = rcnn::config::GetCFG<int64_t>({"SOLVER", "MAX_ITER"});
+  //read here, groups are loaded on the data loader's thread
+  bool aspect_grouping = rcnn::config::GetCFG<bool>({"DATALOADER", "ASPECT_RATIO_GROUPING"});
+  int bucket_step = rcnn::config::GetCFG<int>({"DATALOADER", "SIZE_BUCKET_STEP"});
+  int min_size = rcnn::config::GetCFG<int>({"INPUT", "MIN_SIZE_TRAIN"});
+  int max_size = rcnn::config::GetCFG<int>({"INPUT", "MAX_SIZE_TRAIN"});
+  std::vector<float> bins = rcnn::config::GetCFG<std::vector<float>>({"DATALOADER", "ASPECT_RATIO_BINS"});
+
+  //uniform by default, weighting by size would open every member before the first batch
+  std::vector<float> weights = dataset.weights();
+  if(weights.empty())
+    weights.assign(dataset.num_members(), 1);
+  //copies share the opened members
+  ConcatDataset members = dataset;
+  WeightedBatchSampler::GroupLoader load_groups = [members, aspect_grouping, bucket_step, min_size, max_size, bins](size_t m) -> std::vector<int>{
+    COCODataset& member = members.member(m);
+    if(!aspect_grouping)
+      return std::vector<int>(member.size().value(), 0);
+    if(bucket_step > 0)
+      return _compute_size_buckets(_compute_resized_sizes(member, min_size, max_size), bucket_step);
+    return _quantize(_compute_aspect_ratios(member), bins);
+  };
+  std::shared_ptr<torch::data::samplers::Sampler<>> batch_sampler = std::make_shared<WeightedBatchSampler>(weights, load_groups, images_per_batch);
+  return std::make_shared<IterationBasedBatchSampler>(batch_sampler, num_iters, start_iter);
+}
                                                                         
 
 }
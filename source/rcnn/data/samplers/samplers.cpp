@@ -1,130 +1,112 @@
 #include "samplers/samplers.h"
+#include "datasets/concat_dataset.h"
+#include <algorithm>
+#include <cassert>
 #include <iostream>
+#include <numeric>
 
 
 namespace rcnn{
 namespace data{
 
+namespace{
+
+torch::Tensor ToTensor(std::vector<int64_t> values){
+  return torch::from_blob(values.data(), {static_cast<int64_t>(values.size())}, torch::kI64).clone();
+}
+
+std::vector<int64_t> FromTensor(const torch::Tensor& tensor){
+  torch::Tensor values = tensor.to(torch::kI64).contiguous();
+  return std::vector<int64_t>(values.data<int64_t>(), values.data<int64_t>() + values.numel());
+}
+
+}//namespace
+
 GroupedBatchSampler::GroupedBatchSampler(std::shared_ptr<torch::data::samplers::Sampler<>> sampler, 
                                          std::vector<int> group_ids, 
                                          int batch_size, 
                                          bool drop_uneven)
                                         :sampler_(sampler),
-                                         group_ids_(init_group_id(group_ids)),
+                                         group_ids_(group_ids),
                                          batch_size_(batch_size),
-                                         drop_uneven_(drop_uneven),
-                                         groups(std::get<0>(std::get<0>(torch::_unique(group_ids_)).sort(0))),
-                                         _can_reuse_batches(false){}
-
-torch::Tensor GroupedBatchSampler::init_group_id(std::vector<int> group_ids){
-  torch::Tensor group_tensor = torch::zeros({static_cast<int64_t>(group_ids.size())});
-  for(int i = 0; i < group_ids.size(); ++i)
-    group_tensor[i] = group_ids[i];
+                                         drop_uneven_(drop_uneven)
+{
+  group_slots_ = init_group_id(group_ids_);
+}
 
-  return group_tensor;
+std::vector<int> GroupedBatchSampler::init_group_id(const std::vector<int>& group_ids){
+  groups = group_ids;
+  std::sort(groups.begin(), groups.end());
+  groups.erase(std::unique(groups.begin(), groups.end()), groups.end());
+  std::vector<int> slots(group_ids.size());
+  for(size_t i = 0; i < group_ids.size(); ++i)
+    slots[i] = std::lower_bound(groups.begin(), groups.end(), group_ids[i]) - groups.begin();
+  return slots;
 }
 
-std::vector<torch::Tensor> GroupedBatchSampler::_prepare_batches(){
-  int64_t dataset_size = group_ids_.size(0);
-  std::vector<int> sampled_ids;
-  auto i = sampler_->next(1);
-  while(i.has_value()){
-    sampled_ids.push_back(i.value()[0]);
-    i = sampler_->next(1);
-  }
-  sampled_ids_ = torch::zeros({static_cast<int64_t>(sampled_ids.size())}).to(torch::kI64);
-  for(int i = 0; i < sampled_ids.size(); ++i)
-    sampled_ids_[i] = sampled_ids[i];
-
-  torch::Tensor order = torch::full({dataset_size}, -1).to(torch::kI64);
-  order.index_copy_(0, sampled_ids_, torch::arange(sampled_ids_.size(0)).to(torch::kI64));
-
-  torch::Tensor mask = order >= 0;
-  std::vector<torch::Tensor> clusters;
-  clusters.reserve(groups.size(0));
-  for(int i = 0; i < groups.size(0); ++i)
-    clusters.push_back((group_ids_ == groups[i]).__and__(mask));
-
-  //clusters.clear();
-  std::vector<torch::Tensor> relative_order;
-  relative_order.reserve(clusters.size());
-  for(auto& cluster: clusters)
-    relative_order.push_back(order.masked_select(cluster));
-
-  std::vector<torch::Tensor> permutation_ids;
-  permutation_ids.reserve(relative_order.size());
-  for(auto& s : relative_order)
-    permutation_ids.push_back(s.index_select(0, std::get<1>(s.sort())));
-
-  std::vector<torch::Tensor> permuted_clusters;
-  permuted_clusters.reserve(permutation_ids.size());
-  for(auto& idx : permutation_ids)
-    permuted_clusters.push_back(sampled_ids_.index_select(0, idx));
-
-  std::vector<torch::Tensor> merged;
-  merged.reserve(permuted_clusters.size());
-  for(auto& c : permuted_clusters){
-    auto splitted_c = c.split(batch_size_);
-    merged.reserve(merged.size() + splitted_c.size());
-    merged.insert(merged.end(), splitted_c.begin(), splitted_c.end());
+std::vector<std::vector<size_t>> GroupedBatchSampler::_prepare_batches(){
+  sampled_ids_.clear();
+  sampled_ids_.reserve(group_ids_.size());
+  auto ids = sampler_->next(std::max<size_t>(group_ids_.size(), 1));
+  while(ids.has_value()){
+    sampled_ids_.insert(sampled_ids_.end(), ids->begin(), ids->end());
+    ids = sampler_->next(std::max<size_t>(group_ids_.size(), 1));
   }
+  return _plan_batches(sampled_ids_);
+}
 
-  std::vector<int> first_element_of_batch;
-  first_element_of_batch.reserve(merged.size());
-  for(auto& t : merged)
-    first_element_of_batch.push_back(t[0].item<int>());
-    
-  std::map<int, int> inv_sampled_ids_map;
-  for(int i = 0; i < sampled_ids_.size(0); ++i)
-    inv_sampled_ids_map[sampled_ids_[i].item<int>()] = i;
-
-  torch::Tensor first_index_of_batch = torch::zeros({static_cast<int64_t>(first_element_of_batch.size())}).to(torch::kI64);
-  for(int i = 0; i < first_element_of_batch.size(); ++i)
-    first_index_of_batch[i] = inv_sampled_ids_map[first_element_of_batch[i]];
-
-  std::vector<int> permutation_order;
-  auto sorted_indices = std::get<1>(first_index_of_batch.sort(0));
-  permutation_order.reserve(sorted_indices.size(0));
-  for(int i = 0; i < sorted_indices.size(0); ++i)
-    permutation_order.push_back(sorted_indices[i].item<int>());
-
-  std::vector<torch::Tensor> batches;
-  batches.reserve(permutation_order.size());
-  for(auto& i : permutation_order)
-    batches.push_back(merged[i]);
-  if(drop_uneven_){
-    for(auto i = batches.begin(); i != batches.end();){
-      if(i->size(0) == batch_size_)
-        i++;
-      else
-        i = batches.erase(i);
+//same plan as the python sampler: the sampled ids of every group keep their sampled order
+//and are cut into batches, batches are ordered by the sampled position of their first element
+std::vector<std::vector<size_t>> GroupedBatchSampler::_plan_batches(const std::vector<int64_t>& sampled_ids) const{
+  //positions in sampled_ids of every group
+  std::vector<std::vector<size_t>> clusters(groups.size());
+  for(size_t i = 0; i < sampled_ids.size(); ++i)
+    clusters[group_slots_[sampled_ids[i]]].push_back(i);
+
+  //batch starting at every position, -1 where none starts
+  std::vector<std::vector<size_t>> merged;
+  std::vector<int64_t> batch_at(sampled_ids.size(), -1);
+  for(auto& cluster : clusters){
+    for(size_t begin = 0; begin < cluster.size(); begin += batch_size_){
+      size_t end = std::min(begin + static_cast<size_t>(batch_size_), cluster.size());
+      if(drop_uneven_ && end - begin != static_cast<size_t>(batch_size_))
+        continue;
+      std::vector<size_t> batch;
+      batch.reserve(end - begin);
+      for(size_t k = begin; k < end; ++k)
+        batch.push_back(sampled_ids[cluster[k]]);
+      batch_at[cluster[begin]] = merged.size();
+      merged.push_back(std::move(batch));
     }
   }
+
+  std::vector<std::vector<size_t>> batches;
+  batches.reserve(merged.size());
+  for(auto& b : batch_at){
+    if(b >= 0)
+      batches.push_back(std::move(merged[b]));
+  }
   return batches;
 }
 
 torch::optional<std::vector<size_t>> GroupedBatchSampler::next(size_t batch_size){
   if(_batches.size() == 0)
     _batches = _prepare_batches();
-  if(index_ < _batches.size()){
-    std::vector<size_t> indices;
-    auto indices_tensor = _batches[index_];
-    for(int i = 0; i < indices_tensor.size(0); ++i)
-      indices.push_back(indices_tensor[i].item<int>());
-    index_++;
-    return indices;
-  }
+  if(index_ < _batches.size())
+    return _batches[index_++];
 
   return torch::nullopt;
 }
 
+//planning is cheap, so every epoch gets a new plan like the python sampler
+//new_size is ignored, the dataset size is fixed by group_ids
 void GroupedBatchSampler::reset(torch::optional<size_t> new_size){
-  //_batches = _prepare_batches();
-  index_ = 0;
+  reset();
 }
 
 void GroupedBatchSampler::reset(){
-  //_batches = _prepare_batches();
+  sampler_->reset(torch::nullopt);
+  _batches.clear();
   index_ = 0;
 }
 
@@ -143,21 +125,23 @@ void GroupedBatchSampler::load(torch::serialize::InputArchive& archive){
   );
   batch_size_ = tensor.item<int64_t>();
 
+  torch::Tensor group_ids, sampled_ids;
   archive.read(
       "group_id",
-      group_ids_,
+      group_ids,
       true
   );
   archive.read(
       "sample_id",
-      sampled_ids_,
-      true
-  );
-  archive.read(
-      "groups",
-      groups,
+      sampled_ids,
       true
   );
+  std::vector<int64_t> loaded = FromTensor(group_ids);
+  group_ids_.assign(loaded.begin(), loaded.end());
+  group_slots_ = init_group_id(group_ids_);
+  //the resumed epoch continues with the saved plan
+  sampled_ids_ = FromTensor(sampled_ids);
+  _batches = _plan_batches(sampled_ids_);
 }
 
 void GroupedBatchSampler::save(torch::serialize::OutputArchive& archive) const {
@@ -173,21 +157,177 @@ void GroupedBatchSampler::save(torch::serialize::OutputArchive& archive) const {
   );
   archive.write(
       "group_id",
-      group_ids_,
+      ToTensor(std::vector<int64_t>(group_ids_.begin(), group_ids_.end())),
       true
   );
   archive.write(
       "sample_id",
-      sampled_ids_,
+      ToTensor(sampled_ids_),
       true
   );
   archive.write(
       "groups",
-      groups,
+      ToTensor(std::vector<int64_t>(groups.begin(), groups.end())),
       true
   );
 }
 
+ShardSampler::ShardSampler(std::vector<std::pair<size_t, size_t>> ranges) :ranges_(ranges), index_(0){
+  reset(torch::nullopt);
+}
+
+void ShardSampler::reset(torch::optional<size_t> new_size){
+  int64_t size = 0;
+  for(auto& range : ranges_)
+    size += range.second - range.first;
+  indices_ = torch::empty({size}, torch::kI64);
+  int64_t* indices = indices_.data<int64_t>();
+  torch::Tensor shard_order = torch::randperm(static_cast<int64_t>(ranges_.size()), torch::kI64);
+  for(int64_t s = 0; s < shard_order.size(0); ++s){
+    const std::pair<size_t, size_t>& range = ranges_[shard_order.data<int64_t>()[s]];
+    int64_t length = range.second - range.first;
+    torch::Tensor order = torch::randperm(length, torch::kI64);
+    const int64_t* o = order.data<int64_t>();
+    for(int64_t i = 0; i < length; ++i)
+      *indices++ = range.first + o[i];
+  }
+  index_ = 0;
+}
+
+torch::optional<std::vector<size_t>> ShardSampler::next(size_t batch_size){
+  if(index_ >= indices_.size(0))
+    return torch::nullopt;
+  int64_t end = std::min(index_ + static_cast<int64_t>(batch_size), indices_.size(0));
+  const int64_t* indices = indices_.data<int64_t>();
+  std::vector<size_t> batch(indices + index_, indices + end);
+  index_ = end;
+  return batch;
+}
+
+void ShardSampler::save(torch::serialize::OutputArchive& archive) const{
+  archive.write(
+      "index",
+      torch::tensor(static_cast<int64_t>(index_), torch::kI64),
+      true
+  );
+  archive.write(
+      "indices",
+      indices_,
+      true
+  );
+}
+
+void ShardSampler::load(torch::serialize::InputArchive& archive){
+  auto tensor = torch::empty(1, torch::kInt64);
+  archive.read(
+      "index",
+      tensor,
+      true);
+  index_ = tensor.item<int64_t>();
+  archive.read(
+      "indices",
+      indices_,
+      true
+  );
+}
+
+OrderedSampler::OrderedSampler(std::vector<size_t> order) :order_(order), index_(0){}
+
+void OrderedSampler::reset(torch::optional<size_t> new_size){
+  index_ = 0;
+}
+
+torch::optional<std::vector<size_t>> OrderedSampler::next(size_t batch_size){
+  if(index_ >= order_.size())
+    return torch::nullopt;
+  size_t end = std::min(index_ + batch_size, order_.size());
+  std::vector<size_t> batch(order_.begin() + index_, order_.begin() + end);
+  index_ = end;
+  return batch;
+}
+
+void OrderedSampler::save(torch::serialize::OutputArchive& archive) const{
+  archive.write(
+      "index",
+      torch::tensor(static_cast<int64_t>(index_), torch::kI64),
+      true
+  );
+}
+
+void OrderedSampler::load(torch::serialize::InputArchive& archive){
+  auto tensor = torch::empty(1, torch::kInt64);
+  archive.read(
+      "index",
+      tensor,
+      true);
+  index_ = tensor.item<int64_t>();
+}
+
+WeightedBatchSampler::WeightedBatchSampler(std::vector<float> weights, GroupLoader load_groups, int batch_size)
+                                          :load_groups_(load_groups),
+                                           batch_size_(batch_size),
+                                           members_(weights.size()),
+                                           pick_(weights.begin(), weights.end())
+{
+  reset(torch::nullopt);
+}
+
+//seeded from torch so torch::manual_seed reproduces the stream
+void WeightedBatchSampler::reset(torch::optional<size_t> new_size){
+  engine_.seed(static_cast<uint64_t>(torch::randint(1LL << 62, {1}, torch::kI64).item<int64_t>()));
+  pending_.clear();
+}
+
+size_t WeightedBatchSampler::Draw(size_t m){
+  Member& member = members_[m];
+  if(!member.loaded){
+    member.group_ids = load_groups_(m);
+    assert(!member.group_ids.empty());
+    member.order.resize(member.group_ids.size());
+    std::iota(member.order.begin(), member.order.end(), 0);
+    member.position = member.order.size();
+    member.loaded = true;
+  }
+  //a new random order for every pass over the member
+  if(member.position == member.order.size()){
+    std::shuffle(member.order.begin(), member.order.end(), engine_);
+    member.position = 0;
+  }
+  return member.order[member.position++];
+}
+
+torch::optional<std::vector<size_t>> WeightedBatchSampler::next(size_t batch_size){
+  while(true){
+    size_t m = pick_(engine_);
+    size_t local = Draw(m);
+    std::vector<size_t>& group = pending_[members_[m].group_ids[local]];
+    group.push_back(ConcatDataset::Encode(m, local));
+    if(group.size() == static_cast<size_t>(batch_size_)){
+      std::vector<size_t> batch;
+      batch.swap(group);
+      return batch;
+    }
+  }
+}
+
+//the stream is random, only the batch size is kept
+void WeightedBatchSampler::save(torch::serialize::OutputArchive& archive) const{
+  archive.write(
+      "batch_size",
+      torch::tensor(static_cast<int64_t>(batch_size_), torch::kI64),
+      true
+  );
+}
+
+void WeightedBatchSampler::load(torch::serialize::InputArchive& archive){
+  auto tensor = torch::empty(1, torch::kInt64);
+  archive.read(
+      "batch_size",
+      tensor,
+      true);
+  batch_size_ = tensor.item<int64_t>();
+}
+
 IterationBasedBatchSampler::IterationBasedBatchSampler(std::shared_ptr<torch::data::samplers::Sampler<>> sampler, 
                                                        int num_iterations, 
                                                        int start_iter)
@@ -0,0 +1,296 @@
+#include "shard.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+#include <cassert>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+
+namespace rcnn{
+namespace data{
+
+namespace{
+
+//appenders copy a record and what it points to into builder, rebasing the offsets
+void AppendImage(coco::IndexBuilder& builder, coco::ImageRecord record, const char* strings){
+  const char* file_name = strings + record.file_name;
+  record.file_name = builder.AddString(file_name, std::strlen(file_name));
+  builder.images.push_back(record);
+}
+
+void AppendCategory(coco::IndexBuilder& builder, coco::CategoryRecord record, const char* strings){
+  const char* name = strings + record.name;
+  const char* supercategory = strings + record.supercategory;
+  record.name = builder.AddString(name, std::strlen(name));
+  record.supercategory = builder.AddString(supercategory, std::strlen(supercategory));
+  builder.categories.push_back(record);
+}
+
+void AppendAnnotation(coco::IndexBuilder& builder, coco::AnnotationRecord record, const double* coords, const uint32_t* rings, const uint32_t* counts, const char* strings){
+  if(record.segm_type == coco::SEGM_POLYGON){
+    uint32_t begin = static_cast<uint32_t>(builder.rings.size() - 1);
+    for(uint32_t r = record.segm_begin; r < record.segm_end; ++r){
+      builder.coords.insert(builder.coords.end(), coords + rings[r], coords + rings[r + 1]);
+      builder.rings.push_back(static_cast<uint32_t>(builder.coords.size()));
+    }
+    record.segm_begin = begin;
+    record.segm_end = static_cast<uint32_t>(builder.rings.size() - 1);
+  }
+  else if(record.segm_type == coco::SEGM_RLE){
+    uint32_t begin = static_cast<uint32_t>(builder.counts.size());
+    builder.counts.insert(builder.counts.end(), counts + record.segm_begin, counts + record.segm_end);
+    record.segm_begin = begin;
+    record.segm_end = static_cast<uint32_t>(builder.counts.size());
+  }
+  else if(record.segm_type == coco::SEGM_COMPRESSED_RLE){
+    //segm_end is the string length
+    record.segm_begin = builder.AddString(strings + record.segm_begin, record.segm_end);
+  }
+  builder.annotations.push_back(record);
+}
+
+template<typename T>
+void WriteSection(std::ofstream& ofs, ShardFooter& footer, ShardSection section, const std::vector<T>& values, uint64_t& offset){
+  footer.sections[section].offset = offset;
+  footer.sections[section].count = values.size();
+  footer.sections[section].element_size = sizeof(T);
+  ofs.write(reinterpret_cast<const char*>(values.data()), values.size() * sizeof(T));
+  offset += values.size() * sizeof(T);
+}
+
+bool ReadAt(int fd, char* dst, uint64_t size, uint64_t offset){
+  while(size > 0){
+    ssize_t n = pread(fd, dst, size, offset);
+    if(n <= 0)
+      return false;
+    dst += n;
+    size -= n;
+    offset += n;
+  }
+  return true;
+}
+
+}//namespace
+
+ShardWriter::ShardWriter(const std::string& path)
+                        :path_(path),
+                         ofs_(path + ".tmp", std::ios::binary | std::ios::trunc),
+                         offset_(0){}
+
+void ShardWriter::Add(const coco::COCO& coco, int image_id, const std::vector<unsigned char>& bytes){
+  const coco::ImageRecord* img = coco.FindImage(image_id);
+  assert(img);
+  if(targets_.categories.empty()){
+    for(auto& cat : coco.categories)
+      AppendCategory(targets_, cat, coco.strings.data());
+  }
+  AppendImage(targets_, *img, coco.strings.data());
+  for(auto& ann : coco.ImageAnnotations(image_id))
+    AppendAnnotation(targets_, ann, coco.coords.data(), coco.rings.data(), coco.counts.data(), coco.strings.data());
+
+  ShardEntry entry;
+  entry.image_id = image_id;
+  entry.reserved = 0;
+  entry.offset = offset_;
+  entry.size = bytes.size();
+  entries_.push_back(entry);
+  ofs_.write(reinterpret_cast<const char*>(bytes.data()), bytes.size());
+  offset_ += bytes.size();
+}
+
+bool ShardWriter::Close(){
+  ShardFooter footer;
+  std::memset(&footer, 0, sizeof(footer));
+  std::memcpy(footer.magic, SHARD_MAGIC, sizeof(SHARD_MAGIC));
+  footer.version = SHARD_VERSION;
+  footer.byte_order = coco::CACHE_BYTE_ORDER;
+
+  uint64_t offset = offset_;
+  WriteSection(ofs_, footer, SHARD_IMAGES, targets_.images, offset);
+  WriteSection(ofs_, footer, SHARD_ANNOTATIONS, targets_.annotations, offset);
+  WriteSection(ofs_, footer, SHARD_CATEGORIES, targets_.categories, offset);
+  WriteSection(ofs_, footer, SHARD_COORDS, targets_.coords, offset);
+  WriteSection(ofs_, footer, SHARD_RINGS, targets_.rings, offset);
+  WriteSection(ofs_, footer, SHARD_COUNTS, targets_.counts, offset);
+  WriteSection(ofs_, footer, SHARD_STRINGS, targets_.strings, offset);
+  WriteSection(ofs_, footer, SHARD_ENTRIES, entries_, offset);
+  ofs_.write(reinterpret_cast<const char*>(&footer), sizeof(footer));
+  ofs_.close();
+  if(!ofs_.good() || std::rename((path_ + ".tmp").c_str(), path_.c_str()) != 0){
+    std::remove((path_ + ".tmp").c_str());
+    return false;
+  }
+  return true;
+}
+
+size_t ShardWriter::size() const{
+  return entries_.size();
+}
+
+uint64_t ShardWriter::bytes() const{
+  return offset_;
+}
+
+ShardReader::ShardReader(const std::string& path) :path_(path), fd_(-1), size_(0), reads_(0){
+  fd_ = open(path.c_str(), O_RDONLY);
+  if(fd_ < 0)
+    return;
+  struct stat st;
+  bool valid = fstat(fd_, &st) == 0 && static_cast<uint64_t>(st.st_size) >= sizeof(ShardFooter);
+  if(valid){
+    size_ = st.st_size;
+    valid = ReadAt(fd_, reinterpret_cast<char*>(&footer_), sizeof(footer_), size_ - sizeof(footer_))
+            && std::memcmp(footer_.magic, SHARD_MAGIC, sizeof(SHARD_MAGIC)) == 0
+            && footer_.version == SHARD_VERSION
+            && footer_.byte_order == coco::CACHE_BYTE_ORDER
+            && ReadSection(SHARD_ENTRIES, entries_);
+  }
+  for(auto& entry : entries_)
+    valid = valid && entry.offset + entry.size <= footer_.sections[SHARD_IMAGES].offset;
+  if(!valid){
+    std::cout << "invalid shard " << path << "\n";
+    entries_.clear();
+    close(fd_);
+    fd_ = -1;
+    return;
+  }
+  //images are mostly read in file order, a pass over the shard can use the larger readahead
+  posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+}
+
+ShardReader::~ShardReader(){
+  if(fd_ >= 0)
+    close(fd_);
+}
+
+bool ShardReader::valid() const{
+  return fd_ >= 0;
+}
+
+template<typename T>
+bool ShardReader::ReadSection(ShardSection section, std::vector<T>& values) const{
+  const coco::CacheSectionEntry& entry = footer_.sections[section];
+  if(entry.element_size != sizeof(T) || entry.offset + entry.count * sizeof(T) > size_)
+    return false;
+  values.resize(entry.count);
+  return ReadAt(fd_, reinterpret_cast<char*>(values.data()), entry.count * sizeof(T), entry.offset);
+}
+
+bool ShardReader::ReadTargets(coco::IndexBuilder& builder) const{
+  if(!valid())
+    return false;
+  std::vector<coco::ImageRecord> images;
+  std::vector<coco::AnnotationRecord> annotations;
+  std::vector<coco::CategoryRecord> categories;
+  std::vector<double> coords;
+  std::vector<uint32_t> rings, counts;
+  std::vector<char> strings;
+  if(!ReadSection(SHARD_IMAGES, images) || !ReadSection(SHARD_ANNOTATIONS, annotations) || !ReadSection(SHARD_CATEGORIES, categories)
+     || !ReadSection(SHARD_COORDS, coords) || !ReadSection(SHARD_RINGS, rings) || !ReadSection(SHARD_COUNTS, counts) || !ReadSection(SHARD_STRINGS, strings))
+    return false;
+
+  builder.images.reserve(builder.images.size() + images.size());
+  builder.annotations.reserve(builder.annotations.size() + annotations.size());
+  builder.coords.reserve(builder.coords.size() + coords.size());
+  for(auto& img : images)
+    AppendImage(builder, img, strings.data());
+  if(builder.categories.empty()){
+    for(auto& cat : categories)
+      AppendCategory(builder, cat, strings.data());
+  }
+  for(auto& ann : annotations)
+    AppendAnnotation(builder, ann, coords.data(), rings.data(), counts.data(), strings.data());
+  return true;
+}
+
+bool ShardReader::Read(size_t entry, std::vector<unsigned char>& bytes){
+  if(!valid() || entry >= entries_.size())
+    return false;
+  if(reads_.fetch_add(1) % entries_.size() == 0)
+    posix_fadvise(fd_, 0, footer_.sections[SHARD_IMAGES].offset, POSIX_FADV_WILLNEED);
+  const ShardEntry& e = entries_[entry];
+  bytes.resize(e.size);
+  return ReadAt(fd_, reinterpret_cast<char*>(bytes.data()), e.size, e.offset);
+}
+
+const std::vector<ShardEntry>& ShardReader::entries() const{
+  return entries_;
+}
+
+const std::string& ShardReader::path() const{
+  return path_;
+}
+
+ShardSet::ShardSet(const std::string& directory) :directory_(directory){
+  std::vector<std::string> names;
+  DIR* dir = opendir(directory.c_str());
+  if(dir){
+    std::string extension(SHARD_EXTENSION);
+    while(struct dirent* file = readdir(dir)){
+      std::string name(file->d_name);
+      if(name.size() > extension.size() && name.compare(name.size() - extension.size(), extension.size(), extension) == 0)
+        names.push_back(name);
+    }
+    closedir(dir);
+  }
+  std::sort(names.begin(), names.end());
+  if(names.empty())
+    std::cout << "no shards in " << directory << "\n";
+
+  for(auto& name : names){
+    std::unique_ptr<ShardReader> shard(new ShardReader(directory + "/" + name));
+    if(!shard->valid()){
+      std::cout << "could not open shard " << shard->path() << "\n";
+      std::abort();
+    }
+    const std::vector<ShardEntry>& entries = shard->entries();
+    for(uint32_t i = 0; i < entries.size(); ++i)
+      locations_[entries[i].image_id] = std::make_pair(static_cast<int>(shards_.size()), i);
+    shards_.push_back(std::move(shard));
+  }
+}
+
+void ShardSet::LoadTargets(coco::COCO& coco) const{
+  coco::IndexBuilder builder;
+  //a shard left out of the index would still serve its images
+  for(auto& shard : shards_){
+    if(!shard->ReadTargets(builder)){
+      std::cout << "could not read targets of shard " << shard->path() << "\n";
+      std::abort();
+    }
+  }
+  coco.CreateIndex(builder);
+}
+
+bool ShardSet::Read(int image_id, std::vector<unsigned char>& bytes){
+  auto location = locations_.find(image_id);
+  if(location == locations_.end())
+    return false;
+  return shards_[location->second.first]->Read(location->second.second, bytes);
+}
+
+int ShardSet::Find(int image_id) const{
+  auto location = locations_.find(image_id);
+  return location == locations_.end() ? -1 : location->second.first;
+}
+
+size_t ShardSet::size() const{
+  return shards_.size();
+}
+
+const std::string& ShardSet::directory() const{
+  return directory_;
+}
+
+std::ostream& operator << (std::ostream& os, const ShardSet& shards){
+  os << "ShardSet(directory=" << shards.directory_ << ", shards=" << shards.shards_.size() << ", images=" << shards.locations_.size() << ")";
+  return os;
+}
+
+}//data
+}//rcnn
@@ -8,11 +8,16 @@ namespace data{
 Compose BuildTransforms(bool is_train){
   int min_size, max_size;
   float flip_horizontal_prob, flip_vertical_prob;
+  ColorJitter color_jitter;
   if(is_train){
     min_size = rcnn::config::GetCFG<int>({"INPUT", "MIN_SIZE_TRAIN"});
     max_size = rcnn::config::GetCFG<int>({"INPUT", "MAX_SIZE_TRAIN"});
     flip_horizontal_prob = 0.5;
     flip_vertical_prob = rcnn::config::GetCFG<float>({"INPUT", "VERTICAL_FLIP_PROB_TRAIN"});
+    color_jitter = ColorJitter(rcnn::config::GetCFG<float>({"INPUT", "RIGHTNESS"}),
+                               rcnn::config::GetCFG<float>({"INPUT", "CONTRAST"}),
+                               rcnn::config::GetCFG<float>({"INPUT", "SATURATION"}),
+                               rcnn::config::GetCFG<float>({"INPUT", "HUE"}));
   }
   else{
     min_size = rcnn::config::GetCFG<int>({"INPUT", "MIN_SIZE_TEST"});
@@ -21,6 +26,14 @@ Compose BuildTransforms(bool is_train){
     flip_vertical_prob = 0.0;
   }
 
+  if(rcnn::config::GetCFG<bool>({"INPUT", "FUSED_TRANSFORMS"})){
+    return Compose(std::make_shared<ResizeFlipNormalize>(min_size, max_size, flip_horizontal_prob, flip_vertical_prob,
+                                                         rcnn::config::GetCFG<std::vector<float>>({"INPUT", "PIXEL_MEAN"}),
+                                                         rcnn::config::GetCFG<std::vector<float>>({"INPUT", "PIXEL_STD"}),
+                                                         rcnn::config::GetCFG<bool>({"INPUT", "TO_BGR255"}),
+                                                         color_jitter));
+  }
+
   std::shared_ptr<TensorToTensorTransform> normalize_transform(new Normalize(torch::ArrayRef<float>(rcnn::config::GetCFG<std::vector<float>>({"INPUT", "PIXEL_MEAN"})),
                                             torch::ArrayRef<float>(rcnn::config::GetCFG<std::vector<float>>({"INPUT", "PIXEL_STD"})),
                                             rcnn::config::GetCFG<bool>({"INPUT", "TO_BGR255"})));
@@ -28,6 +41,8 @@ Compose BuildTransforms(bool is_train){
   return Compose(
     std::vector<std::shared_ptr<MatToMatTransform>>{
       std::make_shared<Resize>(min_size, max_size),
+      //after the resize, on fewer pixels
+      std::make_shared<ColorJitter>(color_jitter),
       std::make_shared<RandomHorizontalFlip>(flip_horizontal_prob),
       std::make_shared<RandomVerticalFlip>(flip_vertical_prob),
     },
@@ -2,6 +2,7 @@
 #include "opencv2/imgproc/imgproc.hpp"
 #include "opencv2/opencv.hpp"
 #include <algorithm>
+#include <cassert>
 #include <cmath>
 #include <cstdlib>
 #include <ctime>
@@ -20,7 +21,18 @@ Compose::Compose(std::vector<std::shared_ptr<MatToMatTransform>> MtoMtransforms,
                     std::srand(static_cast<unsigned int>(std::time(0)));
                   }
 
+Compose::Compose(std::shared_ptr<ResizeFlipNormalize> fused) :fused_(fused){
+  std::srand(static_cast<unsigned int>(std::time(0)));
+}
+
+std::shared_ptr<ResizeFlipNormalize> Compose::fused() const{
+  return fused_;
+}
+
 torch::data::Example<torch::Tensor, RCNNData> Compose::operator()(torch::data::Example<cv::Mat, RCNNData> input){
+  if(fused_)
+    return (*fused_)(input);
+
   torch::data::Example<torch::Tensor, RCNNData> tensor_rcnn;
   bool tensor_init = false;
 
@@ -62,7 +74,9 @@ std::pair<int, int> Resize::get_size(std::pair<int, int> image_size){
 torch::data::Example<cv::Mat, RCNNData> Resize::operator()(torch::data::Example<cv::Mat, RCNNData> input){
   int h, w;
   cv::Mat resized;
-  std::tie(h, w) = get_size(std::make_pair(input.data.cols, input.data.rows));
+  //sized from the target, the image may have been decoded smaller
+  std::pair<int64_t, int64_t> image_size = input.target.target.get_size();
+  std::tie(h, w) = get_size(std::make_pair(static_cast<int>(image_size.first), static_cast<int>(image_size.second)));
   cv::resize(input.data, resized, cv::Size(w, h));
   input.data = resized;
   input.target.target = input.target.target.Resize(std::make_pair(w, h));
@@ -91,6 +105,84 @@ torch::data::Example<cv::Mat, RCNNData> RandomVerticalFlip::operator()(torch::da
   return input;
 }
 
+namespace{
+
+float Uniform(float low, float high){
+  return low + (high - low) * static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX);
+}
+
+}//namespace
+
+ColorJitter::ColorJitter(float brightness, float contrast, float saturation, float hue)
+                        :brightness_(brightness),
+                         contrast_(contrast),
+                         saturation_(saturation),
+                         hue_(hue)
+{
+  //out of range factors turn the fused color transform into garbage
+  std::pair<const char*, float> factors[] = {{"INPUT.BRIGHTNESS", brightness}, {"INPUT.CONTRAST", contrast}, {"INPUT.SATURATION", saturation}, {"INPUT.HUE", hue}};
+  for(auto& factor : factors){
+    if(!(factor.second >= 0)){
+      std::cout << factor.first << " must not be negative, but is " << factor.second << "\n";
+      std::abort();
+    }
+  }
+  if(hue > 0.5){
+    std::cout << "INPUT.HUE must not be larger than 0.5, but is " << hue << "\n";
+    std::abort();
+  }
+}
+
+bool ColorJitter::enabled() const{
+  return brightness_ > 0 || contrast_ > 0 || saturation_ > 0 || hue_ > 0;
+}
+
+cv::Matx34f ColorJitter::Matrix(float brightness_factor, float contrast_factor, float saturation_factor, float hue_factor, float mean_gray){
+  //bgr to yiq and back, gray is (1, 1, 1) in bgr and (1, 0, 0) in yiq
+  cv::Matx33f to_yiq(0.114f, 0.587f, 0.299f,
+                     -0.322f, -0.274f, 0.596f,
+                     0.312f, -0.523f, 0.211f);
+  float angle = hue_factor * 2 * static_cast<float>(M_PI);
+  cv::Matx33f rotation(1, 0, 0,
+                       0, std::cos(angle), -std::sin(angle),
+                       0, std::sin(angle), std::cos(angle));
+  cv::Matx33f hue = to_yiq.inv() * rotation * to_yiq;
+  //blend with the gray level of every pixel
+  cv::Matx33f gray(0.114f, 0.587f, 0.299f,
+                   0.114f, 0.587f, 0.299f,
+                   0.114f, 0.587f, 0.299f);
+  cv::Matx33f saturation = cv::Matx33f::eye() * saturation_factor + gray * (1 - saturation_factor);
+  //contrast blends with the mean gray of the brightened image, both matrices keep gray pixels gray
+  cv::Matx33f linear = hue * saturation * (contrast_factor * brightness_factor);
+  float offset = (1 - contrast_factor) * brightness_factor * mean_gray;
+  return cv::Matx34f(linear(0, 0), linear(0, 1), linear(0, 2), offset,
+                     linear(1, 0), linear(1, 1), linear(1, 2), offset,
+                     linear(2, 0), linear(2, 1), linear(2, 2), offset);
+}
+
+cv::Mat ColorJitter::Apply(const cv::Mat& img) const{
+  assert(img.type() == CV_8UC3);
+  float brightness_factor = brightness_ > 0 ? Uniform(std::max(0.f, 1 - brightness_), 1 + brightness_) : 1;
+  float contrast_factor = contrast_ > 0 ? Uniform(std::max(0.f, 1 - contrast_), 1 + contrast_) : 1;
+  float saturation_factor = saturation_ > 0 ? Uniform(std::max(0.f, 1 - saturation_), 1 + saturation_) : 1;
+  float hue_factor = hue_ > 0 ? Uniform(-hue_, hue_) : 0;
+  float mean_gray = 0;
+  if(contrast_factor != 1){
+    cv::Scalar mean = cv::mean(img);
+    mean_gray = 0.114f * mean[0] + 0.587f * mean[1] + 0.299f * mean[2];
+  }
+  //never in place, the input may be shared with the image cache
+  cv::Mat adjusted;
+  cv::transform(img, adjusted, cv::Mat(Matrix(brightness_factor, contrast_factor, saturation_factor, hue_factor, mean_gray)));
+  return adjusted;
+}
+
+torch::data::Example<cv::Mat, RCNNData> ColorJitter::operator()(torch::data::Example<cv::Mat, RCNNData> input){
+  if(enabled())
+    input.data = Apply(input.data);
+  return input;
+}
+
 torch::data::Example<torch::Tensor, RCNNData> ToTensor::operator()(torch::data::Example<cv::Mat, RCNNData> input){
   torch::Tensor tensor_image = torch::from_blob(input.data.data, {1, input.data.rows, input.data.cols, 3}, torch::kByte);
   tensor_image = tensor_image.to(torch::kFloat);
@@ -122,6 +214,87 @@ torch::data::Example<torch::Tensor, RCNNData> Normalize::operator()(torch::data:
   return input;
 }
 
+ResizeFlipNormalize::ResizeFlipNormalize(int min_size, int max_size, float horizontal_flip_prob, float vertical_flip_prob,
+                                         std::vector<float> mean, std::vector<float> stddev, bool to_bgr255, ColorJitter color_jitter)
+                                        :resize_(min_size, max_size),
+                                         color_jitter_(color_jitter),
+                                         horizontal_flip_prob_(horizontal_flip_prob),
+                                         vertical_flip_prob_(vertical_flip_prob),
+                                         table_(3 * 256)
+{
+  assert(mean.size() == 3 && stddev.size() == 3);
+  //same float operations as ToTensor and Normalize
+  for(int c = 0; c < 3; ++c){
+    for(int v = 0; v < 256; ++v){
+      float value = static_cast<float>(v);
+      if(!to_bgr255)
+        value = value / 255;
+      table_[c * 256 + v] = (value - mean[c]) / stddev[c];
+    }
+  }
+}
+
+torch::data::Example<torch::Tensor, RCNNData> ResizeFlipNormalize::operator()(torch::data::Example<cv::Mat, RCNNData> input){
+  bool flip_horizontal, flip_vertical;
+  std::tie(flip_horizontal, flip_vertical) = Prepare(input);
+  int h = input.data.rows, w = input.data.cols;
+  torch::Tensor tensor_image = torch::empty({1, 3, h, w}, torch::kF32);
+  WritePlanes(input.data, flip_horizontal, flip_vertical, tensor_image.data<float>(), w, static_cast<int64_t>(h) * w);
+  return torch::data::Example<torch::Tensor, RCNNData> {tensor_image, input.target};
+}
+
+std::pair<bool, bool> ResizeFlipNormalize::Prepare(torch::data::Example<cv::Mat, RCNNData>& input){
+  int h, w;
+  std::pair<int64_t, int64_t> image_size = input.target.target.get_size();
+  std::tie(h, w) = resize_.get_size(std::make_pair(static_cast<int>(image_size.first), static_cast<int>(image_size.second)));
+  if(h != input.data.rows || w != input.data.cols){
+    cv::Mat resized;
+    cv::resize(input.data, resized, cv::Size(w, h));
+    input.data = resized;
+  }
+  input.target.target = input.target.target.Resize(std::make_pair(w, h));
+  if(color_jitter_.enabled())
+    input.data = color_jitter_.Apply(input.data);
+
+  //draws in the order of RandomHorizontalFlip and RandomVerticalFlip
+  bool flip_horizontal = static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX) < horizontal_flip_prob_;
+  if(flip_horizontal)
+    input.target.target = input.target.target.Transpose(structures::FLIP_LEFT_RIGHT);
+  bool flip_vertical = static_cast<float>(std::rand()) / static_cast<float>(RAND_MAX) < vertical_flip_prob_;
+  if(flip_vertical)
+    input.target.target = input.target.target.Transpose(structures::FLIP_TOP_BOTTOM);
+  return std::make_pair(flip_horizontal, flip_vertical);
+}
+
+void ResizeFlipNormalize::WritePlanes(const cv::Mat& img, bool flip_horizontal, bool flip_vertical, float* dst, int64_t row_stride, int64_t plane_stride) const{
+  assert(img.type() == CV_8UC3);
+  const float* table_0 = table_.data();
+  const float* table_1 = table_0 + 256;
+  const float* table_2 = table_1 + 256;
+  int rows = img.rows, cols = img.cols;
+  for(int y = 0; y < rows; ++y){
+    const uchar* src = img.ptr<uchar>(flip_vertical ? rows - 1 - y : y);
+    float* out_0 = dst + y * row_stride;
+    float* out_1 = out_0 + plane_stride;
+    float* out_2 = out_1 + plane_stride;
+    if(flip_horizontal){
+      const uchar* pixel = src + 3 * (cols - 1);
+      for(int x = 0; x < cols; ++x, pixel -= 3){
+        out_0[x] = table_0[pixel[0]];
+        out_1[x] = table_1[pixel[1]];
+        out_2[x] = table_2[pixel[2]];
+      }
+    }
+    else{
+      const uchar* pixel = src;
+      for(int x = 0; x < cols; ++x, pixel += 3){
+        out_0[x] = table_0[pixel[0]];
+        out_1[x] = table_1[pixel[1]];
+        out_2[x] = table_2[pixel[2]];
+      }
+    }
+  }
+}
 
 }//data
 }//rcnnㅊ
\ No newline at end of file
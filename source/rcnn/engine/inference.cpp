@@ -24,9 +24,12 @@ void inference(){
   //Build Dataset
   vector<string> dataset_list = GetCFG<std::vector<std::string>>({"DATASETS", "TEST"});
   Compose transforms = BuildTransforms(false);
-  BatchCollator collate = BatchCollator(GetCFG<int>({"DATALOADER", "SIZE_DIVISIBILITY"}));
+  shared_ptr<BatchBufferPool> batch_pool;
+  if(GetCFG<int64_t>({"DATALOADER", "BATCH_POOL_BYTES"}) > 0)
+    batch_pool = make_shared<BatchBufferPool>(GetCFG<int64_t>({"DATALOADER", "BATCH_POOL_BYTES"}));
+  BatchCollator collate = BatchCollator(transforms, GetCFG<int>({"DATALOADER", "SIZE_DIVISIBILITY"}), batch_pool);
   COCODataset coco = BuildDataset(dataset_list, false);
-  auto data = coco.map(transforms).map(collate);
+  auto data = coco.map(collate);
   shared_ptr<torch::data::samplers::Sampler<>> sampler = make_batch_data_sampler(coco, false, 0);
   
   int images_per_batch = GetCFG<int64_t>({"TEST", "IMS_PER_BATCH"});
@@ -50,8 +53,23 @@ void inference(){
   Timer total_time = Timer();
   Timer inference_timer = Timer();
 
+  //online evaluation keeps the matches of each image instead of its predictions
+  shared_ptr<COCOOnlineEvaluation> evaluation;
+  function<void(int64_t, BoxList&)> on_result;
+  if(GetCFG<bool>({"TEST", "ONLINE_EVALUATION"})){
+    evaluation = make_shared<COCOOnlineEvaluation>(coco, iou_types);
+    int period = GetCFG<int>({"TEST", "ONLINE_EVALUATION_PERIOD"});
+    on_result = [evaluation, period](int64_t image_id, BoxList& prediction){
+      evaluation->Add(image_id, prediction);
+      if(period > 0 && evaluation->count() % period == 0){
+        cout << "Running evaluation on " << evaluation->count() << " images\n";
+        PrintCOCOResults(evaluation->Summarize());
+      }
+    };
+  }
+
   total_time.tic();
-  map<int64_t, BoxList> predictions = compute_on_dataset(model, data_loader, device, inference_timer, coco.size().value());
+  map<int64_t, BoxList> predictions = compute_on_dataset(model, data_loader, device, inference_timer, coco.size().value(), GetCFG<int>({"DATALOADER", "PREFETCH_DEPTH"}), on_result);
 
   auto total_time_ = total_time.toc();
   string total_time_str = total_time.avg_time_str();
@@ -59,11 +77,16 @@ void inference(){
   cout << "Total run time: " << total_time_str << " (" << total_time_ * /*device num*/1 / coco.size().value() << " s / img per device, on 1 devices)\n";
 
   cout << "Model inference time: " << inference_timer.total_time.count() << "s (" << inference_timer.total_time.count() / coco.size().value() << " s / img per device, on 1 devices)\n";
-  rcnn::config::DatasetCatalog dataset_catalog = rcnn::config::DatasetCatalog();
-  std::string dataset_name, img_dir, ann_file;
-  std::tie(dataset_name, img_dir, ann_file) = dataset_catalog[dataset_list[0]];
+  if(coco.coco_detection.image_cache_)
+    cout << *coco.coco_detection.image_cache_ << "\n";
+  if(batch_pool)
+    cout << *batch_pool << "\n";
+  cout << *collate.padding_ << "\n";
 
-  DoCOCOEvaluation(coco, predictions, output_folder, iou_types, ann_file);
+  if(evaluation)
+    PrintCOCOResults(evaluation->Summarize());
+  else
+    DoCOCOEvaluation(coco, predictions, output_folder, iou_types);
 }
 
 }
@@ -10,6 +10,7 @@
 #include <metric_logger.h>
 #include <checkpoint.h>
 #include <collate_batch.h>
+#include <prefetcher.h>
 
 #include <solver_build.h>
 #include <torch/torch.h>
@@ -58,12 +59,16 @@ void do_train(){
   scheduler.set_last_epoch(start_iter);
   vector<string> dataset_list = GetCFG<std::vector<std::string>>({"DATASETS", "TRAIN"});
   Compose transforms = BuildTransforms(true);
-  BatchCollator collate = BatchCollator(GetCFG<int>({"DATALOADER", "SIZE_DIVISIBILITY"}));
+  shared_ptr<BatchBufferPool> batch_pool;
+  if(GetCFG<int64_t>({"DATALOADER", "BATCH_POOL_BYTES"}) > 0)
+    batch_pool = make_shared<BatchBufferPool>(GetCFG<int64_t>({"DATALOADER", "BATCH_POOL_BYTES"}));
+  int mask_raster_resolution = GetCFG<bool>({"MODEL", "MASK_ON"}) ? GetCFG<int>({"MODEL", "ROI_MASK_HEAD", "TARGET_RASTER_RESOLUTION"}) : 0;
+  BatchCollator collate = BatchCollator(transforms, GetCFG<int>({"DATALOADER", "SIZE_DIVISIBILITY"}), batch_pool, mask_raster_resolution);
   int images_per_batch = GetCFG<int64_t>({"SOLVER", "IMS_PER_BATCH"});
-  COCODataset coco = BuildDataset(dataset_list, true);
+  ConcatDataset datasets = BuildConcatDataset(dataset_list, true);
 
-  auto data = coco.map(transforms).map(collate);
-  shared_ptr<torch::data::samplers::Sampler<>> sampler = make_batch_data_sampler(coco, true, start_iter);
+  auto data = datasets.map(collate);
+  shared_ptr<torch::data::samplers::Sampler<>> sampler = make_concat_batch_sampler(datasets, start_iter);
   
   torch::data::DataLoaderOptions options(images_per_batch);
   options.workers(GetCFG<int64_t>({"DATALOADER", "NUM_WORKERS"}));
@@ -72,7 +77,15 @@ void do_train(){
   model->to(device);
   model->train();
   cout << "Start training\n";
-  for(auto& i : *data_loader){
+  #ifdef WITH_CUDA
+  //data_parallel scatters the batch itself
+  torch::Device prefetch_device(torch::kCPU);
+  #else
+  torch::Device prefetch_device = device;
+  #endif
+  auto prefetcher = MakePrefetcher(*data_loader, prefetch_device, GetCFG<int>({"DATALOADER", "PREFETCH_DEPTH"}));
+  while(torch::optional<batch> next = prefetcher->Next()){
+    batch& i = *next;
     data_time = chrono::system_clock::now() - end;
     iteration += 1;
     scheduler.step();
@@ -83,11 +96,9 @@ void do_train(){
     std::tie(loss, loss_map) = data_parallel(model, get<0>(i), get<1>(i));
 
     #else
-    ImageList images = get<0>(i).to(device);
-    vector<BoxList> targets;
-    
-    for(auto& target : get<1>(i))
-      targets.push_back(target.To(device));
+    //already on device
+    ImageList images = get<0>(i);
+    vector<BoxList> targets = get<1>(i);
 
     map<string, torch::Tensor> loss_map = model->forward<map<string, torch::Tensor>>(images, targets);
 
@@ -118,6 +129,18 @@ void do_train(){
     eta_string = to_string(days) + " day " + to_string(hours) + " h " + to_string(minutes) + " m";
     if(iteration % 20 == 0 || iteration == max_iter){
       cout << "eta: " << eta_string << meters.delimiter_ << "iter: " << iteration << meters.delimiter_ << meters << meters.delimiter_ << "lr: " << to_string(optimizer.get_lr()) << meters.delimiter_ << "max mem: " << "none\n";
+      for(size_t m = 0; m < datasets.num_members(); ++m){
+        if(datasets.opened(m) && datasets.member(m).coco_detection.image_cache_)
+          cout << datasets.name(m) << " " << *datasets.member(m).coco_detection.image_cache_ << "\n";
+      }
+      if(batch_pool)
+        cout << *batch_pool << "\n";
+      cout << *prefetcher << "\n";
+    }
+    //padding of the batches since the last checkpoint period, grouped batches do not line up with dataset passes
+    if(iteration % checkpoint_period == 0){
+      cout << "padding over " << checkpoint_period << " iters" << meters.delimiter_ << *collate.padding_ << "\n";
+      collate.padding_->Reset();
     }
     if(iteration % checkpoint_period == 0)
       check_point.save("model_" + to_string(iteration) + ".pth", iteration);
@@ -2,6 +2,7 @@
 #include <algorithm>
 #include <cassert>
 #include "mask.h"
+#include "coco_results.h"
 #include "defaults.h"
 
 
@@ -177,18 +178,9 @@ std::vector<rcnn::structures::BoxList> MaskPostProcessorImpl::forward(torch::Ten
 std::vector<rcnn::structures::BoxList> MaskPostProcessorCOCOFormatImpl::forward(torch::Tensor& x, std::vector<rcnn::structures::BoxList>& boxes){
   std::vector<rcnn::structures::BoxList> results = MaskPostProcessorImpl::forward(x, boxes);
   for(auto& result : results){
-    torch::Tensor masks = result.GetField("mask").cpu();
-    std::vector<coco::RLEstr> rles;
-    for(int i = 0; i < masks.size(0); ++i){
-      coco::byte* mask_array = new coco::byte[masks.numel()];
-      torch::Tensor masks_reshape = masks.reshape({-1});
-      for(int i = 0; i < masks_reshape.numel(); ++i)
-        mask_array[i] = static_cast<coco::byte>(masks_reshape[i].item<float>());
-      rles.push_back(coco::encode(mask_array, masks.size(1), masks.size(2), masks.size(0))[0]);
-      delete[] mask_array;
-    }
-
-    // for(auto& rle : rles)
+    //(N, 1, H, W) masks are encoded from their bytes, one rle per detection
+    torch::Tensor masks = result.GetField("mask").to(torch::kCPU).to(torch::kU8).contiguous();
+    std::vector<coco::RLEstr> rles = coco::EncodeMasks(masks.data<uint8_t>(), masks.size(0), masks.size(-2), masks.size(-1));
     result.AddField("mask", rles);
   }
 
@@ -1,30 +1,52 @@
 #include "roi_heads/mask_head/loss.h"
 #include <cassert>
 #include "cat.h"
+#include "roi_align.h"
 
 
 namespace rcnn{
 namespace modeling{
 
 torch::Tensor ProjectMasksOnBoxes(rcnn::structures::SegmentationMask segmentation_masks, rcnn::structures::BoxList proposals, int discretization_size){
-  std::vector<torch::Tensor> masks;
   int M = discretization_size;
   auto device = proposals.get_bbox().device();
   proposals = proposals.Convert("xyxy");
   assert(segmentation_masks.Length() == proposals.Length());
 
-  torch::Tensor proposals_tensor = proposals.get_bbox().to(torch::Device("CPU"));
-  for(int i = 0; i < proposals.Length(); ++i){
-    rcnn::structures::SegmentationMask cropped_mask = segmentation_masks.Crop(proposals_tensor.select(0, i));
-    rcnn::structures::SegmentationMask scaled_mask = cropped_mask.Resize({M, M});
-    torch::Tensor mask = scaled_mask.GetMaskTensor();
-    masks.push_back(mask);
-  }
+  if(proposals.Length() == 0)
+    return torch::empty({0}).to(torch::kF32).to(device);
+  //the mask of target i cropped by proposal i, rasterized straight into M x M
+  return segmentation_masks.ProjectOnBoxes(proposals.get_bbox(), M).to(device);
+}
+
+torch::Tensor CropMaskRasters(torch::Tensor rasters, torch::Tensor target_boxes, rcnn::structures::BoxList proposals, int discretization_size){
+  int M = discretization_size;
+  auto device = proposals.get_bbox().device();
+  proposals = proposals.Convert("xyxy");
+  assert(rasters.size(0) == proposals.Length() && target_boxes.size(0) == proposals.Length());
 
-  if(masks.size() == 0)
+  if(proposals.Length() == 0)
     return torch::empty({0}).to(torch::kF32).to(device);
-  return torch::stack(masks, 0).to(device).to(torch::kF32);
-    
+  //rasters span the integer crop of their target box like ProjectMasksOnBoxes,
+  //the integer crop of the proposal is mapped into the raster and sampled by ROIAlign
+  int64_t resolution = rasters.size(1);
+  torch::Tensor targets_xyxy = target_boxes.to(device).to(torch::kF32).to(torch::kI64).to(torch::kF32);
+  torch::Tensor proposals_xyxy = proposals.get_bbox().to(torch::kF32).to(torch::kI64).to(torch::kF32);
+  torch::Tensor target_origin = targets_xyxy.slice(1, 0, 2);
+  torch::Tensor target_size = (targets_xyxy.slice(1, 2, 4) - target_origin).clamp_min(1);
+  torch::Tensor proposal_origin = proposals_xyxy.slice(1, 0, 2);
+  torch::Tensor proposal_size = (proposals_xyxy.slice(1, 2, 4) - proposal_origin).clamp_min(1);
+  torch::Tensor scale = target_size.reciprocal() * resolution;
+  torch::Tensor start = (proposal_origin - target_origin) * scale;
+  torch::Tensor end = start + proposal_size * scale;
+  //ROIAlign samples pixel i at i, pixel i of the raster covers [i, i + 1)
+  //and samples within a pixel of the edge are clamped to it, so a zero border keeps
+  //the mask from bleeding outside the target box
+  torch::Tensor padded = torch::constant_pad_nd(rasters.to(device).to(torch::kF32), {1, 1, 1, 1}, 0);
+  torch::Tensor batch_index = torch::arange(proposals.Length(), proposals_xyxy.options()).unsqueeze(1);
+  torch::Tensor rois = torch::cat({batch_index, start + 0.5, end + 0.5}, 1).contiguous();
+  torch::Tensor sampled = rcnn::layers::ROIAlign_forward(padded.unsqueeze(1).contiguous(), rois, 1.0, M, M, 2);
+  return (sampled.squeeze(1) >= 0.5).to(torch::kF32);
 }
 
 MaskRCNNLossComputation::MaskRCNNLossComputation(Matcher* proposal_matcher, int discretization_size) 
@@ -101,11 +123,20 @@ std::pair<std::vector<torch::Tensor>, std::vector<torch::Tensor>> MaskRCNNLossCo
     labels_per_image.masked_fill_(ignore_inds, -1);
 
     torch::Tensor positive_inds = torch::nonzero(labels_per_image > 0).squeeze(1);
-    rcnn::structures::SegmentationMask* segmentation_mask = matched_targets.GetMasksField("masks");
-    rcnn::structures::SegmentationMask segmentation_mask_positive = (*segmentation_mask)[positive_inds];
-
     rcnn::structures::BoxList positive_proposals = proposals[i][positive_inds];
-    torch::Tensor masks_per_image = ProjectMasksOnBoxes(segmentation_mask_positive, positive_proposals, discretization_size_);
+    torch::Tensor masks_per_image;
+    if(targets[i].HasField("mask_rasters")){
+      //the loader workers rasterized every target, only a crop and resize is left here
+      torch::Tensor positive_targets = matched_idxs.index_select(0, positive_inds);
+      masks_per_image = CropMaskRasters(targets[i].GetField("mask_rasters").index_select(0, positive_targets),
+                                        targets[i].Convert("xyxy").get_bbox().index_select(0, positive_targets),
+                                        positive_proposals, discretization_size_);
+    }
+    else{
+      rcnn::structures::SegmentationMask* segmentation_mask = matched_targets.GetMasksField("masks");
+      rcnn::structures::SegmentationMask segmentation_mask_positive = (*segmentation_mask)[positive_inds];
+      masks_per_image = ProjectMasksOnBoxes(segmentation_mask_positive, positive_proposals, discretization_size_);
+    }
     labels.push_back(labels_per_image);
     masks.push_back(masks_per_image);
   }
@@ -126,8 +157,10 @@ torch::Tensor MaskRCNNLossComputation::operator()(std::vector<rcnn::structures::
   if(mask_targets_vec.numel() == 0)
     return mask_logits.sum() * 0;
 
-  return torch::binary_cross_entropy_with_logits(mask_logits.index_select(0, positive_inds).index_select(1, labels_pos), 
-                                                 mask_targets_vec, {}, {}, Reduction::Mean);
+  //the logits of the label of each positive proposal
+  int64_t num_classes = mask_logits.size(1);
+  torch::Tensor logits_pos = mask_logits.reshape({-1, mask_logits.size(2), mask_logits.size(3)}).index_select(0, positive_inds * num_classes + labels_pos);
+  return torch::binary_cross_entropy_with_logits(logits_pos, mask_targets_vec, {}, {}, Reduction::Mean);
 
 }
 
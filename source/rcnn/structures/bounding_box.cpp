@@ -332,6 +332,11 @@ BoxList BoxList::To(const torch::Device device){
   for(auto i = extra_fields_.begin(); i != extra_fields_.end(); ++i){
     bbox.AddField(i->first, (i->second).to(device));
   }
+  //polygons stay on the cpu
+  if(rles_.size())
+    bbox.set_rles(rles_);
+  if(masks_)
+    bbox.set_masks(new SegmentationMask(*masks_));
   return bbox;
 }
 
@@ -343,9 +348,10 @@ BoxList BoxList::operator[](torch::Tensor item){
     for(auto i = extra_fields_.begin(); i != extra_fields_.end(); ++i){
       auto size_vector = (i->second).sizes().vec();
       size_vector[0] = -1;
-      while(size_vector.size() != item.sizes().size())
-        item.unsqueeze_(-1);
-      bbox.AddField(i->first, (i->second).masked_select(item).reshape(torch::IntArrayRef(size_vector)));
+      torch::Tensor field_item = item;
+      while(size_vector.size() != field_item.sizes().size())
+        field_item = field_item.unsqueeze(-1);
+      bbox.AddField(i->first, (i->second).masked_select(field_item).reshape(torch::IntArrayRef(size_vector)));
     }
     if(rles_.size()){
       std::vector<coco::RLEstr> tmp;
@@ -435,10 +441,10 @@ BoxList BoxList::CopyWithFields(const std::vector<std::string> fields, const boo
   BoxList bbox = BoxList(bbox_, size_, mode_);
   for(auto i = fields.begin(); i != fields.end(); ++i){
     if(HasField(*i)){
-      if((*i).compare("mask") && rles_.size() > 0)
+      if((*i).compare("mask") == 0 && rles_.size() > 0)
         bbox.AddField("mask", rles_);
-      else if((*i).compare("masks") && masks_)
-        bbox.AddField("masks", masks_);
+      else if((*i).compare("masks") == 0 && masks_)
+        bbox.AddField("masks", new SegmentationMask(*masks_));
       else
         bbox.AddField(*i, GetField(*i));
     }
@@ -4,6 +4,7 @@
 #include <algorithm>
 #include <cassert>
 #include <iostream>
+#include <utility>
 
 
 namespace rcnn{
@@ -20,195 +21,168 @@ torch::Tensor ArrayToTensor(coco::Masks mask){
   return mask_tensor.reshape({static_cast<int64_t>(mask._n), static_cast<int64_t>(mask._w), static_cast<int64_t>(mask._h)}).permute({2, 1, 0}).squeeze(2);//fortran order h, w, n
 }
 
-Polygons::Polygons(std::vector<std::vector<double>> polygons, std::pair<int, int> size, std::string mode)
-                  :mode_(mode),
-                   size_(size)
+SegmentationMask::SegmentationMask(std::vector<std::vector<std::vector<double>>> polygons, std::pair<int, int> size, std::string mode)
+                                  :ring_offsets_{0},
+                                   instance_rings_{0},
+                                   size_(size),
+                                   mode_(mode)
 {
-  for(auto& poly : polygons){
-    torch::Tensor tmp = torch::empty({static_cast<int64_t>(poly.size())}).to(torch::kF64);
-    double* data = tmp.data<double>();
-    for(size_t i = 0; i < poly.size(); ++i){
-      data[i] = poly[i];
+  for(auto& instance : polygons){
+    for(auto& ring : instance){
+      coords_.insert(coords_.end(), ring.begin(), ring.end());
+      ring_offsets_.push_back(coords_.size());
     }
-    polygons_.push_back(tmp);
+    instance_rings_.push_back(ring_offsets_.size() - 1);
   }
 }
 
-Polygons::Polygons(std::vector<torch::Tensor> polygons, std::pair<int, int> size, std::string mode)
-                  :mode_(mode),
-                   size_(size),
-                   polygons_(polygons){}
-
-Polygons::Polygons(const Polygons& other) :polygons_(other.polygons_), size_(other.size_), mode_(other.mode_){}
-
-Polygons Polygons::Transpose(const Flip method){
-  std::vector<torch::Tensor> flipped_polygons;
-  int width = std::get<0>(size_), height = std::get<1>(size_);
-  int dim, idx;
-  if(method == FLIP_LEFT_RIGHT){
-    dim = width;
-    idx = 0;
-  }
-  else{
-    dim = height;
-    idx = 1;
-  }
-  for(auto& poly : polygons_){
-    torch::Tensor p = poly.clone();
-    p.slice(0, idx, static_cast<int64_t>(p.size(0)) + 1, 2) = dim - poly.slice(0, idx, static_cast<int64_t>(p.size(0)) + 1, 2) - 1;
-    flipped_polygons.push_back(p);
-  }
-  return Polygons(flipped_polygons, size_, mode_);
+SegmentationMask::SegmentationMask(std::vector<float> coords, std::vector<int64_t> ring_offsets, std::vector<int64_t> instance_rings, std::pair<int, int> size, std::string mode)
+                                  :coords_(std::move(coords)),
+                                   ring_offsets_(std::move(ring_offsets)),
+                                   instance_rings_(std::move(instance_rings)),
+                                   size_(size),
+                                   mode_(mode)
+{
+  assert(!ring_offsets_.empty() && ring_offsets_.back() == static_cast<int64_t>(coords_.size()));
+  assert(!instance_rings_.empty() && instance_rings_.back() == static_cast<int64_t>(ring_offsets_.size()) - 1);
 }
 
-Polygons Polygons::Crop(const std::tuple<int, int, int, int> box){
-  int w = std::get<2>(box) - std::get<0>(box), h = std::get<3>(box) - std::get<1>(box);
-  w = std::max(w, 1);
-  h = std::max(h, 1);
-
-  std::vector<torch::Tensor> cropped_polygons;
-  for(auto& poly : polygons_){
-    torch::Tensor p = poly.clone();
-    p.slice(0, 0, static_cast<int64_t>(p.size(0)) + 1, 2) = p.slice(0, 0, static_cast<int64_t>(p.size(0)) + 1, 2) - std::get<0>(box);
-    p.slice(0, 1, static_cast<int64_t>(p.size(0)) + 1, 2) = p.slice(0, 1, static_cast<int64_t>(p.size(0)) + 1, 2) - std::get<1>(box);
-    cropped_polygons.push_back(p);
-  }
-
-  return Polygons(cropped_polygons, std::make_pair(w, h), mode_);
+SegmentationMask SegmentationMask::WithCoords(std::vector<float> coords, std::pair<int, int> size) const{
+  return SegmentationMask(std::move(coords), ring_offsets_, instance_rings_, size, mode_);
 }
 
-Polygons Polygons::Resize(std::pair<int, int> size){
-  std::pair<float, float> ratios = std::make_pair(
-    static_cast<float>(std::get<0>(size)) / static_cast<float>(std::get<0>(size_)),
-    static_cast<float>(std::get<1>(size)) / static_cast<float>(std::get<1>(size_))
-  );
-  if(std::get<0>(ratios) == std::get<1>(ratios)){
-    float ratio = std::get<0>(ratios);
-    std::vector<torch::Tensor> scaled_polys;
-    for(auto& poly : polygons_)
-      poly.mul(ratio);
-    return Polygons(scaled_polys, size, mode_);
-  }
-  float ratio_w = std::get<0>(ratios), ratio_h = std::get<1>(ratios);
-  std::vector<torch::Tensor> scaled_polygons;
-  for(auto& poly : polygons_){
-    torch::Tensor p = poly.clone();
-    p.slice(0, 0, -1, 2).mul_(ratio_w);
-    p.slice(0, 1, -1, 2).mul_(ratio_h);
-    scaled_polygons.push_back(p);
-  }
-  return Polygons(scaled_polygons, size, mode_);
+SegmentationMask SegmentationMask::Transpose(const Flip method){
+  int width = std::get<0>(size_), height = std::get<1>(size_);
+  std::vector<float> flipped(coords_);
+  float dim = method == FLIP_LEFT_RIGHT ? width : height;
+  for(size_t i = method == FLIP_LEFT_RIGHT ? 0 : 1; i < flipped.size(); i += 2)
+    flipped[i] = dim - flipped[i] - 1;
+  return WithCoords(std::move(flipped), size_);
 }
 
-torch::Tensor Polygons::GetMaskTensor(){
-  int width = std::get<0>(size_), height = std::get<1>(size_);
-  std::vector<std::vector<double>> pl;
-  for(auto& poly : polygons_){
-    std::vector<double> inner;
-    for(int i = 0; i < poly.size(0); ++i)
-      inner.push_back(poly.select(0, i).item<double>());
-    pl.push_back(inner);
+SegmentationMask SegmentationMask::Crop(const std::tuple<int, int, int, int> box){
+  int w = std::max(std::get<2>(box) - std::get<0>(box), 1), h = std::max(std::get<3>(box) - std::get<1>(box), 1);
+  std::vector<float> cropped(coords_.size());
+  float x0 = std::get<0>(box), y0 = std::get<1>(box);
+  for(size_t i = 0; i < cropped.size(); i += 2){
+    cropped[i] = coords_[i] - x0;
+    cropped[i + 1] = coords_[i + 1] - y0;
   }
-  std::vector<coco::RLEstr> rles = coco::frPoly(pl, height, width);
-  coco::RLEstr rle = coco::merge(rles);
-  torch::Tensor mask = ArrayToTensor(coco::decode(rle));
-  return mask;
+  return WithCoords(std::move(cropped), std::make_pair(w, h));
 }
 
-std::ostream& operator << (std::ostream& os, const Polygons& bml){
-  os << "Polygons(";
-  os << "num_polygons=" << bml.polygons_.size();
-  os << "image_width=" << std::get<0>(bml.size_);
-  os << "image_height=" << std::get<1>(bml.size_);
-  os << "mode=" << bml.mode_ << "\n";
-  return os;
+SegmentationMask SegmentationMask::Crop(torch::Tensor box){
+  assert(box.size(0) == 4);
+  torch::Tensor cpu_box = box.to(torch::kCPU).to(torch::kF32).contiguous();
+  const float* xyxy = cpu_box.data<float>();
+  return Crop(std::make_tuple(static_cast<int>(xyxy[0]), static_cast<int>(xyxy[1]), static_cast<int>(xyxy[2]), static_cast<int>(xyxy[3])));
 }
 
-SegmentationMask::SegmentationMask(const SegmentationMask& other) :polygons_(other.polygons_), size_(other.size_), mode_(other.mode_){}
-
-SegmentationMask::SegmentationMask(std::vector<std::vector<std::vector<double>>> polygons, std::pair<int, int> size, std::string mode) :size_(size), mode_(mode){
-  for(auto& poly : polygons){
-    polygons_.emplace_back(poly, size, mode);
+SegmentationMask SegmentationMask::Resize(std::pair<int, int> size){
+  float ratio_w = static_cast<float>(std::get<0>(size)) / static_cast<float>(std::get<0>(size_));
+  float ratio_h = static_cast<float>(std::get<1>(size)) / static_cast<float>(std::get<1>(size_));
+  std::vector<float> scaled(coords_.size());
+  for(size_t i = 0; i < scaled.size(); i += 2){
+    scaled[i] = coords_[i] * ratio_w;
+    scaled[i + 1] = coords_[i + 1] * ratio_h;
   }
+  return WithCoords(std::move(scaled), size);
 }
 
-SegmentationMask::SegmentationMask(std::vector<Polygons> polygons, std::pair<int, int> size, std::string mode) :polygons_(polygons), size_(size), mode_(mode){}
-
-SegmentationMask SegmentationMask::Transpose(const Flip method){
-  std::vector<Polygons> flipped;
-  for(auto& poly : polygons_)
-    flipped.push_back(poly.Transpose(method));
-
-  return SegmentationMask(flipped, size_, mode_);
+SegmentationMask SegmentationMask::to(){
+  return *this;
 }
 
-SegmentationMask SegmentationMask::Crop(const std::tuple<int, int, int, int> box){
-  int w = std::get<2>(box) - std::get<0>(box), h = std::get<3>(box) - std::get<1>(box);
-  std::vector<Polygons> cropped;
-  for(auto& poly : polygons_)
-    cropped.push_back(poly.Crop(box));
-  return SegmentationMask(cropped, std::make_pair(w, h), mode_);
+int SegmentationMask::Length(){
+  return instance_rings_.size() - 1;
 }
 
-SegmentationMask SegmentationMask::Crop(torch::Tensor box){
-  assert(box.size(0) == 4);
-  int w = box.select(0, 2).item<int>() - box.select(0, 0).item<int>(), h = box.select(0, 3).item<int>() - box.select(0, 1).item<int>();
-  std::vector<Polygons> cropped;
-  for(auto& poly : polygons_)
-    cropped.push_back(poly.Crop(std::make_tuple(box.select(0, 0).item<int>(), box.select(0, 1).item<int>(), box.select(0, 2).item<int>(), box.select(0, 3).item<int>())));
-  return SegmentationMask(cropped, std::make_pair(w, h), mode_);
+void SegmentationMask::FillMask(int64_t i, float* mask) const{
+  int width = std::get<0>(size_), height = std::get<1>(size_);
+  std::vector<double> xy;
+  for(int64_t r = instance_rings_[i]; r < instance_rings_[i + 1]; ++r){
+    xy.assign(coords_.begin() + ring_offsets_[r], coords_.begin() + ring_offsets_[r + 1]);
+    coco::polyFill(xy.data(), xy.size() / 2, height, width, mask);
+  }
 }
 
-SegmentationMask SegmentationMask::Resize(std::pair<int, int> size){
-  std::vector<Polygons> scaled;
-  for(auto& poly : polygons_)
-    scaled.push_back(poly.Resize(size));
-  return SegmentationMask(scaled, size, mode_);
+torch::Tensor SegmentationMask::GetMaskTensor(){
+  int width = std::get<0>(size_), height = std::get<1>(size_);
+  torch::Tensor masks = torch::zeros({static_cast<int64_t>(Length()), height, width});
+  float* data = masks.data<float>();
+  for(int64_t i = 0; i < Length(); ++i)
+    FillMask(i, data + i * height * width);
+  return masks;
 }
 
-SegmentationMask SegmentationMask::to(){
-  return *this;
+torch::Tensor SegmentationMask::ProjectOnBoxes(torch::Tensor boxes, int resolution) const{
+  int64_t num_instances = instance_rings_.size() - 1;
+  assert(boxes.size(0) == num_instances);
+  torch::Tensor cpu_boxes = boxes.to(torch::kCPU).to(torch::kF32).contiguous();
+  const float* xyxy = cpu_boxes.data<float>();
+  torch::Tensor masks = torch::zeros({num_instances, resolution, resolution});
+  float* data = masks.data<float>();
+  std::vector<double> xy;
+  for(int64_t i = 0; i < num_instances; ++i, xyxy += 4){
+    //same float arithmetic as Crop followed by Resize
+    int x0 = static_cast<int>(xyxy[0]), y0 = static_cast<int>(xyxy[1]);
+    int w = std::max(static_cast<int>(xyxy[2]) - x0, 1), h = std::max(static_cast<int>(xyxy[3]) - y0, 1);
+    float ratio_w = static_cast<float>(resolution) / static_cast<float>(w);
+    float ratio_h = static_cast<float>(resolution) / static_cast<float>(h);
+    float x0f = x0, y0f = y0;
+    for(int64_t r = instance_rings_[i]; r < instance_rings_[i + 1]; ++r){
+      xy.resize(ring_offsets_[r + 1] - ring_offsets_[r]);
+      const float* ring = coords_.data() + ring_offsets_[r];
+      for(size_t j = 0; j < xy.size(); j += 2){
+        xy[j] = (ring[j] - x0f) * ratio_w;
+        xy[j + 1] = (ring[j + 1] - y0f) * ratio_h;
+      }
+      coco::polyFill(xy.data(), xy.size() / 2, resolution, resolution, data + i * resolution * resolution);
+    }
+  }
+  return masks;
 }
 
-int SegmentationMask::Length(){
-  return polygons_.size();
+SegmentationMask SegmentationMask::Select(const std::vector<int64_t>& items) const{
+  std::vector<float> coords;
+  std::vector<int64_t> ring_offsets{0}, instance_rings{0};
+  for(auto& item : items){
+    assert(item >= 0 && item < static_cast<int64_t>(instance_rings_.size()) - 1);
+    for(int64_t r = instance_rings_[item]; r < instance_rings_[item + 1]; ++r){
+      coords.insert(coords.end(), coords_.begin() + ring_offsets_[r], coords_.begin() + ring_offsets_[r + 1]);
+      ring_offsets.push_back(coords.size());
+    }
+    instance_rings.push_back(ring_offsets.size() - 1);
+  }
+  return SegmentationMask(std::move(coords), std::move(ring_offsets), std::move(instance_rings), size_, mode_);
 }
 
 SegmentationMask SegmentationMask::operator[](torch::Tensor item){
   assert(item.sizes().size() == 1);
-  std::vector<Polygons> selected_polygons;
+  std::vector<int64_t> items;
   if(item.dtype() == torch::kByte){
-    int length = item.size(0);
-    for(size_t i = 0; i < length; ++i){
-      if(item.select(0, i).item<bool>())
-        selected_polygons.push_back(polygons_[i]);
+    torch::Tensor keep = item.to(torch::kCPU).contiguous();
+    const uint8_t* data = keep.data<uint8_t>();
+    for(int64_t i = 0; i < keep.size(0); ++i){
+      if(data[i])
+        items.push_back(i);
     }
-    return SegmentationMask(selected_polygons, size_, mode_);
   }
   else{
     //index_select
-    int length = item.size(0);
-    for(size_t i = 0; i < length; ++i){
-      selected_polygons.push_back(polygons_[item.select(0, i).item<int64_t>()]);
-    }
-    return SegmentationMask(selected_polygons, size_, mode_);
+    torch::Tensor index = item.to(torch::kCPU).to(torch::kI64).contiguous();
+    items.assign(index.data<int64_t>(), index.data<int64_t>() + index.size(0));
   }
+  return Select(items);
 }
 
 SegmentationMask SegmentationMask::operator[](const int64_t item){
-  return SegmentationMask(std::vector<Polygons>{polygons_[item]}, size_, mode_);
-}
-
-torch::Tensor SegmentationMask::GetMaskTensor(){
-  std::vector<torch::Tensor> masks;
-  for(auto& poly : polygons_)
-    masks.push_back(poly.GetMaskTensor());
-  return torch::stack(masks);
+  return Select(std::vector<int64_t>{item});
 }
 
 std::ostream& operator << (std::ostream& os, const SegmentationMask& bml){
   os << "SegmentationMask(";
-  os << "num_instances=" << bml.polygons_.size() << ", ";
+  os << "num_instances=" << bml.instance_rings_.size() - 1 << ", ";
   os << "image_width=" << std::get<0>(bml.size_) << ", ";
   os << "image_height=" << std::get<1>(bml.size_) << "\n";
   return os;
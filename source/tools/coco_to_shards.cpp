@@ -0,0 +1,60 @@
+#include <coco.h>
+#include <shard.h>
+#include <sys/stat.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+
+//packs a coco image directory and its annotation file into shards
+//usage: coco_to_shards img_dir ann_file out_dir [images_per_shard]
+int main(int argc, char* argv[]){
+  if(argc < 4){
+    std::cout << "usage: " << argv[0] << " img_dir ann_file out_dir [images_per_shard]\n";
+    return 1;
+  }
+  std::string img_dir(argv[1]), ann_file(argv[2]), out_dir(argv[3]);
+  size_t images_per_shard = argc > 4 ? std::atoi(argv[4]) : 1024;
+  if(images_per_shard == 0){
+    std::cout << "images_per_shard must be positive\n";
+    return 1;
+  }
+  mkdir(out_dir.c_str(), 0755);
+
+  coco::COCO coco(ann_file);
+  //image ids are sorted, so every shard holds a run of the order the datasets use
+  std::vector<int> img_ids = coco.GetImgIds();
+  std::vector<unsigned char> bytes;
+  size_t num_shards = 0;
+  uint64_t total_bytes = 0;
+  for(size_t begin = 0; begin < img_ids.size(); begin += images_per_shard){
+    char name[32];
+    std::snprintf(name, sizeof(name), "/%05zu", num_shards);
+    rcnn::data::ShardWriter writer(out_dir + name + rcnn::data::SHARD_EXTENSION);
+    for(size_t i = begin; i < img_ids.size() && i < begin + images_per_shard; ++i){
+      const coco::ImageRecord* img = coco.FindImage(img_ids[i]);
+      std::string path = img_dir + "/" + coco.String(img->file_name);
+      std::ifstream ifs(path, std::ios::binary);
+      if(!ifs){
+        std::cout << "cannot read " << path << "\n";
+        return 1;
+      }
+      bytes.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+      writer.Add(coco, img_ids[i], bytes);
+    }
+    total_bytes += writer.bytes();
+    if(!writer.Close()){
+      std::cout << "cannot write shard " << num_shards << " to " << out_dir << "\n";
+      return 1;
+    }
+    num_shards++;
+    std::cout << "shard " << num_shards << ", " << std::min(begin + images_per_shard, img_ids.size()) << "/" << img_ids.size() << " images\n";
+  }
+  std::cout << "wrote " << img_ids.size() << " images, " << total_bytes << " bytes of image data in " << num_shards << " shards to " << out_dir << "\n";
+  return 0;
+}
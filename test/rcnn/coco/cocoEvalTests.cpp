@@ -0,0 +1,182 @@
+#include "gtest/gtest.h"
+
+#include <coco.h>
+#include <coco_eval.h>
+#include <algorithm>
+#include <string>
+#include <utility>
+
+using namespace coco;
+
+namespace{
+
+AnnotationRecord Box(int64_t id, int image_id, int category_id, float x, float y, float w, float h, int iscrowd = 0){
+  AnnotationRecord record = AnnotationRecord();
+  record.id = id;
+  record.image_id = image_id;
+  record.category_id = category_id;
+  record.area = w * h;
+  record.bbox[0] = x;
+  record.bbox[1] = y;
+  record.bbox[2] = w;
+  record.bbox[3] = h;
+  record.iscrowd = iscrowd;
+  return record;
+}
+
+//images 1..num_images and categories 1..num_categories, detections come with scores
+COCO Build(int num_images, int num_categories, std::vector<AnnotationRecord> annotations, std::vector<double> scores = std::vector<double>{}, bool polygons = false){
+  IndexBuilder builder;
+  for(int i = 1; i <= num_images; ++i)
+    builder.images.push_back(ImageRecord{i, 640, 480, 0});
+  for(int i = 1; i <= num_categories; ++i)
+    builder.categories.push_back(CategoryRecord{i, 0, 0});
+  builder.annotations = annotations;
+  builder.scores = scores;
+  //the box outline as a polygon
+  for(auto& ann : builder.annotations){
+    if(!polygons)
+      continue;
+    float x1 = ann.bbox[0], y1 = ann.bbox[1], x2 = x1 + ann.bbox[2], y2 = y1 + ann.bbox[3];
+    ann.segm_type = SEGM_POLYGON;
+    ann.segm_begin = builder.rings.size() - 1;
+    builder.coords.insert(builder.coords.end(), {x1, y1, x1, y2, x2, y2, x2, y1});
+    builder.rings.push_back(builder.coords.size());
+    ann.segm_end = builder.rings.size() - 1;
+  }
+  COCO coco;
+  coco.CreateIndex(builder);
+  return coco;
+}
+
+}
+
+TEST(coco_eval, bbox)
+{
+  //image 1 has a large box, a medium box and a crowd region of category 1, image 2 has nothing
+  COCO coco_gt = Build(2, 2, std::vector<AnnotationRecord>{
+    Box(1, 1, 1, 10, 10, 100, 100),
+    Box(2, 1, 1, 300, 300, 50, 50),
+    Box(3, 1, 1, 400, 0, 200, 200, 1)
+  });
+  //a hit, a small false positive and a detection inside the crowd region
+  COCO coco_dt = Build(2, 2, std::vector<AnnotationRecord>{
+    Box(1, 1, 1, 10, 10, 100, 100),
+    Box(2, 1, 1, 200, 200, 20, 20),
+    Box(3, 1, 1, 450, 50, 40, 40)
+  }, std::vector<double>{.9, .8, .7});
+  COCOeval coco_eval(coco_gt, coco_dt, "bbox");
+  coco_eval.Evaluate();
+  coco_eval.Accumulate();
+  coco_eval.Summarize();
+
+  //recall 1/2 at precision 1 covers 51 of the 101 recall thresholds at every iou
+  double ap = 51. / 101.;
+  //no small ground truth, the medium box is never found, the large one is found first
+  std::vector<double> expected{ap, ap, ap, -1, 0, 1, .5, .5, .5, -1, 0, 1};
+  ASSERT_EQ(coco_eval.stats.size(), expected.size());
+  for(size_t i = 0; i < expected.size(); ++i)
+    EXPECT_NEAR(coco_eval.stats[i], expected[i], 1e-12) << "stat " << i;
+}
+
+TEST(coco_eval, self)
+{
+  //detections equal to the ground truth score perfectly, whatever their scores
+  std::vector<AnnotationRecord> boxes;
+  std::vector<double> scores;
+  for(int i = 0; i < 150; ++i){
+    boxes.push_back(Box(i + 1, 1 + i % 2, 1 + i % 3, (i * 37) % 500, (i * 53) % 380, 5 + (i * 11) % 150, 5 + (i * 7) % 120));
+    scores.push_back((i * 13 % 100) / 100.);
+  }
+  COCO coco_gt = Build(2, 3, boxes);
+  COCO coco_dt = Build(2, 3, boxes, scores);
+  COCOeval coco_eval(coco_gt, coco_dt, "bbox");
+  coco_eval.Evaluate();
+  coco_eval.Accumulate();
+  coco_eval.Summarize();
+  for(int i : {0, 1, 2, 3, 4, 5, 8, 9, 10, 11})
+    EXPECT_DOUBLE_EQ(coco_eval.stats[i], 1) << "stat " << i;
+  EXPECT_LT(coco_eval.stats[6], 1);
+}
+
+TEST(coco_eval, segm)
+{
+  COCO coco_gt = Build(1, 1, std::vector<AnnotationRecord>{
+    Box(1, 1, 1, 10, 10, 100, 100),
+    Box(2, 1, 1, 300, 300, 50, 50)
+  }, std::vector<double>{}, true);
+  //the first mask is found, the second overlaps nothing
+  COCO coco_dt = Build(1, 1, std::vector<AnnotationRecord>{
+    Box(1, 1, 1, 10, 10, 100, 100),
+    Box(2, 1, 1, 200, 200, 20, 20)
+  }, std::vector<double>{.9, .8}, true);
+  COCOeval coco_eval(coco_gt, coco_dt, "segm");
+  coco_eval.Evaluate();
+  coco_eval.Accumulate();
+  coco_eval.Summarize();
+  EXPECT_NEAR(coco_eval.stats[0], 51. / 101., 1e-12);
+  EXPECT_NEAR(coco_eval.stats[8], .5, 1e-12);
+  EXPECT_NEAR(coco_eval.stats[5], 1, 1e-12);
+}
+
+TEST(coco_eval, pycocotools)
+{
+  //stats of pycocotools 2.0.11 on the same files. Ground truth areas sit just off 32^2 and 96^2 and detection boxes
+  //just off the iou thresholds, float32 rounding of them moves ten of the bbox and two of the segm stats
+  std::vector<std::pair<std::string, std::vector<double>>> expected{
+    {"bbox", {0.20723107273133326, 0.2515480119440516, 0.23452525703698188, 0.05986798679867988, 0.25616258054376867, 0.47375412541254125,
+              0.23012820512820514, 0.4143162393162393, 0.4143162393162393, 0.14166666666666666, 0.45555555555555555, 0.5458333333333334}},
+    {"segm", {0.21181599249668553, 0.2595054743569595, 0.2400793650793651, 0.034323432343234324, 0.27981961016614476, 0.5043316831683168,
+              0.2553418803418804, 0.38675213675213677, 0.38675213675213677, 0.06666666666666667, 0.4555555555555556, 0.5458333333333334}}
+  };
+  COCO coco_gt("../resource/coco_eval_gt.json", false);
+  for(auto& iou_type : expected){
+    COCO coco_dt = coco_gt.LoadRes("../resource/coco_eval_" + iou_type.first + "_results.json");
+    COCOeval coco_eval(coco_gt, coco_dt, iou_type.first);
+    coco_eval.Evaluate();
+    coco_eval.Accumulate();
+    coco_eval.Summarize();
+    ASSERT_EQ(coco_eval.stats.size(), iou_type.second.size());
+    for(size_t i = 0; i < iou_type.second.size(); ++i)
+      EXPECT_NEAR(coco_eval.stats[i], iou_type.second[i], 1e-12) << iou_type.first << " stat " << i;
+  }
+}
+
+TEST(coco_eval, online)
+{
+  //adding the images one at a time gives the numbers of a batch evaluation over the images added
+  std::vector<AnnotationRecord> gts, dts;
+  std::vector<double> scores;
+  for(int i = 0; i < 60; ++i){
+    float x = (i * 37) % 500, y = (i * 53) % 380, w = 5 + (i * 11) % 150, h = 5 + (i * 7) % 120;
+    gts.push_back(Box(i + 1, 1 + i % 3, 1 + i % 2, x, y, w, h));
+    dts.push_back(Box(i + 1, 1 + i % 3, 1 + (i / 3) % 2, x + i % 7, y - i % 5, w, h + i % 9));
+    scores.push_back((i * 13 % 100) / 100.);
+  }
+  COCO coco_gt = Build(3, 2, gts);
+  COCO coco_dt = Build(3, 2, dts, scores);
+  COCOeval online(coco_gt, "bbox");
+  for(int image_id : {3, 1, 2}){
+    std::vector<float> boxes;
+    std::vector<float> image_scores;
+    std::vector<int64_t> category_ids;
+    for(auto& ann : coco_dt.ImageAnnotations(image_id)){
+      boxes.insert(boxes.end(), ann.bbox, ann.bbox + 4);
+      image_scores.push_back(coco_dt.scores[&ann - coco_dt.annotations.data()]);
+      category_ids.push_back(ann.category_id);
+    }
+    online.AddImage(image_id, boxes.data(), image_scores.data(), category_ids.data(), category_ids.size());
+    //repeats and unknown images are ignored
+    online.AddImage(image_id, boxes.data(), image_scores.data(), category_ids.data(), category_ids.size());
+    online.AddImage(99, boxes.data(), image_scores.data(), category_ids.data(), category_ids.size());
+    online.Accumulate();
+
+    COCOeval batch(coco_gt, coco_dt, "bbox");
+    batch.params.img_ids = image_id == 3 ? std::vector<int>{3} : image_id == 1 ? std::vector<int>{1, 3} : std::vector<int>{1, 2, 3};
+    batch.Evaluate();
+    batch.Accumulate();
+    EXPECT_EQ(online.precision, batch.precision);
+    EXPECT_EQ(online.recall, batch.recall);
+  }
+  EXPECT_GT(*std::max_element(online.precision.begin(), online.precision.end()), 0);
+}
@@ -0,0 +1,106 @@
+#include "gtest/gtest.h"
+
+#include <coco.h>
+#include <coco_eval.h>
+#include <coco_results.h>
+#include <mask.h>
+#include <cstdio>
+#include <random>
+
+using namespace coco;
+
+namespace{
+
+COCO GroundTruth(){
+  IndexBuilder builder;
+  for(int i = 1; i <= 2; ++i)
+    builder.images.push_back(ImageRecord{i, 640, 480, 0});
+  builder.categories.push_back(CategoryRecord{3, 0, 0});
+  builder.categories.push_back(CategoryRecord{5, 0, 0});
+  COCO coco;
+  coco.CreateIndex(builder);
+  return coco;
+}
+
+const float kBoxes[] = {10, 20, 30, 40, 1.5f, 2.5f, 100, 50, 0, 0, 8, 8};
+const float kScores[] = {.9f, .25f, .7f};
+const int64_t kCategories[] = {3, 5, 3};
+
+void WriteResults(const std::string& path, bool binary){
+  ResultsWriter writer(path, binary);
+  writer.Write(2, kBoxes, kScores, kCategories, 2);
+  writer.Write(1, kBoxes + 8, kScores + 2, kCategories + 2, 1);
+  writer.Write(1, kBoxes, kScores, kCategories, 0);
+  EXPECT_EQ(writer.count(), 3);
+  EXPECT_TRUE(writer.Close());
+}
+
+void ExpectResults(const COCO& res){
+  ASSERT_EQ(res.annotations.size(), 3);
+  ASSERT_EQ(res.scores.size(), 3);
+  int64_t image_ids[] = {2, 2, 1};
+  for(size_t i = 0; i < 3; ++i){
+    const AnnotationRecord& ann = res.annotations[i];
+    EXPECT_EQ(ann.id, i + 1);
+    EXPECT_EQ(ann.image_id, image_ids[i]);
+    EXPECT_EQ(ann.category_id, kCategories[i]);
+    EXPECT_FLOAT_EQ(res.scores[i], kScores[i]);
+    for(int j = 0; j < 4; ++j)
+      EXPECT_FLOAT_EQ(ann.bbox[j], kBoxes[i * 4 + j]);
+    EXPECT_FLOAT_EQ(ann.area, kBoxes[i * 4 + 2] * kBoxes[i * 4 + 3]);
+    EXPECT_EQ(ann.iscrowd, 0);
+  }
+  EXPECT_EQ(res.ImageAnnotations(2).size(), 2);
+}
+
+}
+
+TEST(coco_results, binary)
+{
+  COCO coco_gt = GroundTruth();
+  WriteResults("coco_results_test.bin", true);
+  ExpectResults(LoadDetections(coco_gt, "coco_results_test.bin"));
+  std::remove("coco_results_test.bin");
+}
+
+TEST(coco_results, unwritable)
+{
+  //a missing directory fails the writes instead of crashing
+  ResultsWriter writer("missing_directory/bbox.bin", true);
+  EXPECT_FALSE(writer.Write(1, kBoxes, kScores, kCategories, 1));
+  EXPECT_FALSE(writer.Close());
+  COCO res = LoadDetections(GroundTruth(), "missing_directory/bbox.bin");
+  EXPECT_EQ(res.annotations.size(), 0);
+  EXPECT_EQ(res.images.size(), 2);
+}
+
+TEST(coco_results, json)
+{
+  COCO coco_gt = GroundTruth();
+  WriteResults("coco_results_test.json", false);
+  ExpectResults(coco_gt.LoadRes("coco_results_test.json"));
+  std::remove("coco_results_test.json");
+}
+
+TEST(coco_results, encode_masks)
+{
+  //row major masks give the same strings as rleEncode of their column major bytes
+  int n = 3, h = 7, w = 5;
+  std::mt19937 rng(3);
+  std::vector<uint8_t> masks(n * h * w);
+  for(auto& v : masks)
+    v = rng() % 3 == 0 ? 0 : rng() % 255 + 1;
+  std::fill(masks.begin() + h * w, masks.begin() + 2 * h * w, 0);
+  std::vector<RLEstr> rles = EncodeMasks(masks.data(), n, h, w);
+  ASSERT_EQ(rles.size(), n);
+  for(int i = 0; i < n; ++i){
+    std::vector<byte> column_major(h * w);
+    for(int y = 0; y < h; ++y)
+      for(int x = 0; x < w; ++x)
+        column_major[x * h + y] = masks[i * h * w + y * w + x] != 0;
+    RLEstr expected = encode(column_major.data(), h, w, 1)[0];
+    EXPECT_EQ(rles[i].counts, expected.counts);
+    EXPECT_EQ(rles[i].size.first, h);
+    EXPECT_EQ(rles[i].size.second, w);
+  }
+}
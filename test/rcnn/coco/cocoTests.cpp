@@ -0,0 +1,171 @@
+#include "gtest/gtest.h"
+
+#include <coco.h>
+#include <coco_cache.h>
+#include <cstdio>
+#include <fstream>
+#include <memory>
+#include "test_annotations.h"
+
+using namespace coco;
+using test::TempFiles;
+using test::WriteAnnotations;
+
+namespace{
+
+void ExpectSameIndex(COCO& a, COCO& b){
+  ASSERT_EQ(a.GetImgIds(), b.GetImgIds());
+  ASSERT_EQ(a.GetCatIds(), b.GetCatIds());
+  for(auto& img_id : a.GetImgIds()){
+    std::vector<int64_t> ids = a.GetAnnIds(std::vector<int>{img_id});
+    ASSERT_EQ(ids, b.GetAnnIds(std::vector<int>{img_id}));
+    std::vector<Annotation> anns_a = a.LoadAnns(ids), anns_b = b.LoadAnns(ids);
+    for(size_t i = 0; i < anns_a.size(); ++i){
+      EXPECT_EQ(anns_a[i].id, anns_b[i].id);
+      EXPECT_EQ(anns_a[i].bbox, anns_b[i].bbox);
+      EXPECT_EQ(anns_a[i].segmentation, anns_b[i].segmentation);
+      EXPECT_EQ(anns_a[i].counts, anns_b[i].counts);
+    }
+    EXPECT_EQ(a.LoadImgs(std::vector<int>{img_id})[0].file_name, b.LoadImgs(std::vector<int>{img_id})[0].file_name);
+  }
+}
+
+}
+
+TEST(coco, index)
+{
+  TempFiles files{"coco_test_annotations.json"};
+  WriteAnnotations(files[0]);
+  COCO coco(files[0], false);
+
+  EXPECT_EQ(coco.GetImgIds(), (std::vector<int>{3, 4, 5, 9}));
+  //categories keep file order
+  EXPECT_EQ(coco.GetCatIds(), (std::vector<int>{1, 2}));
+  EXPECT_EQ(coco.GetCatIds(std::vector<std::string>{"bicycle"}), std::vector<int>{2});
+  //annotations of an image keep file order
+  EXPECT_EQ(coco.GetAnnIds(std::vector<int>{9}), (std::vector<int64_t>{12, 7}));
+  EXPECT_EQ(coco.GetAnnIds(std::vector<int>{5}), std::vector<int64_t>{});
+  EXPECT_EQ(coco.GetAnnIds(std::vector<int>{}, std::vector<int>{1}), (std::vector<int64_t>{5, 6, 7}));
+  EXPECT_EQ(coco.GetAnnIds(std::vector<int>{}, std::vector<int>{}, std::vector<float>{0, 1000}), (std::vector<int64_t>{12, 5, 6}));
+  EXPECT_EQ(coco.GetAnnIds(std::vector<int>{}, std::vector<int>{}, std::vector<float>{}, F), (std::vector<int64_t>{12, 7}));
+
+  Annotation ann = coco.LoadAnns(std::vector<int64_t>{12})[0];
+  ASSERT_EQ(ann.segmentation.size(), 2);
+  EXPECT_EQ(ann.segmentation[1], (std::vector<double>{3, 3, 4, 4, 5, 3}));
+  Annotation rle = coco.LoadAnns(std::vector<int64_t>{5})[0];
+  EXPECT_EQ(rle.counts, (std::vector<int>{0, 10, 190}));
+  EXPECT_EQ(rle.size, std::make_pair(200, 320));
+  EXPECT_TRUE(rle.iscrowd);
+  EXPECT_EQ(coco.LoadCats(std::vector<int>{2})[0].supercategory, "vehicle");
+}
+
+TEST(coco, shared_copy)
+{
+  TempFiles files{"coco_test_annotations.json"};
+  WriteAnnotations(files[0]);
+  std::unique_ptr<COCO> coco(new COCO(files[0], false));
+  //copies share the tables and outlive the original
+  COCO copy(*coco);
+  EXPECT_EQ(copy.annotations.data(), coco->annotations.data());
+  EXPECT_EQ(copy.coords.data(), coco->coords.data());
+  coco.reset();
+  EXPECT_EQ(copy.GetAnnIds(std::vector<int>{9}), (std::vector<int64_t>{12, 7}));
+  EXPECT_EQ(copy.LoadAnns(std::vector<int64_t>{12})[0].segmentation[1], (std::vector<double>{3, 3, 4, 4, 5, 3}));
+}
+
+TEST(coco, query)
+{
+  TempFiles files{"coco_test_annotations.json"};
+  WriteAnnotations(files[0]);
+  COCO coco(files[0], false);
+
+  AnnotationRange img_anns = coco.ImageAnnotations(9);
+  ASSERT_EQ(img_anns.size(), 2);
+  EXPECT_EQ(img_anns[0].id, 12);
+  EXPECT_EQ(&img_anns[1], coco.FindAnnotation(7));//views the table
+  EXPECT_TRUE(coco.ImageAnnotations(42).empty());
+
+  std::vector<int64_t> ids;
+  for(auto& ann : coco.CategoryAnnotations(1))
+    ids.push_back(ann.id);
+  EXPECT_EQ(ids, (std::vector<int64_t>{5, 6, 7}));
+
+  //area order, bounds are exclusive
+  ids.clear();
+  for(auto& ann : coco.AnnotationsInArea(50, 3000))
+    ids.push_back(ann.id);
+  EXPECT_EQ(ids, (std::vector<int64_t>{5, 12, 7}));
+  EXPECT_EQ(coco.AnnotationsInArea(50.5, 2000).size(), 1);
+
+  ASSERT_EQ(coco.CrowdAnnotations().size(), 2);
+  EXPECT_EQ(coco.CrowdAnnotations()[0].id, 5);
+  EXPECT_EQ(coco.CrowdAnnotations()[1].id, 6);
+
+  //combined filters keep file order whichever index is used
+  EXPECT_EQ(coco.GetAnnIds(std::vector<int>{}, std::vector<int>{1, 2}, std::vector<float>{60, 3000}), (std::vector<int64_t>{12, 7}));
+  EXPECT_EQ(coco.GetAnnIds(std::vector<int>{}, std::vector<int>{1}, std::vector<float>{}, T), (std::vector<int64_t>{5, 6}));
+}
+
+TEST(coco, cache)
+{
+  std::string path = "coco_test_annotations.json";
+  TempFiles files{path, CachePath(path)};
+  WriteAnnotations(path);
+  COCO parsed(path, false);
+  ASSERT_TRUE(WriteCache(parsed, CachePath(path), path));
+
+  COCO cached;
+  ASSERT_TRUE(LoadCache(cached, CachePath(path), path));
+  ExpectSameIndex(parsed, cached);
+  EXPECT_EQ(cached.CategoryAnnotations(1).size(), 3);
+  EXPECT_EQ(cached.AnnotationsInArea(0, 1000).size(), 3);
+  EXPECT_EQ(cached.CrowdAnnotations()[0].id, 5);
+
+  //copies keep the mapping alive
+  COCO copied = cached;
+  ExpectSameIndex(parsed, copied);
+
+  //a changed annotation file invalidates the cache
+  std::ofstream(path, std::ios::app) << "\n";
+  COCO stale;
+  EXPECT_FALSE(LoadCache(stale, CachePath(path), path));
+}
+
+TEST(coco, stream)
+{
+  //unknown sections and fields are skipped, enough rows to build the index on several threads
+  std::string path = "coco_test_stream.json";
+  int num_images = 3000, anns_per_image = 12;
+  {
+    std::ofstream ofs(path);
+    ofs << R"({"info": {"year": 2017, "nested": [[1, 2], {"a": []}]}, "licenses": [{"id": 1, "name": "x"}], "images": [)";
+    for(int i = num_images; i > 0; --i)
+      ofs << (i == num_images ? "" : ",") << R"({"id": )" << i << R"(, "license": 1, "width": 64, "height": 48, "file_name": "img)" << i << R"(.jpg"})";
+    ofs << R"(], "annotations": [)";
+    for(int i = 0; i < num_images * anns_per_image; ++i){
+      int image_id = i % num_images + 1;
+      ofs << (i == 0 ? "" : ",") << R"({"id": )" << (num_images * anns_per_image - i) << R"(, "image_id": )" << image_id
+          << R"(, "category_id": )" << (i % 3 + 1) << R"(, "area": 1.5, "iscrowd": 0, "bbox": [1.5, 2, 3, 4], "attributes": {"occluded": [true]},)"
+          << R"( "segmentation": [[0, 0, 1, 0, 1, 1], [2, 2, 3, 3, 2, 3]]})";
+    }
+    ofs << R"(], "categories": [{"id": 3, "name": "c"}, {"id": 1, "name": "a"}, {"id": 2, "name": "b"}]})";
+  }
+  COCO coco(path, false);
+  std::remove(path.c_str());
+
+  ASSERT_EQ(coco.GetImgIds().size(), num_images);
+  EXPECT_EQ(coco.GetImgIds()[0], 1);
+  EXPECT_EQ(coco.GetCatIds(), (std::vector<int>{3, 1, 2}));
+  EXPECT_EQ(coco.LoadImgs(std::vector<int>{17})[0].file_name, "img17.jpg");
+  for(int image_id = 1; image_id <= num_images; image_id += 97){
+    std::vector<int64_t> ids = coco.GetAnnIds(std::vector<int>{image_id});
+    ASSERT_EQ(ids.size(), anns_per_image);
+    for(size_t i = 1; i < ids.size(); ++i)
+      EXPECT_GT(ids[i - 1], ids[i]);//file order
+    Annotation ann = coco.LoadAnns(std::vector<int64_t>{ids[0]})[0];
+    EXPECT_EQ(ann.image_id, image_id);
+    EXPECT_EQ(ann.bbox, (std::vector<float>{1.5, 2, 3, 4}));
+    EXPECT_EQ(ann.segmentation.size(), 2);
+  }
+  EXPECT_EQ(coco.CategoryImageIds(2).size(), num_images * anns_per_image / 3);
+}
@@ -0,0 +1,32 @@
+#include "gtest/gtest.h"
+
+#include <mask.h>
+#include <mask_api.h>
+#include <cstdlib>
+#include <vector>
+
+using namespace coco;
+
+TEST(mask, poly_fill)
+{
+  //random polygons, partly outside the mask, against the rle round trip
+  std::srand(7);
+  const int h = 28, w = 28;
+  for(int trial = 0; trial < 200; ++trial){
+    std::vector<std::vector<double>> polygons(1 + trial % 3);
+    for(auto& polygon : polygons)
+      for(int i = 0; i < 2 * (3 + std::rand() % 8); ++i)
+        polygon.push_back(-4 + 36.0 * std::rand() / RAND_MAX);
+
+    std::vector<RLEstr> rles = frPoly(polygons, h, w);
+    Masks expected = decode(merge(rles));
+    std::vector<float> mask(h * w, 0);
+    for(auto& polygon : polygons)
+      polyFill(polygon.data(), polygon.size() / 2, h, w, mask.data());
+
+    for(int y = 0; y < h; ++y)
+      for(int x = 0; x < w; ++x)
+        ASSERT_EQ(mask[y * w + x], static_cast<float>(expected._mask[x * h + y])) << "trial " << trial << " at " << x << ", " << y;
+    delete[] expected._mask;
+  }
+}
@@ -0,0 +1,34 @@
+#include "gtest/gtest.h"
+
+#include <batch_buffer_pool.h>
+
+using namespace rcnn::data;
+
+TEST(batch_buffer_pool, reuse)
+{
+  BatchBufferPool pool(2 * 3 * 32 * 32 * sizeof(float));
+  float* first;
+  {
+    torch::Tensor batch = pool.Get({2, 3, 32, 32});
+    first = batch.data<float>();
+    EXPECT_EQ(pool.bytes_in_use(), 2 * 3 * 32 * 32 * sizeof(float));
+    //views keep the buffer out of the pool
+    torch::Tensor view = batch[1];
+    batch = torch::Tensor();
+    EXPECT_EQ(pool.bytes_held(), 0);
+  }
+  EXPECT_EQ(pool.bytes_held(), 2 * 3 * 32 * 32 * sizeof(float));
+  EXPECT_EQ(pool.bytes_in_use(), 0);
+
+  torch::Tensor again = pool.Get({2, 3, 32, 32});
+  EXPECT_EQ(again.data<float>(), first);
+  //another shape is another bucket
+  torch::Tensor other = pool.Get({1, 3, 32, 32});
+  EXPECT_EQ(pool.hits(), 1);
+  EXPECT_EQ(pool.misses(), 2);
+
+  //over the budget, freed instead of kept
+  again = torch::Tensor();
+  other = torch::Tensor();
+  EXPECT_EQ(pool.bytes_held(), 2 * 3 * 32 * 32 * sizeof(float));
+}
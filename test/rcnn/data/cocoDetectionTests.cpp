@@ -0,0 +1,49 @@
+#include "gtest/gtest.h"
+
+#include <coco_cache.h>
+#include <coco_detection.h>
+#include <cstdio>
+#include <memory>
+#include <opencv2/imgcodecs.hpp>
+#include "test_annotations.h"
+
+using namespace rcnn::data;
+
+TEST(coco_detection, reduced_decode)
+{
+  std::string ann_file = "coco_detection_test_annotations.json";
+  test::TempFiles files{ann_file, coco::CachePath(ann_file), "a.jpg", "b.jpg"};
+  test::WriteAnnotations(ann_file);
+  //a.jpg has its annotated size, b.jpg is a quarter of what its annotation says
+  cv::Mat a(200, 320, CV_8UC3, cv::Scalar(30, 90, 150)), b(120, 160, CV_8UC3, cv::Scalar(60, 120, 180));
+  ASSERT_TRUE(cv::imwrite("a.jpg", a));
+  ASSERT_TRUE(cv::imwrite("b.jpg", b));
+
+  COCODetection dataset(".", ann_file);
+  ASSERT_EQ(dataset.ids(), (std::vector<int>{3, 4, 5, 9}));
+  //a is resized to 80x50 and decoded at 1/4, b is resized to 66x50 and decoded at 1/8
+  dataset.SetDecodeSize(50, 80);
+  dataset.SetImageCache(std::make_shared<ImageCache>(1 << 24, 1));
+
+  auto reduced = dataset.get(0);
+  EXPECT_EQ(reduced.data.cols, 80);
+  EXPECT_EQ(reduced.data.rows, 50);
+  EXPECT_EQ(reduced.target.width, 320);
+  EXPECT_EQ(reduced.target.height, 200);
+
+  //b falls back to a full decode and its annotations refer to the real size
+  auto mismatch = dataset.get(3);
+  EXPECT_EQ(mismatch.data.cols, 160);
+  EXPECT_EQ(mismatch.data.rows, 120);
+  EXPECT_EQ(mismatch.target.width, 160);
+  EXPECT_EQ(mismatch.target.height, 120);
+
+  //the full decode is remembered, later accesses and copies are served by the cache
+  std::remove("b.jpg");
+  COCODetection copy(dataset);
+  auto cached = copy.get(3);
+  EXPECT_EQ(cached.data.cols, 160);
+  EXPECT_EQ(cached.data.rows, 120);
+  EXPECT_EQ(cached.target.width, 160);
+  EXPECT_EQ(dataset.image_cache_->hits(), 1);
+}
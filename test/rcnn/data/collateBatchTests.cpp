@@ -0,0 +1,48 @@
+#include "gtest/gtest.h"
+
+#include <collate_batch.h>
+#include <opencv2/core.hpp>
+
+using namespace rcnn::data;
+
+TEST(collate_batch, fused)
+{
+  std::vector<float> mean{102.9801, 115.9465, 122.7717}, stddev{1., 1., 1.};
+  Compose chain(
+    std::vector<std::shared_ptr<MatToMatTransform>>{std::make_shared<Resize>(40, 100)},
+    std::vector<std::shared_ptr<TensorToTensorTransform>>{
+      std::make_shared<Normalize>(torch::ArrayRef<float>(mean), torch::ArrayRef<float>(stddev), true)
+    }
+  );
+  Compose fused(std::make_shared<ResizeFlipNormalize>(40, 100, 0.f, 0.f, mean, stddev, true));
+
+  std::vector<torch::data::Example<cv::Mat, RCNNData>> examples;
+  for(auto& size : std::vector<std::pair<int, int>>{{64, 48}, {30, 50}}){
+    cv::Mat img(size.second, size.first, CV_8UC3);
+    cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(256));
+    RCNNData data;
+    data.idx = examples.size();
+    data.target = rcnn::structures::BoxList(torch::tensor({1.f, 2.f, 20.f, 20.f}).reshape({1, 4}), std::make_pair(static_cast<int64_t>(size.first), static_cast<int64_t>(size.second)));
+    examples.push_back(torch::data::Example<cv::Mat, RCNNData>{img, data});
+  }
+
+  BatchCollator chain_collate(chain, 32), fused_collate(fused, 32);
+  batch expected = chain_collate.apply_batch(examples);
+  batch result = fused_collate.apply_batch(examples);
+  torch::Tensor expected_imgs = std::get<0>(expected).get_tensors(), result_imgs = std::get<0>(result).get_tensors();
+  ASSERT_EQ(result_imgs.sizes(), expected_imgs.sizes());
+  EXPECT_EQ(result_imgs.size(2) % 32, 0);
+  EXPECT_TRUE(torch::equal(result_imgs, expected_imgs));
+  EXPECT_EQ(std::get<0>(result).get_image_sizes(), std::get<0>(expected).get_image_sizes());
+  EXPECT_EQ(std::get<2>(result), (std::vector<int64_t>{0, 1}));
+
+  int64_t image_pixels = 0;
+  for(auto& size : std::get<0>(result).get_image_sizes())
+    image_pixels += size.first * size.second;
+  double padded = 1. - static_cast<double>(image_pixels) / (result_imgs.size(0) * result_imgs.size(2) * result_imgs.size(3));
+  EXPECT_EQ(fused_collate.padding_->batches(), 1);
+  EXPECT_DOUBLE_EQ(fused_collate.padding_->padded_fraction(), padded);
+  EXPECT_DOUBLE_EQ(chain_collate.padding_->padded_fraction(), padded);
+  fused_collate.padding_->Reset();
+  EXPECT_EQ(fused_collate.padding_->padded_fraction(), 0.);
+}
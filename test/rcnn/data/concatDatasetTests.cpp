@@ -0,0 +1,47 @@
+#include "gtest/gtest.h"
+
+#include <datasets/concat_dataset.h>
+#include <samplers/samplers.h>
+#include <set>
+#include <vector>
+
+using namespace rcnn::data;
+
+TEST(concat_dataset, index)
+{
+  EXPECT_EQ(ConcatDataset::Encode(0, 17), 17);
+  EXPECT_EQ(ConcatDataset::Decode(ConcatDataset::Encode(3, 117265)), std::make_pair<size_t, size_t>(3, 117265));
+}
+
+TEST(concat_dataset, weighted_sampler)
+{
+  //member 1 is never picked, so its groups are never loaded
+  std::vector<int> loads(3, 0);
+  WeightedBatchSampler sampler(std::vector<float>{1, 0, 3}, [&loads](size_t m) -> std::vector<int>{
+    loads[m]++;
+    std::vector<int> group_ids(10 + m);
+    for(size_t i = 0; i < group_ids.size(); ++i)
+      group_ids[i] = i % 2;
+    return group_ids;
+  }, 4);
+
+  std::vector<int> member_draws(3, 0);
+  for(int b = 0; b < 200; ++b){
+    auto batch = sampler.next(4);
+    ASSERT_TRUE(batch.has_value());
+    ASSERT_EQ(batch->size(), 4);
+    std::set<size_t> groups;
+    for(auto& index : *batch){
+      size_t m, local;
+      std::tie(m, local) = ConcatDataset::Decode(index);
+      ASSERT_LT(local, 10 + m);
+      groups.insert(local % 2);
+      member_draws[m]++;
+    }
+    EXPECT_EQ(groups.size(), 1);
+  }
+  EXPECT_EQ(loads, (std::vector<int>{1, 0, 1}));
+  EXPECT_EQ(member_draws[1], 0);
+  //3 to 1
+  EXPECT_GT(member_draws[2], 2 * member_draws[0]);
+}
@@ -0,0 +1,59 @@
+#include "gtest/gtest.h"
+
+#include <datasets/dataset_stats.h>
+#include <cstddef>
+#include <fstream>
+#include "test_annotations.h"
+
+using namespace rcnn::data;
+
+TEST(dataset_stats, sidecar)
+{
+  std::string path = "dataset_stats_test_annotations.json";
+  test::TempFiles files{path, StatsPath(path)};
+  test::WriteAnnotations(path);
+  coco::COCO coco(path, false);
+
+  DatasetStats stats = LoadOrComputeStats(coco, path);
+  ASSERT_EQ(stats.images.size(), 4);
+  //sorted by id, image 4 only has a one pixel box and image 5 no annotations
+  EXPECT_EQ(stats.images[0].id, 3);
+  EXPECT_EQ(stats.images[0].valid, 1);
+  EXPECT_EQ(stats.images[1].id, 4);
+  EXPECT_EQ(stats.images[1].valid, 0);
+  EXPECT_EQ(stats.images[2].id, 5);
+  EXPECT_EQ(stats.images[2].valid, 0);
+  EXPECT_EQ(stats.images[2].height, 300);
+  EXPECT_EQ(stats.images[3].id, 9);
+  EXPECT_EQ(stats.images[3].valid, 1);
+  EXPECT_EQ(stats.images[3].width, 640);
+  EXPECT_EQ(stats.category_ids, (std::vector<int32_t>{1, 2}));
+
+  DatasetStats loaded;
+  ASSERT_TRUE(LoadStats(loaded, StatsPath(path), path));
+  ASSERT_EQ(loaded.images.size(), stats.images.size());
+  for(size_t i = 0; i < stats.images.size(); ++i){
+    EXPECT_EQ(loaded.images[i].id, stats.images[i].id);
+    EXPECT_EQ(loaded.images[i].height, stats.images[i].height);
+    EXPECT_EQ(loaded.images[i].valid, stats.images[i].valid);
+  }
+  EXPECT_EQ(loaded.category_ids, stats.category_ids);
+
+  //a corrupted count under a matching stamp is rejected and the stats are rebuilt
+  {
+    std::fstream fs(StatsPath(path), std::ios::in | std::ios::out | std::ios::binary);
+    uint64_t num_images = uint64_t(1) << 60;
+    fs.seekp(offsetof(StatsHeader, num_images));
+    fs.write(reinterpret_cast<const char*>(&num_images), sizeof(num_images));
+  }
+  EXPECT_FALSE(LoadStats(loaded, StatsPath(path), path));
+  EXPECT_EQ(LoadOrComputeStats(coco, path).images.size(), 4);
+  EXPECT_TRUE(LoadStats(loaded, StatsPath(path), path));
+
+  //another annotation file invalidates the sidecar
+  {
+    std::ofstream ofs(path, std::ios::app);
+    ofs << "\n";
+  }
+  EXPECT_FALSE(LoadStats(loaded, StatsPath(path), path));
+}
@@ -0,0 +1,56 @@
+#include "gtest/gtest.h"
+
+#include <image_cache.h>
+#include <thread>
+#include <vector>
+
+using namespace rcnn::data;
+
+TEST(image_cache, lru)
+{
+  //one shard holding two 10x10x3 images
+  ImageCache cache(600, 1);
+  cv::Mat a(10, 10, CV_8UC3), b(10, 10, CV_8UC3), c(10, 10, CV_8UC3), out;
+
+  EXPECT_FALSE(cache.Get(1, out));
+  cache.Put(1, a);
+  cache.Put(2, b);
+  ASSERT_TRUE(cache.Get(1, out));
+  EXPECT_EQ(out.data, a.data);//shares the buffer
+  //2 is the least recently used
+  cache.Put(3, c);
+  EXPECT_FALSE(cache.Get(2, out));
+  EXPECT_TRUE(cache.Get(1, out));
+  EXPECT_TRUE(cache.Get(3, out));
+
+  EXPECT_EQ(cache.hits(), 3);
+  EXPECT_EQ(cache.misses(), 2);
+  EXPECT_EQ(cache.evictions(), 1);
+  EXPECT_EQ(cache.bytes(), 600);
+
+  //too large for the budget
+  cache.Put(4, cv::Mat(20, 20, CV_8UC3));
+  EXPECT_FALSE(cache.Get(4, out));
+  cache.Clear();
+  EXPECT_EQ(cache.bytes(), 0);
+}
+
+TEST(image_cache, threads)
+{
+  ImageCache cache(300 * 64, 8);
+  std::vector<std::thread> workers;
+  for(int t = 0; t < 4; ++t){
+    workers.emplace_back([&cache, t](){
+      cv::Mat img(10, 10, CV_8UC3), out;
+      for(int i = 0; i < 2000; ++i){
+        int64_t id = (i * 7 + t) % 128;
+        if(!cache.Get(id, out))
+          cache.Put(id, img);
+      }
+    });
+  }
+  for(auto& worker : workers)
+    worker.join();
+  EXPECT_EQ(cache.hits() + cache.misses(), 8000);
+  EXPECT_LE(cache.bytes(), 300 * 64);
+}
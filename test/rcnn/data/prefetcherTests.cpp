@@ -0,0 +1,27 @@
+#include "gtest/gtest.h"
+
+#include <prefetcher.h>
+
+using namespace rcnn::data;
+
+TEST(prefetcher, order)
+{
+  //any range of batches works as the loader
+  std::vector<batch> loader;
+  for(int64_t i = 0; i < 5; ++i){
+    rcnn::structures::ImageList images(torch::full({1, 3, 4, 4}, static_cast<float>(i)), {std::make_pair<int64_t, int64_t>(4, 4)});
+    rcnn::structures::BoxList target(torch::zeros({1, 4}), std::make_pair<int64_t, int64_t>(4, 4));
+    loader.push_back(std::make_tuple(images, std::vector<rcnn::structures::BoxList>{target}, std::vector<int64_t>{i}));
+  }
+
+  auto prefetcher = MakePrefetcher(loader, torch::Device(torch::kCPU), 2);
+  int64_t expected = 0;
+  while(torch::optional<batch> next = prefetcher->Next()){
+    EXPECT_EQ(std::get<2>(*next)[0], expected);
+    EXPECT_EQ(std::get<0>(*next).get_tensors()[0][0][0][0].item<float>(), expected);
+    expected++;
+  }
+  EXPECT_EQ(expected, 5);
+  EXPECT_FALSE(prefetcher->Next());
+  EXPECT_LE(prefetcher->mean_occupancy(), 2);
+}
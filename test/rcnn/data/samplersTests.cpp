@@ -0,0 +1,25 @@
+#include "gtest/gtest.h"
+
+#include <samplers/samplers.h>
+#include <memory>
+#include <vector>
+
+using namespace rcnn::data;
+
+TEST(samplers, grouped_batch)
+{
+  std::vector<int> group_ids{0, 1, 0, 0, 1, 1, 0};
+  auto sampler = std::make_shared<torch::data::samplers::SequentialSampler>(group_ids.size());
+  //batches of one group, ordered by their first element
+  std::vector<std::vector<size_t>> expected{{0, 2}, {1, 4}, {3, 6}, {5}};
+  for(bool drop_uneven : {false, true}){
+    GroupedBatchSampler batch_sampler(sampler, group_ids, 2, drop_uneven);
+    for(int epoch = 0; epoch < 2; ++epoch){
+      batch_sampler.reset();
+      std::vector<std::vector<size_t>> batches;
+      while(auto batch = batch_sampler.next(2))
+        batches.push_back(*batch);
+      EXPECT_EQ(batches, drop_uneven ? std::vector<std::vector<size_t>>(expected.begin(), expected.end() - 1) : expected);
+    }
+  }
+}
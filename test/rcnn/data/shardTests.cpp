@@ -0,0 +1,63 @@
+#include "gtest/gtest.h"
+
+#include <shard.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include "test_annotations.h"
+
+using namespace rcnn::data;
+
+TEST(shard, roundtrip)
+{
+  std::string dir = "shard_test";
+  test::TempFiles files{"shard_test_annotations.json", dir + "/00000" + SHARD_EXTENSION, dir + "/00001" + SHARD_EXTENSION};
+  test::WriteAnnotations(files[0]);
+  coco::COCO coco(files[0], false);
+  mkdir(dir.c_str(), 0755);
+  std::map<int, std::vector<unsigned char>> bytes{{3, {1, 2, 3}}, {4, {}}, {5, {8}}, {9, {4, 5, 6, 7}}};
+
+  //3 and 4 in the first shard, 5 and 9 in the second
+  ShardWriter first(files[1]), second(files[2]);
+  first.Add(coco, 3, bytes[3]);
+  first.Add(coco, 4, bytes[4]);
+  second.Add(coco, 5, bytes[5]);
+  second.Add(coco, 9, bytes[9]);
+  ASSERT_TRUE(first.Close());
+  ASSERT_TRUE(second.Close());
+
+  ShardSet shards(dir);
+  ASSERT_EQ(shards.size(), 2);
+  EXPECT_EQ(shards.Find(3), 0);
+  EXPECT_EQ(shards.Find(4), 0);
+  EXPECT_EQ(shards.Find(5), 1);
+  EXPECT_EQ(shards.Find(9), 1);
+  EXPECT_EQ(shards.Find(1), -1);
+  std::vector<unsigned char> read;
+  for(auto& image : bytes){
+    ASSERT_TRUE(shards.Read(image.first, read));
+    EXPECT_EQ(read, image.second);
+  }
+  EXPECT_FALSE(shards.Read(1, read));
+
+  coco::COCO loaded;
+  shards.LoadTargets(loaded);
+  ASSERT_EQ(loaded.GetImgIds(), coco.GetImgIds());
+  ASSERT_EQ(loaded.GetCatIds(), coco.GetCatIds());
+  EXPECT_EQ(loaded.LoadCats()[1].supercategory, "vehicle");
+  for(auto& img_id : coco.GetImgIds()){
+    std::vector<int64_t> ids = coco.GetAnnIds(std::vector<int>{img_id});
+    ASSERT_EQ(loaded.GetAnnIds(std::vector<int>{img_id}), ids);
+    std::vector<coco::Annotation> expected = coco.LoadAnns(ids), anns = loaded.LoadAnns(ids);
+    for(size_t i = 0; i < anns.size(); ++i){
+      EXPECT_EQ(anns[i].bbox, expected[i].bbox);
+      EXPECT_EQ(anns[i].segmentation, expected[i].segmentation);
+      EXPECT_EQ(anns[i].counts, expected[i].counts);
+      EXPECT_EQ(anns[i].compressed_rle, expected[i].compressed_rle);
+    }
+    EXPECT_EQ(loaded.LoadImgs(std::vector<int>{img_id})[0].file_name, coco.LoadImgs(std::vector<int>{img_id})[0].file_name);
+  }
+
+  std::remove(files[1].c_str());
+  std::remove(files[2].c_str());
+  rmdir(dir.c_str());
+}
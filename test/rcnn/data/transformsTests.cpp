@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+
+#include <transforms/transforms.h>
+#include <opencv2/core.hpp>
+
+using namespace rcnn::data;
+
+namespace{
+
+torch::data::Example<cv::Mat, RCNNData> MakeExample(int width, int height){
+  cv::Mat img(height, width, CV_8UC3);
+  cv::randu(img, cv::Scalar::all(0), cv::Scalar::all(256));
+  RCNNData data;
+  data.idx = 0;
+  data.target = rcnn::structures::BoxList(torch::tensor({1.f, 2.f, 30.f, 20.f}).reshape({1, 4}), std::make_pair(static_cast<int64_t>(width), static_cast<int64_t>(height)));
+  return torch::data::Example<cv::Mat, RCNNData>{img, data};
+}
+
+}
+
+TEST(transforms, fused)
+{
+  std::vector<float> mean{102.9801, 115.9465, 122.7717}, stddev{57.375, 57.12, 58.395};
+  for(float flip_prob : {0.f, 1.f}){
+    Compose chain(
+      std::vector<std::shared_ptr<MatToMatTransform>>{
+        std::make_shared<Resize>(80, 133),
+        std::make_shared<RandomHorizontalFlip>(flip_prob),
+        std::make_shared<RandomVerticalFlip>(flip_prob)
+      },
+      std::vector<std::shared_ptr<TensorToTensorTransform>>{
+        std::make_shared<Normalize>(torch::ArrayRef<float>(mean), torch::ArrayRef<float>(stddev), true)
+      }
+    );
+    Compose fused(std::make_shared<ResizeFlipNormalize>(80, 133, flip_prob, flip_prob, mean, stddev, true));
+
+    auto input = MakeExample(64, 48);
+    auto expected = chain(input);
+    auto result = fused(input);
+    ASSERT_EQ(result.data.sizes(), expected.data.sizes());
+    EXPECT_TRUE(torch::equal(result.data, expected.data));
+    EXPECT_TRUE(torch::equal(result.target.target.get_bbox(), expected.target.target.get_bbox()));
+  }
+}
+
+TEST(transforms, color_jitter_matrix)
+{
+  cv::Matx34f identity = ColorJitter::Matrix(1, 1, 1, 0, 0);
+  for(int i = 0; i < 3; ++i)
+    for(int j = 0; j < 4; ++j)
+      EXPECT_NEAR(identity(i, j), i == j ? 1 : 0, 1e-3);
+
+  //gray stays gray under every adjustment, saturation 0 maps a pixel to its gray level
+  cv::Vec4f gray(100, 100, 100, 1), pixel(30, 120, 210, 1);
+  cv::Vec3f adjusted = ColorJitter::Matrix(1.2f, 0.8f, 1.5f, 0.3f, 90) * gray;
+  EXPECT_NEAR(adjusted[0], adjusted[1], 1e-2);
+  EXPECT_NEAR(adjusted[1], adjusted[2], 1e-2);
+  cv::Vec3f desaturated = ColorJitter::Matrix(1, 1, 0, 0, 0) * pixel;
+  float level = 0.114f * 30 + 0.587f * 120 + 0.299f * 210;
+  for(int c = 0; c < 3; ++c)
+    EXPECT_NEAR(desaturated[c], level, 1e-2);
+}
+
+TEST(transforms, fused_color_jitter)
+{
+  std::vector<float> mean{102.9801, 115.9465, 122.7717}, stddev{57.375, 57.12, 58.395};
+  Compose chain(
+    std::vector<std::shared_ptr<MatToMatTransform>>{
+      std::make_shared<Resize>(80, 133),
+      std::make_shared<ColorJitter>(0.4f, 0.4f, 0.4f, 0.1f),
+      std::make_shared<RandomHorizontalFlip>(0.5f),
+      std::make_shared<RandomVerticalFlip>(0.5f)
+    },
+    std::vector<std::shared_ptr<TensorToTensorTransform>>{
+      std::make_shared<Normalize>(torch::ArrayRef<float>(mean), torch::ArrayRef<float>(stddev), true)
+    }
+  );
+  Compose fused(std::make_shared<ResizeFlipNormalize>(80, 133, 0.5f, 0.5f, mean, stddev, true, ColorJitter(0.4f, 0.4f, 0.4f, 0.1f)));
+
+  auto input = MakeExample(64, 48);
+  cv::Mat original = input.data.clone();
+  for(unsigned seed : {1u, 2u, 3u}){
+    std::srand(seed);
+    auto expected = chain(input);
+    std::srand(seed);
+    auto result = fused(input);
+    EXPECT_TRUE(torch::equal(result.data, expected.data));
+    EXPECT_TRUE(torch::equal(result.target.target.get_bbox(), expected.target.target.get_bbox()));
+  }
+  //the input may be shared with the image cache
+  EXPECT_EQ(cv::norm(input.data, original, cv::NORM_INF), 0);
+}
@@ -0,0 +1,92 @@
+#include "gtest/gtest.h"
+
+#include <segmentation_mask.h>
+#include <bounding_box.h>
+#include "roi_heads/mask_head/loss.h"
+
+using namespace rcnn::structures;
+
+TEST(segmentation_mask, ops)
+{
+  //a 4x4 square and a triangle with two rings in a 20x10 image
+  SegmentationMask masks(std::vector<std::vector<std::vector<double>>>{
+    {{2, 2, 6, 2, 6, 6, 2, 6}},
+    {{10, 1, 14, 1, 10, 5}, {15, 5, 18, 5, 18, 8}}
+  }, std::make_pair(20, 10), "poly");
+  ASSERT_EQ(masks.Length(), 2);
+
+  torch::Tensor dense = masks.GetMaskTensor();
+  ASSERT_EQ(dense.sizes(), torch::IntArrayRef({2, 10, 20}));
+  EXPECT_EQ(dense[0].sum().item<float>(), 16);
+
+  //ops on the polygons match the same ops on the dense masks
+  //flips map x to width - x - 1, the square lands one pixel before the flipped dense mask
+  torch::Tensor flipped = masks[0].Transpose(FLIP_LEFT_RIGHT).GetMaskTensor()[0];
+  EXPECT_TRUE(torch::equal(flipped.slice(1, 0, 19), dense[0].flip({1}).slice(1, 1, 20)));
+  EXPECT_TRUE(torch::equal(masks.Transpose(FLIP_TOP_BOTTOM).Transpose(FLIP_TOP_BOTTOM).GetMaskTensor(), dense));
+  EXPECT_TRUE(torch::equal(masks.Crop(std::make_tuple(1, 1, 15, 9)).GetMaskTensor(), dense.slice(1, 1, 9).slice(2, 1, 15)));
+  EXPECT_EQ(masks.Resize(std::make_pair(40, 20)).GetMaskTensor()[0].sum().item<float>(), 64);
+
+  SegmentationMask second = masks[torch::tensor({1}, torch::kI64)];
+  ASSERT_EQ(second.Length(), 1);
+  EXPECT_TRUE(torch::equal(second.GetMaskTensor()[0], dense[1]));
+  SegmentationMask kept = masks[torch::tensor({1, 0}, torch::kByte)];
+  EXPECT_TRUE(torch::equal(kept.GetMaskTensor()[0], dense[0]));
+}
+
+TEST(segmentation_mask, project_on_boxes)
+{
+  SegmentationMask masks(std::vector<std::vector<std::vector<double>>>{
+    {{2.3, 2.1, 6.7, 2.2, 6.1, 6.9, 2.4, 6.2}},
+    {{10.5, 1.5, 14.2, 1.1, 10.1, 5.8}, {15.3, 5.2, 18.8, 5.1, 18.4, 8.7}}
+  }, std::make_pair(20, 10), "poly");
+  torch::Tensor boxes = torch::tensor({1.5f, 1.2f, 7.9f, 7.3f, 9.1f, 0.4f, 19.f, 9.f}).reshape({2, 4});
+  torch::Tensor projected = masks.ProjectOnBoxes(boxes, 14);
+  ASSERT_EQ(projected.sizes(), torch::IntArrayRef({2, 14, 14}));
+  for(int64_t i = 0; i < 2; ++i)
+    EXPECT_TRUE(torch::equal(projected[i], masks[i].Crop(boxes[i]).Resize(std::make_pair(14, 14)).GetMaskTensor()[0]));
+}
+
+TEST(segmentation_mask, crop_mask_rasters)
+{
+  //a square filling its box and a triangle, rasterized over their own boxes like the collator does
+  SegmentationMask masks(std::vector<std::vector<std::vector<double>>>{
+    {{8, 8, 40, 8, 40, 40, 8, 40}},
+    {{10, 12, 42, 12, 10, 44}}
+  }, std::make_pair(64, 64), "poly");
+  torch::Tensor gt_boxes = torch::tensor({8.f, 8.f, 40.f, 40.f, 10.f, 12.f, 42.f, 44.f}).reshape({2, 4});
+  torch::Tensor rasters = masks.ProjectOnBoxes(gt_boxes, 28);
+
+  //proposals inside, overlapping and larger than the target box
+  std::vector<std::vector<float>> windows{{12, 12, 36, 36}, {20, 16, 56, 48}, {4, 4, 44, 44}};
+  int M = 28;
+  for(auto& window : windows){
+    torch::Tensor boxes = torch::tensor({window[0], window[1], window[2], window[3], window[0], window[1], window[2], window[3]}).reshape({2, 4});
+    rcnn::structures::BoxList proposals(boxes, std::make_pair(64, 64));
+    torch::Tensor cropped = rcnn::modeling::CropMaskRasters(rasters, gt_boxes, proposals, M);
+    torch::Tensor exact = rcnn::modeling::ProjectMasksOnBoxes(masks, proposals, M);
+    ASSERT_EQ(cropped.sizes(), exact.sizes());
+    for(int64_t i = 0; i < 2; ++i){
+      //cells entirely outside the target box stay empty
+      torch::Tensor gt_box = gt_boxes[i].contiguous();
+      const float* gt = gt_box.data<float>();
+      float cell_w = (window[2] - window[0]) / M, cell_h = (window[3] - window[1]) / M;
+      for(int y = 0; y < M; ++y){
+        for(int x = 0; x < M; ++x){
+          float x0 = window[0] + x * cell_w, y0 = window[1] + y * cell_h;
+          if(x0 + cell_w <= gt[0] || x0 >= gt[2] || y0 + cell_h <= gt[1] || y0 >= gt[3])
+            EXPECT_EQ(cropped[i][y][x].item<float>(), 0) << "bleed at " << x << ", " << y;
+        }
+      }
+      //resampling only moves the mask boundary
+      float inter = (cropped[i] * exact[i]).sum().item<float>();
+      float uni = ((cropped[i] + exact[i]) > 0).sum().item<float>();
+      EXPECT_GE(inter / uni, 0.75);
+    }
+  }
+
+  //inside the square everything is foreground either way
+  rcnn::structures::BoxList inside(torch::tensor({12.f, 12.f, 36.f, 36.f}).reshape({1, 4}), std::make_pair(64, 64));
+  EXPECT_TRUE(torch::equal(rcnn::modeling::CropMaskRasters(rasters.slice(0, 0, 1), gt_boxes.slice(0, 0, 1), inside, M),
+                           rcnn::modeling::ProjectMasksOnBoxes(masks[torch::tensor({0}, torch::kI64)], inside, M)));
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <cstdio>
+#include <fstream>
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+
+namespace test{
+
+//polygon, RLE and compressed RLE annotations in file order 12, 5, 6, 7.
+//image 4 only has a one pixel box and image 5 has no annotations
+const char* const kAnnotations = R"({
+  "images": [
+    {"id": 9, "width": 640, "height": 480, "file_name": "b.jpg"},
+    {"id": 3, "width": 320, "height": 200, "file_name": "a.jpg"},
+    {"id": 4, "width": 100, "height": 100, "file_name": "c.jpg"},
+    {"id": 5, "width": 100, "height": 300, "file_name": "d.jpg"}
+  ],
+  "annotations": [
+    {"id": 12, "image_id": 9, "category_id": 2, "area": 100.0, "iscrowd": 0, "bbox": [1, 2, 10, 10],
+     "segmentation": [[1, 2, 11, 2, 11, 12], [3, 3, 4, 4, 5, 3]]},
+    {"id": 5, "image_id": 3, "category_id": 1, "area": 50.5, "iscrowd": 1, "bbox": [0, 0, 5, 10],
+     "segmentation": {"size": [200, 320], "counts": [0, 10, 190]}},
+    {"id": 6, "image_id": 4, "category_id": 1, "area": 20.0, "iscrowd": 1, "bbox": [0, 0, 1, 1],
+     "segmentation": {"size": [100, 100], "counts": "52203"}},
+    {"id": 7, "image_id": 9, "category_id": 1, "area": 2000.0, "iscrowd": 0, "bbox": [20, 20, 40, 50],
+     "segmentation": [[20, 20, 60, 20, 60, 70]]}
+  ],
+  "categories": [
+    {"id": 1, "name": "person", "supercategory": "person"},
+    {"id": 2, "name": "bicycle", "supercategory": "vehicle"}
+  ]
+})";
+
+inline void WriteAnnotations(const std::string& path){
+  std::ofstream ofs(path);
+  ofs << kAnnotations;
+}
+
+//removes its files on construction, leftovers of an earlier run, and when the test leaves its scope
+class TempFiles{
+public:
+  TempFiles(std::initializer_list<std::string> paths) :paths_(paths){
+    Remove();
+  }
+  ~TempFiles(){
+    Remove();
+  }
+  TempFiles(const TempFiles& other) = delete;
+  TempFiles& operator=(const TempFiles& other) = delete;
+
+  const std::string& operator[](size_t i) const{
+    return paths_[i];
+  }
+
+private:
+  void Remove(){
+    for(auto& path : paths_)
+      std::remove(path.c_str());
+  }
+
+  std::vector<std::string> paths_;
+};
+
+}//test